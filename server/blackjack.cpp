@@ -10,6 +10,7 @@
 #include "channel.hpp"
 #include "channel_list.hpp"
 #include "rpc.hpp"
+#include "rpc_params.hpp"
 #include "server.hpp"
 #include "service.hpp"
 #include "types.hpp"
@@ -31,7 +32,8 @@ enum class error
     already_playing,
     already_leaving,
     no_open_seat,
-    no_more_bets
+    no_more_bets,
+    bad_wager
 };
 
 } // (anon)
@@ -71,6 +73,8 @@ public:
             "No open seat";
         case error::no_more_bets: return
             "No more bets";
+        case error::bad_wager: return
+            "Invalid wager";
         }
     }
 
@@ -406,7 +410,10 @@ public:
     }
 
     void
-    bet(user& u, beast::error_code& ec)
+    bet(
+        user& u,
+        std::uint64_t size,
+        beast::error_code& ec)
     {
         auto const i = find(u);
         if(! i)
@@ -424,9 +431,14 @@ public:
         case seat::leaving:
             break;
         }
-        int const size = 5;
-        seat_[i].wager += size;
-        seat_[i].chips -= size;
+        if( size == 0 || size > static_cast<
+                std::uint64_t>(seat_[i].chips))
+        {
+            ec = error::bad_wager;
+            return;
+        }
+        seat_[i].wager += static_cast<int>(size);
+        seat_[i].chips -= static_cast<int>(size);
         cb_.on_game_bet();
     }
 
@@ -507,18 +519,60 @@ private:
 
 //------------------------------------------------------------------------------
 
+struct bet_params
+{
+    std::uint64_t amount = 5;
+};
+
+using bet_param = rpc_param<bet_params>;
+
+constexpr bet_param bet_schema[] = {
+    { "amount", &bet_param::member<
+        std::uint64_t, &bet_params::amount>, false },
+};
+
+static_assert(rpc_params_unique(bet_schema),
+    "two params have the same hash");
+
+//------------------------------------------------------------------------------
+
 class table
     : public channel
     , public game::callback
 {
     using lock_guard =
         std::lock_guard<std::mutex>;
+
+    // Handlers run on the strand, and own the request
+    using handler = void (table::*)(rpc_call&&);
    
     server& srv_;
     timer_type timer_;
     std::mutex mutable mutex_;
     game g_;
 
+    // Every command acts on the caller's seat, so
+    // only a bet, which may give its size, needs the params.
+    static
+    rpc_method_table<handler>&
+    methods()
+    {
+        static constexpr rpc_method<handler> list[] = {
+            { "play",  &table::do_play,  false },
+            { "watch", &table::do_watch, false },
+            { "bet",   &table::do_bet },
+            { "start", &table::do_start, false },
+            { "hit",   &table::do_hit,   false },
+            { "stand", &table::do_stand, false },
+        };
+        static_assert(rpc_methods_unique(list),
+            "two methods have the same hash");
+        static_assert(rpc_methods_sync(list),
+            "table methods run on the table's strand");
+        static rpc_method_table<handler> tab(list);
+        return tab;
+    }
+
 public:
     explicit
     table(server& srv)
@@ -569,37 +623,41 @@ private:
             std::reference_wrapper<user>(u));
     }
 
-    void
+    beast::error_code
     on_dispatch(rpc_call& rpc) override
     {
-        if(rpc.method == "play")
-        {
-            post(&table::do_play, this, std::move(rpc));
-        }
-        else if(rpc.method == "watch")
-        {
-            post(&table::do_watch, this, std::move(rpc));
-        }
-        else if(rpc.method == "bet")
-        {
-            post(&table::do_bet, this, std::move(rpc));
-        }
-        else if(rpc.method == "start")
-        {
-            post(&table::do_start, this, std::move(rpc));
-        }
-        else if(rpc.method == "hit")
-        {
-            post(&table::do_hit, this, std::move(rpc));
-        }
-        else if(rpc.method == "stand")
-        {
-            post(&table::do_stand, this, std::move(rpc));
-        }
+        auto const m = methods().call(
+            {rpc.method.data(), rpc.method.size()});
+        if(! m)
+            return rpc_code::method_not_found;
+
+        // A request parsed on the strand is already in order
+        // with those posted before it, so posting it again
+        // would let a later request overtake it.
+        if(timer_.get_executor().running_in_this_thread())
+            (this->*m->handler)(std::move(rpc));
         else
-        {
-            rpc.fail(rpc_code::method_not_found);
-        }
+            post(m->handler, this, std::move(rpc));
+        return {};
+    }
+
+    bool
+    on_needs_params(beast::string_view method) const override
+    {
+        auto const m = methods().find(method);
+        return m && m->needs_params;
+    }
+
+    boost::optional<executor_type>
+    on_get_executor() override
+    {
+        return timer_.get_executor();
+    }
+
+    void
+    on_get_methods(json::array& arr) const override
+    {
+        methods().to_json(arr);
     }
 
     //--------------------------------------------------------------------------
@@ -617,7 +675,10 @@ private:
         obj["verb"] = "update";
         obj["action"] = action;
         obj["game"] = json::to_value(g_);
-        send(jv);
+
+        // Each update holds the whole game, so a slow
+        // player only needs the latest one.
+        send(jv, cid());
     }
 
     void
@@ -670,98 +731,59 @@ private:
     void
     do_play(rpc_call&& rpc)
     {
-        try
-        {
-            // TODO Optional seat choice
-            beast::error_code ec;
-            g_.join(*rpc.u, ec);
-            if(ec)
-                rpc.fail(ec.message());
-            update("play");
-            rpc.complete();
-        }
-        catch(rpc_error const& e)
-        {
-            rpc.complete(e);
-        }
+        // TODO Optional seat choice
+        beast::error_code ec;
+        g_.join(*rpc.u, ec);
+        if(ec)
+            return rpc.complete(ec);
+        update("play");
+        rpc.complete();
     }
 
     void
     do_watch(rpc_call&& rpc)
     {
-        try
-        {
-            beast::error_code ec;
-            g_.leave(*rpc.u, ec);
-            if(ec)
-                rpc.fail(ec.message());
-            update("watch");
-            rpc.complete();
-        }
-        catch(rpc_error const& e)
-        {
-            rpc.complete(e);
-        }
+        beast::error_code ec;
+        g_.leave(*rpc.u, ec);
+        if(ec)
+            return rpc.complete(ec);
+        update("watch");
+        rpc.complete();
     }
 
     void
     do_bet(rpc_call&& rpc)
     {
-        try
-        {
-            beast::error_code ec;
-            g_.bet(*rpc.u, ec);
-            if(ec)
-                rpc.fail(ec.message());
-            rpc.complete();
-        }
-        catch(rpc_error const& e)
-        {
-            rpc.complete(e);
-        }
+        bet_params p;
+        auto ec = rpc_bind(bet_schema, rpc.params, p);
+        if(ec)
+            return rpc.complete(ec);
+        g_.bet(*rpc.u, p.amount, ec);
+        if(ec)
+            return rpc.complete(ec);
+        rpc.complete();
     }
 
     void
     do_start(rpc_call&& rpc)
     {
-        try
-        {
-            beast::error_code ec;
-            g_.start(ec);
-            if(ec)
-                rpc.fail(ec.message());
-            rpc.complete();
-        }
-        catch(rpc_error const& e)
-        {
-            rpc.complete(e);
-        }
+        beast::error_code ec;
+        g_.start(ec);
+        if(ec)
+            return rpc.complete(ec);
+        rpc.complete();
     }
 
     void
     do_hit(rpc_call&& rpc)
     {
-        try
-        {
-            rpc.complete();
-        }
-        catch(rpc_error const& e)
-        {
-            rpc.complete(e);
-        }
+        rpc.complete();
     }
 
     void
     do_stand(rpc_call&& rpc)
     {
-        try
-        {
-            rpc.complete();
-        }
-        catch(rpc_error const& e)
-        {
-            rpc.complete(e);
-        }
+        rpc.complete();
     }
 
     //--------------------------------------------------------------------------
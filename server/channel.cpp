@@ -11,14 +11,17 @@
 #include "channel_list.hpp"
 #include "message.hpp"
 #include "rpc.hpp"
+#include "rpc_pool.hpp"
 #include "user.hpp"
 #include <atomic>
 
 channel::
 channel(
     beast::string_view name,
-    channel_list& list)
+    channel_list& list,
+    membership kind)
     : list_(list)
+    , users_(kind)
     , uid_(list.next_uid())
     , cid_(list.next_cid())
     , name_(name)
@@ -29,8 +32,10 @@ channel::
 channel(
     std::size_t reserved_cid,
     beast::string_view name,
-    channel_list& list)
+    channel_list& list,
+    membership kind)
     : list_(list)
+    , users_(kind)
     , uid_(list.next_uid())
     , cid_(reserved_cid)
     , name_(name)
@@ -53,7 +58,7 @@ channel::
 is_joined(user& u) const noexcept
 {
     shared_lock_guard lock(mutex_);
-    return users_.find(&u) != users_.end();
+    return users_.contains(&u);
 }
 
 bool
@@ -64,7 +69,10 @@ insert(user& u)
         auto const inserted = [&]
         {
             lock_guard lock(mutex_);
-            return users_.insert(&u).second;
+            if(! users_.insert(&u))
+                return false;
+            members_.reset();
+            return true;
         }();
         if(! inserted)
             return false;
@@ -91,8 +99,9 @@ erase(user& u)
     // First remove the user from the list
     {
         lock_guard lock(mutex_);
-        if(users_.erase(&u) == 0)
+        if(! users_.erase(&u))
             return false;
+        members_.reset();
     }
 
     // Notify channel participants
@@ -119,75 +128,141 @@ erase(user& u)
 
 void
 channel::
-send(json::value const& jv)
+send(
+    json::value const& jv,
+    std::uint64_t key)
 {
-    send(make_message(jv));
+    // Each encoding is built when the first member
+    // speaking it is reached, and shared by the rest.
+    message text;
+    message binary;
+    for(auto const& wp : *members())
+    {
+        auto u = wp.lock();
+        if(! u)
+            continue;
+        auto& m = u->format() == wire_format::msgpack ?
+            binary : text;
+        if(! m)
+        {
+            auto temp = make_message(jv, key, u->format());
+            swap(m, temp);
+        }
+        u->send(m);
+    }
 }
 
-void
+beast::error_code
 channel::
 dispatch(rpc_call& rpc)
 {
-    if(rpc.method == "join")
-    {
-        do_join(rpc);
-    }
-    else if(rpc.method == "leave")
-    {
-        do_leave(rpc);
-    }
-    else
-    {
-        on_dispatch(rpc);
-    }
+    auto const m = methods().call(
+        {rpc.method.data(), rpc.method.size()});
+    if(m)
+        return invoke(*m, rpc);
+    return on_dispatch(rpc);
+}
+
+bool
+channel::
+needs_params(beast::string_view method) const
+{
+    if(auto const m = methods().find(method))
+        return m->needs_params;
+    return on_needs_params(method);
 }
 
 void
 channel::
-checked_user(rpc_call& rpc)
+get_methods(json::array& arr) const
+{
+    methods().to_json(arr);
+    on_get_methods(arr);
+}
+
+beast::error_code
+channel::
+expect_user(rpc_call& rpc)
 {
     if(rpc.u->name.empty())
-        rpc.fail("No identity set");
+        return rpc_code::no_identity;
+    return {};
 }
 
-void
+beast::error_code
+channel::
+post_async(
+    rpc_call& rpc,
+    std::function<beast::error_code(rpc_call&)> f)
+{
+    return list_.rpc_pool().post(rpc, std::move(f));
+}
+
+beast::error_code
 channel::
 do_join(rpc_call& rpc)
 {
-    checked_user(rpc);
+    auto ec = expect_user(rpc);
+    if(ec)
+        return ec;
     if(! insert(*rpc.u))
-        rpc.fail("Already in channel");
+        return rpc_code::already_joined;
     rpc.complete();
+    return {};
 }
 
-void
+beast::error_code
 channel::
 do_leave(rpc_call& rpc)
 {
     if(! erase(*rpc.u))
-        rpc.fail("Not in channel");
+        return rpc_code::not_joined;
     rpc.complete();
+    return {};
 }
 
-void
+rpc_method_table<channel::handler>&
+channel::
+methods()
+{
+    static constexpr rpc_method<handler> list[] = {
+        { "join",  &channel::do_join,  false },
+        { "leave", &channel::do_leave, false },
+    };
+    static_assert(rpc_methods_unique(list),
+        "two methods have the same hash");
+    static rpc_method_table<handler> tab(list);
+    return tab;
+}
+
+rcu<channel::member_list>::snapshot_type
 channel::
-send(message m)
+members()
 {
-    // Make a local list of all the weak pointers
-    // representing the users, so we can do the
-    // actual sending without holding the mutex:
-    std::vector<boost::weak_ptr<user>> v;
+    // Readers share the current snapshot of the
+    // members without locking or allocating. A
+    // concurrent insert or erase discards the
+    // snapshot in constant time and leaves this
+    // copy intact; the first broadcast afterwards
+    // builds a new one.
+    auto sp = members_.load();
+    if(! sp)
     {
+        // Writers cannot run while we hold the shared
+        // lock, so the list we publish is never stale.
         shared_lock_guard lock(mutex_);
-        v.reserve(users_.size());
-        for(auto p : users_)
-            v.emplace_back(boost::weak_from(p));
+        sp = members_.load();
+        if(! sp)
+        {
+            member_list v;
+            v.reserve(users_.size());
+            users_.for_each(
+                [&v](user* p)
+                {
+                    v.emplace_back(boost::weak_from(p));
+                });
+            sp = members_.store(std::move(v));
+        }
     }
-
-    // For each user in our local list, try to
-    // acquire a strong pointer. If successful,
-    // then send the message to that user.
-    for(auto const& wp : v)
-        if(auto sp = wp.lock())
-            sp->send(m);
+    return sp;
 }
@@ -11,14 +11,23 @@
 #define LOUNGE_CHANNEL_HPP
 
 #include "config.hpp"
+#include "member_set.hpp"
+#include "rcu.hpp"
+#include "rpc_methods.hpp"
+#include "types.hpp"
 #include "uid.hpp"
 #include "utility.hpp"
+#include <boost/beast/core/error.hpp>
 #include <boost/beast/core/string.hpp>
 #include <boost/json/value.hpp>
-#include <boost/container/flat_set.hpp>
+#include <boost/optional.hpp>
+#include <boost/smart_ptr/enable_shared_from.hpp>
+#include <boost/smart_ptr/weak_ptr.hpp>
 #include <boost/thread/lock_guard.hpp>
 #include <boost/thread/shared_lock_guard.hpp>
 #include <boost/thread/shared_mutex.hpp>
+#include <cstdint>
+#include <functional>
 #include <mutex>
 #include <vector>
 
@@ -35,9 +44,17 @@ class channel : public boost::enable_shared_from
     using lock_guard = boost::lock_guard<mutex>;
     using shared_lock_guard = boost::shared_lock_guard<mutex>;
 
+    // Immutable list of members used for broadcasts
+    using member_list =
+        std::vector<boost::weak_ptr<user>>;
+
+    // Methods common to every channel
+    using handler = beast::error_code (channel::*)(rpc_call&);
+
     channel_list& list_;
     boost::shared_mutex mutable mutex_;
-    boost::container::flat_set<user*> users_;
+    member_set<user> users_;
+    rcu<member_list> members_;
     uid_type uid_;
     std::size_t cid_;
     std::string name_;
@@ -87,27 +104,116 @@ public:
     bool
     erase(user& u);
 
-    void
-    send(json::value const& jv);
+    /** Send a JSON message to every member.
 
-    /// Process an RPC command for this channel
+        The message is encoded once for each wire format
+        in use by at least one member.
+
+        @param key If not zero, the message carries state
+        which a later message with the same key supersedes.
+        A member whose outgoing queue is full may then
+        receive only the latest of these.
+    */
     void
+    send(
+        json::value const& jv,
+        std::uint64_t key = 0);
+
+    /** Process an RPC command for this channel.
+
+        @returns The error to complete the request with, if
+        the request failed before it could be completed.
+    */
+    beast::error_code
     dispatch(rpc_call& rpc);
 
+    /** Return `true` if a method uses the params of a request.
+
+        A request for a method which uses only the channel id
+        is dispatched without parsing it.
+    */
+    bool
+    needs_params(beast::string_view method) const;
+
+    /** Return the executor which runs the channel's methods.
+
+        A request for a method which needs its params is
+        parsed on this executor, instead of on the strand of
+        the session which received it. Returns `boost::none`
+        if the methods run on the caller's strand.
+    */
+    boost::optional<executor_type>
+    get_executor()
+    {
+        return on_get_executor();
+    }
+
+    /** Append the name and number of calls of each method.
+
+        Each element is an object with the keys "method"
+        and "calls".
+    */
+    void
+    get_methods(json::array& arr) const;
+
 protected:
-    /// Construct a new channel with a unique channel id
+    /** Construct a new channel with a unique channel id
+
+        @param kind The container used to hold the members.
+        Channels expected to grow very large should use
+        `membership::dense`.
+    */
     channel(
         beast::string_view name,
-        channel_list& list);
+        channel_list& list,
+        membership kind = membership::flat);
 
     /// Construct a new channel with the specified channel id
     channel(
         std::size_t reserved_cid,
         beast::string_view name,
-        channel_list& list);
+        channel_list& list,
+        membership kind = membership::flat);
+
+    /// Return an error if the user has no identity
+    beast::error_code
+    expect_user(rpc_call& rpc);
 
+    /** Call the handler of a method found in a channel's table.
+
+        A method marked `async` is handed to the RPC pool, so
+        every channel which dispatches through this honors the
+        flag. Channels which run their methods on their own
+        strand must not mark any method `async`, and check
+        this with @ref rpc_methods_sync.
+    */
+    template<class Channel>
+    beast::error_code
+    invoke(
+        rpc_method<beast::error_code(
+            Channel::*)(rpc_call&)> const& m,
+        rpc_call& rpc)
+    {
+        auto const self = static_cast<Channel*>(this);
+        if(! m.async)
+            return (self->*m.handler)(rpc);
+        auto const sp = boost::shared_from(self);
+        auto const h = m.handler;
+        return post_async(rpc,
+            [sp, h](rpc_call& rpc)
+            {
+                return (sp.get()->*h)(rpc);
+            });
+    }
+
+    /// Invoke a function with each member of the channel
+    template<class F>
     void
-    checked_user(rpc_call& rpc);
+    for_each_user(F const& f) const
+    {
+        shared_lock_guard lock(mutex_);
+        users_.for_each(f);
+    }
 
     /** Called when a user is inserted to the channel's list.
 
@@ -125,15 +231,45 @@ protected:
     void
     on_erase(user& u) = 0;
 
-    /// Called on an RPC command
+    /** Called on an RPC command.
+
+        @returns The error to complete the request with, if
+        the request failed before it could be completed.
+    */
     virtual
-    void
+    beast::error_code
     on_dispatch(rpc_call& rpc) = 0;
 
+    /// Called to ask if a method uses the params of a request
+    virtual
+    bool
+    on_needs_params(beast::string_view) const
+    {
+        return true;
+    }
+
+    /// Called to return the executor which runs the methods, if any
+    virtual
+    boost::optional<executor_type>
+    on_get_executor()
+    {
+        return boost::none;
+    }
+
+    /// Called to append the methods handled by @ref on_dispatch
+    virtual
+    void
+    on_get_methods(json::array&) const
+    {
+    }
+
 private:
-    void do_join(rpc_call& rpc);
-    void do_leave(rpc_call& rpc);
-    void send(message m);
+    beast::error_code post_async(rpc_call& rpc,
+        std::function<beast::error_code(rpc_call&)> f);
+    static rpc_method_table<handler>& methods();
+    beast::error_code do_join(rpc_call& rpc);
+    beast::error_code do_leave(rpc_call& rpc);
+    rcu<member_list>::snapshot_type members();
 };
 
 #endif
@@ -98,23 +98,27 @@ public:
         return v_[cid].c;
     }
 
-    void
+    beast::error_code
     dispatch(rpc_call& rpc) override
     {
         // Validate and extract the channel id
-        auto const cid =
-            json::number_cast<std::size_t>(
-                checked_value(rpc.params, "cid"));
+        auto const cid = expect_uint64(rpc.params, "cid");
+        if(! cid)
+            return cid.error();
 
         // Lookup cid
-        auto c = at(cid);
+        auto c = at(*cid);
         if(! c)
-            rpc.fail(
-                rpc_code::invalid_params,
-                "Unknown cid");
+            return rpc_code::unknown_cid;
 
         // Dispatch the request
-        c->dispatch(rpc);
+        return c->dispatch(rpc);
+    }
+
+    ::rpc_pool&
+    rpc_pool() override
+    {
+        return srv_.rpc_pool();
     }
 
     uid_type
@@ -14,12 +14,14 @@
 #include "uid.hpp"
 #include <cstdlib>
 #include <boost/asio/buffer.hpp>
+#include <boost/beast/core/error.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/shared_ptr.hpp>
 #include <utility>
 
 class channel;
 class rpc_call;
+class rpc_pool;
 class user;
 
 //------------------------------------------------------------------------------
@@ -43,11 +45,20 @@ public:
     boost::shared_ptr<channel>
     at(std::size_t cid) const = 0;
 
-    /// Process a serialized message from a user
+    /** Process a serialized message from a user
+
+        @returns The error to complete the request with, if
+        the request failed before it could be completed.
+    */
     virtual
-    void
+    beast::error_code
     dispatch(rpc_call& rpc) = 0;
 
+    /// Return the pool which runs methods marked `async`
+    virtual
+    ::rpc_pool&
+    rpc_pool() = 0;
+
     template<class T, class...  Args>
     friend
     void
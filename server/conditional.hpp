@@ -0,0 +1,395 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_CONDITIONAL_HPP
+#define LOUNGE_CONDITIONAL_HPP
+
+#include "config.hpp"
+#include <boost/beast/core/string.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+
+/*
+    Helpers for conditional requests (RFC 7232)
+    and range requests (RFC 7233).
+*/
+
+namespace detail {
+
+// Days since 1970-01-01 of a proleptic Gregorian date
+inline
+std::int64_t
+days_from_civil(
+    std::int64_t y,
+    unsigned m,
+    unsigned d) noexcept
+{
+    y -= m <= 2;
+    std::int64_t const era = (y >= 0 ? y : y - 399) / 400;
+    auto const yoe = static_cast<unsigned>(y - era * 400);
+    auto const doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    auto const doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<std::int64_t>(doe) - 719468;
+}
+
+inline
+bool
+parse_digits(
+    beast::string_view s,
+    unsigned& v) noexcept
+{
+    v = 0;
+    for(auto c : s)
+    {
+        if(c < '0' || c > '9')
+            return false;
+        v = 10 * v + static_cast<unsigned>(c - '0');
+    }
+    return ! s.empty();
+}
+
+} // detail
+
+/** Format a time as an IMF-fixdate
+
+    For example, `Sun, 06 Nov 1994 08:49:37 GMT`.
+*/
+inline
+std::string
+format_http_date(std::time_t t)
+{
+    static char const* const days[] = {
+        "Thu", "Fri", "Sat", "Sun", "Mon", "Tue", "Wed" };
+    static char const* const months[] = {
+        "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+        "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+    auto const secs = static_cast<std::int64_t>(t);
+    auto z = (secs >= 0 ? secs : secs - 86399) / 86400;
+    auto const sod = static_cast<unsigned>(secs - z * 86400);
+    auto const wday = static_cast<unsigned>(
+        ((z % 7) + 7) % 7);
+
+    // civil from days
+    z += 719468;
+    std::int64_t const era = (z >= 0 ? z : z - 146096) / 146097;
+    auto const doe = static_cast<unsigned>(z - era * 146097);
+    auto const yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    auto const doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    auto const mp = (5 * doy + 2) / 153;
+    auto const d = doy - (153 * mp + 2) / 5 + 1;
+    auto const m = mp < 10 ? mp + 3 : mp - 9;
+    auto const y = static_cast<std::int64_t>(yoe) + era * 400 + (m <= 2);
+
+    char buf[64];
+    std::snprintf(buf, sizeof(buf),
+        "%s, %02u %s %04lld %02u:%02u:%02u GMT",
+        days[wday], d, months[m - 1],
+        static_cast<long long>(y),
+        sod / 3600, sod / 60 % 60, sod % 60);
+    return buf;
+}
+
+/** Parse an IMF-fixdate
+
+    The obsolete RFC 850 and asctime formats are not
+    accepted; a field using them is treated as absent.
+
+    @returns `false` if the string is not a valid date.
+*/
+inline
+bool
+parse_http_date(
+    beast::string_view s,
+    std::time_t& t)
+{
+    static char const* const months[] = {
+        "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+        "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+    // Sun, 06 Nov 1994 08:49:37 GMT
+    if( s.size() != 29 ||
+        s[3] != ',' || s[4] != ' ' || s[7] != ' ' ||
+        s[11] != ' ' || s[16] != ' ' || s[19] != ':' ||
+        s[22] != ':' || s.substr(25) != " GMT")
+        return false;
+    unsigned d, y, hh, mm, ss;
+    if( ! detail::parse_digits(s.substr(5, 2), d) ||
+        ! detail::parse_digits(s.substr(12, 4), y) ||
+        ! detail::parse_digits(s.substr(17, 2), hh) ||
+        ! detail::parse_digits(s.substr(20, 2), mm) ||
+        ! detail::parse_digits(s.substr(23, 2), ss))
+        return false;
+    unsigned m = 0;
+    while(m < 12 && s.substr(8, 3) != months[m])
+        ++m;
+    if( m == 12 || d < 1 || d > 31 ||
+        hh > 23 || mm > 59 || ss > 60)
+        return false;
+    t = static_cast<std::time_t>(
+        detail::days_from_civil(y, m + 1, d) * 86400 +
+        hh * 3600 + mm * 60 + ss);
+    return true;
+}
+
+/** Return a strong entity tag for a file
+
+    The tag is derived from the modification time and
+    size, so it is computed without reading the file.
+
+    @param suffix Distinguishes encoded representations
+    of the same file, for example "gzip".
+*/
+inline
+std::string
+make_etag(
+    std::time_t mtime,
+    std::uint64_t size,
+    beast::string_view suffix = {})
+{
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "\"%llx-%llx",
+        static_cast<unsigned long long>(mtime),
+        static_cast<unsigned long long>(size));
+    std::string s = buf;
+    if(! suffix.empty())
+    {
+        s.push_back('-');
+        s.append(suffix.data(), suffix.size());
+    }
+    s.push_back('"');
+    return s;
+}
+
+/** Returns `true` if an If-None-Match list matches an entity tag.
+
+    This uses the weak comparison function.
+*/
+inline
+bool
+etag_matches(
+    beast::string_view list,
+    beast::string_view etag)
+{
+    if(etag.size() > 2 && etag.starts_with("W/"))
+        etag.remove_prefix(2);
+    while(! list.empty())
+    {
+        auto const c = list.front();
+        if(c == ' ' || c == '\t' || c == ',')
+        {
+            list.remove_prefix(1);
+            continue;
+        }
+        if(c == '*')
+            return true;
+        if(list.starts_with("W/"))
+            list.remove_prefix(2);
+        if(list.empty() || list.front() != '"')
+            return false;
+        auto const end = list.find('"', 1);
+        if(end == beast::string_view::npos)
+            return false;
+        if(list.substr(0, end + 1) == etag)
+            return true;
+        list.remove_prefix(end + 1);
+    }
+    return false;
+}
+
+/** Returns `true` if a GET or HEAD may be answered with 304 Not Modified.
+
+    If-None-Match takes precedence, and If-Modified-Since
+    is only considered when it is absent.
+*/
+inline
+bool
+is_not_modified(
+    beast::string_view if_none_match,
+    beast::string_view if_modified_since,
+    beast::string_view etag,
+    std::time_t mtime)
+{
+    if(! if_none_match.empty())
+        return etag_matches(if_none_match, etag);
+    std::time_t t;
+    if( ! if_modified_since.empty() &&
+        parse_http_date(if_modified_since, t))
+        return mtime <= t;
+    return false;
+}
+
+/** Returns `true` if the Range field of a request should be honored.
+
+    @param if_range The value of the If-Range field, which
+    holds either an entity tag, compared strongly, or a date
+    which must exactly match the modification time.
+*/
+inline
+bool
+is_range_current(
+    beast::string_view if_range,
+    beast::string_view etag,
+    std::time_t mtime)
+{
+    if(if_range.empty())
+        return true;
+    if( if_range.front() == '"' ||
+        if_range.starts_with("W/"))
+        return if_range == etag;
+    std::time_t t;
+    return parse_http_date(if_range, t) && t == mtime;
+}
+
+//------------------------------------------------------------------------------
+
+/// An inclusive range of byte positions
+struct byte_range
+{
+    std::uint64_t first;
+    std::uint64_t last;
+
+    std::uint64_t
+    size() const noexcept
+    {
+        return last - first + 1;
+    }
+};
+
+/// The outcome of parsing a Range field
+enum class range_status
+{
+    /// The field is absent, invalid, or too complex; send the whole file
+    ignore,
+
+    /// At least one range is satisfiable
+    partial,
+
+    /// No range is satisfiable; send 416
+    unsatisfiable
+};
+
+/** Parse the value of a Range field against a representation size.
+
+    Unsatisfiable ranges are dropped, and the remaining ranges
+    are clamped to the size.
+
+    @param s The value of the Range field.
+
+    @param size The size of the representation.
+
+    @param v Receives the satisfiable ranges, in request order.
+
+    @param max_ranges A field with more ranges than this is
+    ignored, to limit the cost of abusive requests.
+*/
+inline
+range_status
+parse_range(
+    beast::string_view s,
+    std::uint64_t size,
+    std::vector<byte_range>& v,
+    std::size_t max_ranges = 16)
+{
+    auto const ignore =
+        [&v]
+        {
+            v.clear();
+            return range_status::ignore;
+        };
+
+    v.clear();
+    if(! s.starts_with("bytes="))
+        return ignore();
+    s.remove_prefix(6);
+
+    auto const parse_number =
+        [](beast::string_view& s, std::uint64_t& n)
+        {
+            std::size_t i = 0;
+            n = 0;
+            while(i < s.size() && s[i] >= '0' && s[i] <= '9')
+            {
+                if(n > (UINT64_MAX - 9) / 10)
+                    return false;
+                n = 10 * n + static_cast<unsigned>(s[i] - '0');
+                ++i;
+            }
+            s.remove_prefix(i);
+            return i > 0;
+        };
+
+    std::size_t count = 0;
+    for(;;)
+    {
+        while(! s.empty() && (s.front() == ' ' || s.front() == '\t'))
+            s.remove_prefix(1);
+        if(s.empty())
+            break;
+        if(s.front() == ',')
+        {
+            s.remove_prefix(1);
+            continue;
+        }
+        if(++count > max_ranges)
+            return ignore();
+
+        std::uint64_t first;
+        std::uint64_t last;
+        if(s.front() == '-')
+        {
+            // suffix-byte-range-spec
+            s.remove_prefix(1);
+            std::uint64_t n;
+            if(! parse_number(s, n))
+                return ignore();
+            if(n == 0 || size == 0)
+                continue;
+            first = n < size ? size - n : 0;
+            last = size - 1;
+        }
+        else
+        {
+            if(! parse_number(s, first))
+                return ignore();
+            if(s.empty() || s.front() != '-')
+                return ignore();
+            s.remove_prefix(1);
+            if(! s.empty() && s.front() >= '0' && s.front() <= '9')
+            {
+                if(! parse_number(s, last) || last < first)
+                    return ignore();
+            }
+            else
+            {
+                last = UINT64_MAX;
+            }
+            if(first >= size)
+                continue;
+            if(last >= size)
+                last = size - 1;
+        }
+        v.push_back({first, last});
+
+        while(! s.empty() && (s.front() == ' ' || s.front() == '\t'))
+            s.remove_prefix(1);
+        if(! s.empty() && s.front() != ',')
+            return ignore();
+    }
+    if(count == 0)
+        return ignore();
+    if(v.empty())
+        return range_status::unsatisfiable;
+    return range_status::partial;
+}
+
+#endif
@@ -0,0 +1,158 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_CONTENT_CODING_HPP
+#define LOUNGE_CONTENT_CODING_HPP
+
+#include "config.hpp"
+#include <boost/beast/core/string.hpp>
+#include <boost/beast/zlib/deflate_stream.hpp>
+#include <boost/assert.hpp>
+#include <boost/crc.hpp>
+#include <cstdint>
+#include <string>
+
+/// Content codings which a client accepts, as bit flags
+enum content_coding : unsigned
+{
+    coding_gzip = 1,
+    coding_br   = 2
+};
+
+/** Return the content codings accepted by a client.
+
+    Codings with a quality value of zero are excluded,
+    and the wildcard `*` accepts every coding which is
+    not excluded.
+
+    @param s The value of the Accept-Encoding field.
+
+    @returns A combination of @ref content_coding flags.
+*/
+inline
+unsigned
+parse_accept_encoding(beast::string_view s)
+{
+    using beast::iequals;
+    auto const trim =
+        [](beast::string_view v)
+        {
+            while(! v.empty() && (v.front() == ' ' || v.front() == '\t'))
+                v.remove_prefix(1);
+            while(! v.empty() && (v.back() == ' ' || v.back() == '\t'))
+                v.remove_suffix(1);
+            return v;
+        };
+    unsigned accept = 0;
+    unsigned reject = 0;
+    bool any = false;
+    while(! s.empty())
+    {
+        // coding *( OWS ";" OWS name "=" value )
+        auto pos = s.find(',');
+        auto item = s.substr(0, pos);
+        s.remove_prefix(pos == beast::string_view::npos ?
+            s.size() : pos + 1);
+        pos = item.find(';');
+        auto const coding = trim(item.substr(0, pos));
+        bool zero = false;
+        while(pos != beast::string_view::npos)
+        {
+            item.remove_prefix(pos + 1);
+            pos = item.find(';');
+            auto const param = trim(item.substr(0, pos));
+            if( param.size() >= 2 &&
+                iequals(param.substr(0, 2), "q="))
+                zero = trim(param.substr(2)).find_first_not_of(
+                    "0.") == beast::string_view::npos;
+        }
+        unsigned bit = 0;
+        if( iequals(coding, "gzip") ||
+            iequals(coding, "x-gzip"))
+            bit = coding_gzip;
+        else if(iequals(coding, "br"))
+            bit = coding_br;
+        else if(coding == "*")
+            any = ! zero;
+        if(zero)
+            reject |= bit;
+        else
+            accept |= bit;
+    }
+    if(any)
+        accept |= coding_gzip | coding_br;
+    return accept & ~reject;
+}
+
+/// Returns `true` if content of a mime type is worth compressing
+inline
+bool
+is_compressible(beast::string_view type)
+{
+    return
+        type.starts_with("text/") ||
+        type == "application/javascript" ||
+        type == "application/json" ||
+        type == "application/xml" ||
+        type == "image/svg+xml";
+}
+
+/** Compress data into the gzip file format (RFC 1952).
+
+    @param in The data to compress.
+
+    @param level The deflate compression level, from 0 to 9.
+*/
+inline
+std::string
+gzip_compress(
+    beast::string_view in,
+    int level = 9)
+{
+    namespace zlib = beast::zlib;
+
+    static char const header[10] = {
+        '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, 3 };
+
+    zlib::deflate_stream ds;
+    ds.reset(level, 15, 8, zlib::Strategy::normal);
+
+    // One call suffices when the output
+    // can hold the worst case expansion.
+    std::string out;
+    out.resize(sizeof(header) +
+        ds.upper_bound(in.size()) + 8);
+    out.replace(0, sizeof(header), header, sizeof(header));
+    zlib::z_params zs;
+    zs.next_in = in.data();
+    zs.avail_in = in.size();
+    zs.next_out = &out[sizeof(header)];
+    zs.avail_out = out.size() - sizeof(header);
+    beast::error_code ec;
+    ds.write(zs, zlib::Flush::finish, ec);
+    BOOST_ASSERT(ec == zlib::error::end_of_stream);
+    out.resize(sizeof(header) + zs.total_out);
+
+    // The trailer holds the CRC-32 and the
+    // input size modulo 2^32, little endian.
+    boost::crc_32_type crc;
+    crc.process_bytes(in.data(), in.size());
+    auto const append32 =
+        [&out](std::uint32_t v)
+        {
+            for(int i = 0; i < 4; ++i)
+                out.push_back(static_cast<char>(
+                    (v >> (8 * i)) & 0xff));
+        };
+    append32(crc.checksum());
+    append32(static_cast<std::uint32_t>(in.size()));
+    return out;
+}
+
+#endif
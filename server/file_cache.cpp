@@ -0,0 +1,660 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#include "file_cache.hpp"
+#include "conditional.hpp"
+#include "logger.hpp"
+#include "server.hpp"
+#include <boost/beast/core/bind_handler.hpp>
+#include <boost/beast/core/file.hpp>
+#include <boost/beast/version.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/make_unique.hpp>
+#include <boost/smart_ptr/make_shared.hpp>
+#include <boost/smart_ptr/weak_ptr.hpp>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <openssl/sha.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+class file_cache_impl : public file_cache
+{
+    // The representations of one file
+    struct element
+    {
+        boost::shared_ptr<cached_file const> identity;
+        boost::shared_ptr<cached_file const> gzip;
+        boost::shared_ptr<cached_file const> br;
+    };
+
+    using item = std::pair<std::string, element>;
+
+    // A file being read without the mutex held
+    struct loading
+    {
+        std::size_t count = 0;
+        bool changed = false;
+    };
+
+    server& srv_;
+    section& log_;
+    std::size_t const max_bytes_;
+    std::size_t const max_file_;
+
+    std::mutex mutex_;
+    std::size_t bytes_ = 0;
+
+    // most recently used at the front
+    std::list<item> lru_;
+    std::unordered_map<std::string,
+        std::list<item>::iterator> map_;
+
+    // A change to a file during its load finds nothing
+    // to evict, so it is recorded here instead
+    std::unordered_map<std::string, loading> loading_;
+
+    // gzipped bodies by SHA-256 of the content, so unchanged
+    // content is not compressed again when reloaded
+    std::unordered_map<std::string, boost::weak_ptr<
+        std::string const>> gzipped_;
+
+    // runs the blocking file reads
+    net::thread_pool pool_;
+
+#ifdef __linux__
+    net::posix::basic_stream_descriptor<
+        executor_type> desc_;
+
+    // watch descriptor to directory, and back
+    std::unordered_map<int, std::string> wd_;
+    std::unordered_map<std::string, int> dirs_;
+
+    alignas(inotify_event) char buf_[4096];
+    bool watching_ = false;
+#endif
+
+public:
+    file_cache_impl(
+        server& srv,
+        std::size_t max_bytes,
+        std::size_t threads)
+        : srv_(srv)
+        , log_(srv_.log().get_section("file_cache"))
+        , max_bytes_(max_bytes)
+        , max_file_(max_bytes / 4)
+        , pool_(threads > 0 ? threads : 1)
+    #ifdef __linux__
+        , desc_(srv_.make_executor())
+    #endif
+    {
+    #ifdef __linux__
+        auto const fd = ::inotify_init1(
+            IN_NONBLOCK | IN_CLOEXEC);
+        if(fd >= 0)
+        {
+            desc_.assign(fd);
+            watching_ = true;
+        }
+        else
+            LOG_INF(log_, "inotify_init1\t",
+                beast::error_code(errno,
+                    boost::system::generic_category()).message());
+    #endif
+    }
+
+    //--------------------------------------------------------------------------
+    //
+    // service
+    //
+    //--------------------------------------------------------------------------
+
+    void
+    on_start() override
+    {
+    #ifdef __linux__
+        if(watching_)
+            do_read();
+    #endif
+    }
+
+    void
+    on_stop() override
+    {
+        // Abandon pending loads
+        pool_.stop();
+
+    #ifdef __linux__
+        net::post(
+            desc_.get_executor(),
+            [this]
+            {
+                beast::error_code ec;
+                desc_.close(ec);
+            });
+    #endif
+    }
+
+    //--------------------------------------------------------------------------
+    //
+    // file_cache
+    //
+    //--------------------------------------------------------------------------
+
+    boost::shared_ptr<cached_file const>
+    find(
+        std::string const& path,
+        unsigned accept) override
+    {
+        if(max_bytes_ == 0)
+            return nullptr;
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = map_.find(path);
+        if(it == map_.end())
+            return nullptr;
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return select(it->second->second, accept);
+    }
+
+    void
+    async_get(
+        std::string const& path,
+        unsigned accept,
+        executor_type ex,
+        handler_type handler) override
+    {
+        // Nothing is cached, so don't visit the pool
+        if(max_bytes_ == 0)
+            return net::post(ex,
+                [handler]
+                {
+                    handler({}, nullptr);
+                });
+        net::post(
+            pool_,
+            [this, path, accept, ex, handler]
+            {
+                beast::error_code ec;
+                auto sp = get(path, accept, ec);
+                net::post(ex,
+                    [ec, sp, handler]
+                    {
+                        handler(ec, sp);
+                    });
+            });
+    }
+
+    net::thread_pool::executor_type
+    io_executor() noexcept override
+    {
+        return pool_.get_executor();
+    }
+
+    void
+    erase(std::string const& path) override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        changed(path);
+    }
+
+private:
+    // Blocking, called on the file I/O pool
+    boost::shared_ptr<cached_file const>
+    get(
+        std::string const& path,
+        unsigned accept,
+        beast::error_code& ec)
+    {
+        ec = {};
+        if(max_bytes_ == 0)
+            return nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = map_.find(path);
+            if(it != map_.end())
+            {
+                lru_.splice(lru_.begin(), lru_, it->second);
+                return select(it->second->second, accept);
+            }
+            ++loading_[path].count;
+        }
+
+        // Load the file without holding the lock
+        element e;
+        bool const loaded = load(path, e, ec);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto const it = loading_.find(path);
+        bool const stale = it->second.changed;
+        if(--it->second.count == 0)
+            loading_.erase(it);
+        if(! loaded)
+            return nullptr;
+        if(stale)
+        {
+            // The file changed while it was read,
+            // so serve this copy without keeping it.
+            LOG_TRC(log_, "stale\t", path);
+            return select(e, accept);
+        }
+        auto result = map_.emplace(path, lru_.end());
+        if(! result.second)
+        {
+            // Another thread loaded it first
+            lru_.splice(lru_.begin(), lru_, result.first->second);
+            return select(result.first->second->second, accept);
+        }
+        lru_.emplace_front(path, e);
+        result.first->second = lru_.begin();
+        bytes_ += size_of(e);
+        while(bytes_ > max_bytes_)
+            evict(std::prev(lru_.end()));
+        return select(e, accept);
+    }
+
+    static
+    boost::shared_ptr<cached_file const> const&
+    select(
+        element const& e,
+        unsigned accept) noexcept
+    {
+        if((accept & coding_br) && e.br)
+            return e.br;
+        if((accept & coding_gzip) && e.gzip)
+            return e.gzip;
+        return e.identity;
+    }
+
+    static
+    std::size_t
+    size_of(element const& e) noexcept
+    {
+        std::size_t n = 0;
+        for(auto const p : { &e.identity, &e.gzip, &e.br })
+            if(*p)
+                n += (*p)->header.size() + (*p)->body->size();
+        return n;
+    }
+
+    // Forget a file which changed, with the mutex held
+    void
+    changed(std::string const& path)
+    {
+        auto const it = map_.find(path);
+        if(it != map_.end())
+            evict(it->second);
+        auto const l = loading_.find(path);
+        if(l != loading_.end())
+            l->second.changed = true;
+    }
+
+    // Remove an entry, with the mutex held
+    void
+    evict(std::list<item>::iterator it)
+    {
+        LOG_TRC(log_, "evict\t", it->first);
+        bytes_ -= size_of(it->second);
+        map_.erase(it->first);
+        lru_.erase(it);
+    }
+
+    // Read an entire file, or return null if it is too
+    // large or an error occurs. The modification time and
+    // size are taken from the opened file once it is watched,
+    // so a change after they are taken is always reported.
+    boost::shared_ptr<std::string const>
+    read_file(
+        std::string const& path,
+        std::time_t& mtime,
+        std::uint64_t& size,
+        beast::error_code& ec)
+    {
+        beast::file f;
+        f.open(path.c_str(), beast::file_mode::scan, ec);
+        if(ec)
+            return nullptr;
+
+        // Watch before reading so a change
+        // made during the read is not missed.
+        watch(path);
+
+    #if BOOST_BEAST_USE_POSIX_FILE
+        struct stat st;
+        bool const ok = ::fstat(f.native_handle(), &st) == 0;
+        if(ok)
+        {
+            mtime = st.st_mtime;
+            size = static_cast<std::uint64_t>(st.st_size);
+        }
+    #else
+        bool const ok = stat_file(path, mtime, size);
+    #endif
+        if(! ok)
+        {
+            ec = beast::error_code(errno,
+                boost::system::generic_category());
+            return nullptr;
+        }
+        if(size > max_file_)
+            return nullptr;
+
+        auto sp = boost::make_shared<std::string>();
+        sp->resize(static_cast<std::size_t>(size));
+        std::size_t n = 0;
+        while(n < sp->size())
+        {
+            auto const bytes_transferred = f.read(
+                &(*sp)[n], sp->size() - n, ec);
+            if(ec)
+                return nullptr;
+            if(bytes_transferred == 0)
+            {
+                // The file shrank while reading
+                sp->resize(n);
+                break;
+            }
+            n += bytes_transferred;
+        }
+        return sp;
+    }
+
+    // Return the gzipped body, compressing it only
+    // if the same content was not seen before.
+    boost::shared_ptr<std::string const>
+    compress(std::string const& body)
+    {
+        // A collision would serve another file's content
+        unsigned char md[SHA256_DIGEST_LENGTH];
+        ::SHA256(reinterpret_cast<unsigned char const*>(
+            body.data()), body.size(), md);
+        std::string h(reinterpret_cast<char const*>(md), sizeof(md));
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = gzipped_.find(h);
+            if(it != gzipped_.end())
+                if(auto sp = it->second.lock())
+                    return sp;
+        }
+
+        auto s = gzip_compress(body);
+        if(s.size() >= body.size())
+            return nullptr;
+        auto sp = boost::make_shared<
+            std::string const>(std::move(s));
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(gzipped_.size() >= 2 * map_.size() + 16)
+        {
+            // Forget bodies of evicted files
+            for(auto it = gzipped_.begin(); it != gzipped_.end();)
+                if(it->second.expired())
+                    it = gzipped_.erase(it);
+                else
+                    ++it;
+        }
+        gzipped_[std::move(h)] = sp;
+        return sp;
+    }
+
+    static
+    boost::shared_ptr<cached_file const>
+    make_file(
+        beast::string_view type,
+        beast::string_view encoding,
+        bool vary,
+        std::time_t mtime,
+        std::uint64_t size,
+        boost::shared_ptr<std::string const> body)
+    {
+        auto sp = boost::make_shared<cached_file>();
+        sp->type = type;
+        sp->etag = make_etag(mtime, size, encoding);
+        sp->mtime = mtime;
+
+        auto& f = sp->fields;
+        f.append("Server: " BOOST_BEAST_VERSION_STRING "\r\n");
+        if(! encoding.empty())
+        {
+            f.append("Content-Encoding: ");
+            f.append(encoding.data(), encoding.size());
+            f.append("\r\n");
+        }
+        if(vary)
+            f.append("Vary: Accept-Encoding\r\n");
+        f.append("ETag: ");
+        f.append(sp->etag);
+        f.append("\r\nLast-Modified: ");
+        f.append(format_http_date(mtime));
+        f.append("\r\nAccept-Ranges: bytes\r\n");
+
+        auto& h = sp->header;
+        h.append("HTTP/1.1 200 OK\r\n");
+        h.append(f);
+        h.append("Content-Type: ");
+        h.append(type.data(), type.size());
+        h.append("\r\nContent-Length: ");
+        h.append(std::to_string(body->size()));
+        h.append("\r\n");
+        sp->body = std::move(body);
+        return sp;
+    }
+
+    bool
+    load(
+        std::string const& path,
+        element& e,
+        beast::error_code& ec)
+    {
+        // The validators come from the uncompressed file
+        std::time_t mtime;
+        std::uint64_t size;
+        auto body = read_file(path, mtime, size, ec);
+        if(! body)
+            return false;
+
+        // Precompressed siblings are optional
+        beast::error_code ec2;
+        std::time_t mtime2;
+        std::uint64_t size2;
+        auto const type = mime_type(path);
+        auto br = read_file(path + ".br", mtime2, size2, ec2);
+        auto gz = read_file(path + ".gz", mtime2, size2, ec2);
+        if(! gz && is_compressible(type))
+            gz = compress(*body);
+
+        bool const vary = br || gz;
+        e.identity = make_file(
+            type, {}, vary, mtime, size, std::move(body));
+        if(gz)
+            e.gzip = make_file(
+                type, "gzip", true, mtime, size, std::move(gz));
+        if(br)
+            e.br = make_file(
+                type, "br", true, mtime, size, std::move(br));
+        return true;
+    }
+
+#ifdef __linux__
+    // Watch the directory containing a cached file
+    void
+    watch(std::string const& path)
+    {
+        if(! watching_)
+            return;
+        auto const pos = path.rfind('/');
+        std::string dir = pos == std::string::npos ?
+            std::string(".") : path.substr(0, pos);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(dirs_.count(dir))
+            return;
+        auto const wd = ::inotify_add_watch(
+            desc_.native_handle(), dir.c_str(),
+            IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE |
+            IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+            IN_DELETE_SELF | IN_MOVE_SELF);
+        if(wd < 0)
+        {
+            LOG_INF(log_, "inotify_add_watch\t", dir);
+            return;
+        }
+        wd_[wd] = dir;
+        dirs_.emplace(std::move(dir), wd);
+    }
+
+    void
+    do_read()
+    {
+        desc_.async_read_some(
+            net::buffer(buf_),
+            beast::bind_front_handler(
+                &file_cache_impl::on_read,
+                this));
+    }
+
+    void
+    on_read(
+        beast::error_code ec,
+        std::size_t bytes_transferred)
+    {
+        if(ec)
+        {
+            if(ec != net::error::operation_aborted)
+                LOG_INF(log_, "inotify\t", ec.message());
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto p = buf_;
+        auto const end = buf_ + bytes_transferred;
+        while(p < end)
+        {
+            auto const& e =
+                *reinterpret_cast<inotify_event const*>(p);
+            p += sizeof(inotify_event) + e.len;
+
+            if(e.mask & (IN_Q_OVERFLOW |
+                IN_DELETE_SELF | IN_MOVE_SELF))
+            {
+                // Events were lost or a whole
+                // directory went away.
+                LOG_TRC(log_, "clear");
+                lru_.clear();
+                map_.clear();
+                bytes_ = 0;
+                for(auto& l : loading_)
+                    l.second.changed = true;
+                continue;
+            }
+            auto it = wd_.find(e.wd);
+            if(it == wd_.end())
+                continue;
+            if(e.mask & IN_IGNORED)
+            {
+                dirs_.erase(it->second);
+                wd_.erase(it);
+                continue;
+            }
+            if(e.len == 0)
+                continue;
+            auto path = it->second + '/' + std::string(e.name);
+            auto const n = path.size();
+            if( n > 3 && (
+                path.compare(n - 3, 3, ".gz") == 0 ||
+                path.compare(n - 3, 3, ".br") == 0))
+            {
+                // A compressed sibling changed
+                path.resize(n - 3);
+            }
+            changed(path);
+        }
+
+        do_read();
+    }
+#else
+    void
+    watch(std::string const&)
+    {
+    }
+#endif
+};
+
+} // (anon)
+
+//------------------------------------------------------------------------------
+
+beast::string_view
+mime_type(beast::string_view path)
+{
+    using beast::iequals;
+    auto const ext = [&path]
+    {
+        auto const pos = path.rfind(".");
+        if(pos == beast::string_view::npos)
+            return beast::string_view{};
+        return path.substr(pos);
+    }();
+    if(iequals(ext, ".htm"))  return "text/html";
+    if(iequals(ext, ".html")) return "text/html";
+    if(iequals(ext, ".php"))  return "text/html";
+    if(iequals(ext, ".css"))  return "text/css";
+    if(iequals(ext, ".txt"))  return "text/plain";
+    if(iequals(ext, ".js"))   return "application/javascript";
+    if(iequals(ext, ".json")) return "application/json";
+    if(iequals(ext, ".xml"))  return "application/xml";
+    if(iequals(ext, ".swf"))  return "application/x-shockwave-flash";
+    if(iequals(ext, ".flv"))  return "video/x-flv";
+    if(iequals(ext, ".png"))  return "image/png";
+    if(iequals(ext, ".jpe"))  return "image/jpeg";
+    if(iequals(ext, ".jpeg")) return "image/jpeg";
+    if(iequals(ext, ".jpg"))  return "image/jpeg";
+    if(iequals(ext, ".gif"))  return "image/gif";
+    if(iequals(ext, ".bmp"))  return "image/bmp";
+    if(iequals(ext, ".ico"))  return "image/vnd.microsoft.icon";
+    if(iequals(ext, ".tiff")) return "image/tiff";
+    if(iequals(ext, ".tif"))  return "image/tiff";
+    if(iequals(ext, ".svg"))  return "image/svg+xml";
+    if(iequals(ext, ".svgz")) return "image/svg+xml";
+    return "application/text";
+}
+
+bool
+stat_file(
+    std::string const& path,
+    std::time_t& mtime,
+    std::uint64_t& size)
+{
+    struct stat st;
+    if(::stat(path.c_str(), &st) != 0)
+        return false;
+    mtime = st.st_mtime;
+    size = static_cast<std::uint64_t>(st.st_size);
+    return true;
+}
+
+std::unique_ptr<file_cache>
+make_file_cache(
+    server& srv,
+    std::size_t max_bytes,
+    std::size_t threads)
+{
+    return boost::make_unique<file_cache_impl>(
+        srv, max_bytes, threads);
+}
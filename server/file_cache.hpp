@@ -0,0 +1,152 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_FILE_CACHE_HPP
+#define LOUNGE_FILE_CACHE_HPP
+
+#include "config.hpp"
+#include "content_coding.hpp"
+#include "service.hpp"
+#include "types.hpp"
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/core/string.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/smart_ptr/shared_ptr.hpp>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <string>
+
+/** A static file held in memory with its serialized response header.
+
+    The header holds the status line and fields of a
+    `200 OK` response, without the `Connection` field and
+    without the empty line which ends the header. Those
+    depend on the request and are appended when sending,
+    so one entry serves every client.
+
+    The body may be shared with other entries having the
+    same content.
+*/
+struct cached_file
+{
+    /// The complete `200 OK` header
+    std::string header;
+
+    /** Fields common to every response for the file.
+
+        These are the fields of the header which do not
+        depend on the status, for building `206` and
+        `304` responses.
+    */
+    std::string fields;
+
+    /// The value of the Content-Type field
+    beast::string_view type;
+
+    /// The strong entity tag of this representation
+    std::string etag;
+
+    /// The modification time of the file
+    std::time_t mtime = 0;
+
+    boost::shared_ptr<std::string const> body;
+};
+
+//------------------------------------------------------------------------------
+
+/** An in-memory cache of files under the document root.
+
+    Entries are evicted in least recently used order when
+    the total size exceeds the configured limit, and are
+    discarded when the file changes on disk.
+*/
+class file_cache : public service
+{
+public:
+    /// The type of function invoked when a file is loaded
+    using handler_type = std::function<void(
+        beast::error_code,
+        boost::shared_ptr<cached_file const>)>;
+
+    /** Return a file if it is in the cache.
+
+        This never touches the disk.
+
+        @param path The filesystem path of the file.
+
+        @param accept The @ref content_coding flags accepted
+        by the client. The smallest acceptable representation
+        is returned.
+
+        @returns The cached file, or null on a miss.
+    */
+    virtual
+    boost::shared_ptr<cached_file const>
+    find(
+        std::string const& path,
+        unsigned accept) = 0;
+
+    /** Return a file from the cache, loading it on a miss.
+
+        The file is read on the file I/O pool, so the calling
+        thread never blocks on the disk. Compressed
+        representations are loaded from `.br` and `.gz` files
+        next to the file when they exist, otherwise
+        compressible types are gzipped once when loaded.
+
+        @param path The filesystem path of the file.
+
+        @param accept The accepted @ref content_coding flags.
+
+        @param ex The executor used to invoke the handler.
+
+        @param handler Invoked with the error if any, and the
+        cached file, which is null if the file is too large
+        to be cached or an error occurred.
+    */
+    virtual
+    void
+    async_get(
+        std::string const& path,
+        unsigned accept,
+        executor_type ex,
+        handler_type handler) = 0;
+
+    /** Return the executor of the file I/O pool.
+
+        Blocking reads of static files are performed
+        on this pool instead of the network threads.
+    */
+    virtual
+    net::thread_pool::executor_type
+    io_executor() noexcept = 0;
+
+    /// Discard a file from the cache if present
+    virtual
+    void
+    erase(std::string const& path) = 0;
+};
+
+/// Return a reasonable mime type based on the extension of a file.
+beast::string_view
+mime_type(beast::string_view path);
+
+/** Return the modification time and size of a file.
+
+    @returns `false` if the file could not be examined,
+    with the reason in `errno`.
+*/
+bool
+stat_file(
+    std::string const& path,
+    std::time_t& mtime,
+    std::uint64_t& size);
+
+#endif
@@ -0,0 +1,211 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_FILE_OP_HPP
+#define LOUNGE_FILE_OP_HPP
+
+#include "config.hpp"
+#include "content_coding.hpp"
+#include "file_cache.hpp"
+#include "file_range_body.hpp"
+#include "types.hpp"
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/core/string.hpp>
+#include <boost/beast/http/error.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/serializer.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <utility>
+
+#ifdef LOUNGE_IO_URING
+#include <boost/asio/basic_random_access_file.hpp>
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+// The size of each read when streaming a file body
+std::size_t const file_chunk_size = 64 * 1024;
+
+/** A file which is not in the file cache, opened for a response.
+
+    Opening and examining a file touches the disk, so this
+    is produced by @ref open_file on the file I/O pool.
+*/
+struct opened_file
+{
+    // The file, or the precompressed sibling to send
+    file_range_body::value_type body;
+
+    // The content coding of the body, or empty
+    beast::string_view encoding;
+
+    // The validators of the uncompressed file
+    std::time_t mtime = 0;
+    std::uint64_t identity_size = 0;
+
+    // `true` if a precompressed sibling exists, so the
+    // response depends on Accept-Encoding even when the
+    // sibling is not sent.
+    bool vary = false;
+
+    // Set if the file could not be opened
+    beast::error_code ec;
+};
+
+/** Open a file, or a precompressed sibling the client accepts.
+
+    This blocks, so it is called on the file I/O pool.
+*/
+inline
+opened_file
+open_file(
+    std::string const& path,
+    unsigned accept)
+{
+    opened_file f;
+    auto& ec = f.ec;
+    if(accept & coding_br)
+    {
+        f.body.open((path + ".br").c_str(), ec);
+        if(! ec)
+            f.encoding = "br";
+    }
+    if(f.encoding.empty() && (accept & coding_gzip))
+    {
+        f.body.open((path + ".gz").c_str(), ec);
+        if(! ec)
+            f.encoding = "gzip";
+    }
+    if(f.encoding.empty())
+        f.body.open(path.c_str(), ec);
+    if(ec)
+        return f;
+
+    // Validators match those of the file cache
+    f.identity_size = f.body.size();
+    stat_file(path, f.mtime, f.identity_size);
+
+    f.vary = ! f.encoding.empty();
+    if(! f.vary)
+    {
+        std::time_t t;
+        std::uint64_t n;
+        f.vary =
+            stat_file(path + ".br", t, n) ||
+            stat_file(path + ".gz", t, n);
+    }
+    return f;
+}
+
+/** A file response being written in pieces.
+
+    The header is serialized with `sr`, then the body is
+    read into `buf` one chunk at a time and written out.
+*/
+struct file_op
+{
+    http::response<file_range_body> res;
+    http::response_serializer<file_range_body> sr;
+    std::uint64_t offset;
+    std::uint64_t remain;
+    std::size_t n = 0;
+    std::unique_ptr<char[]> buf;
+
+    explicit
+    file_op(http::response<file_range_body>&& res_)
+        : res(std::move(res_))
+        , sr(res)
+        , offset(res.body().offset())
+        , remain(res.body().size())
+    {
+    }
+
+    // Read the next chunk into the buffer. This
+    // blocks, so it is called on the file I/O pool.
+    void
+    read(beast::error_code& ec)
+    {
+        auto& f = res.body().file();
+        if(! buf)
+        {
+            buf.reset(new char[file_chunk_size]);
+            f.seek(offset, ec);
+            if(ec)
+                return;
+        }
+        n = f.read(buf.get(), static_cast<std::size_t>(
+            (std::min<std::uint64_t>)(remain, file_chunk_size)), ec);
+        if(ec)
+            return;
+        if(n == 0)
+        {
+            // The file was truncated
+            ec = http::error::short_read;
+            return;
+        }
+        offset += n;
+        remain -= n;
+    }
+
+#ifdef LOUNGE_IO_URING
+    // The body, for reads submitted to the ring
+    std::unique_ptr<net::basic_random_access_file<
+        executor_type>> raf;
+
+    // Prepare to read through the ring. The descriptor
+    // is duplicated, since the body closes its own.
+    void
+    open(executor_type const& ex, beast::error_code& ec)
+    {
+        buf.reset(new char[file_chunk_size]);
+        raf.reset(new net::basic_random_access_file<
+            executor_type>(ex));
+        int const fd = ::dup(res.body().file().native_handle());
+        if(fd < 0)
+        {
+            ec.assign(errno, beast::system_category());
+            return;
+        }
+        raf->assign(fd, ec);
+        if(ec)
+            ::close(fd);
+    }
+
+    // Returns the size of the next read
+    std::size_t
+    chunk() const noexcept
+    {
+        return static_cast<std::size_t>(
+            (std::min<std::uint64_t>)(remain, file_chunk_size));
+    }
+
+    // Called when a read from the ring completes
+    void
+    on_read(beast::error_code& ec, std::size_t bytes_transferred)
+    {
+        n = bytes_transferred;
+        if(ec == net::error::eof || (! ec && n == 0))
+        {
+            // The file was truncated
+            ec = http::error::short_read;
+            return;
+        }
+        if(ec)
+            return;
+        offset += n;
+        remain -= n;
+    }
+#endif
+};
+
+#endif
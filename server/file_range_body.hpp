@@ -0,0 +1,168 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_FILE_RANGE_BODY_HPP
+#define LOUNGE_FILE_RANGE_BODY_HPP
+
+#include "config.hpp"
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/core/file.hpp>
+#include <boost/beast/http/error.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/optional.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+/** A body which holds a contiguous range of an open file.
+
+    This works like `http::file_body`, except that the body
+    may start at any offset and end before the end of the
+    file, which is needed for 206 Partial Content responses.
+    Only serialization is supported.
+*/
+struct file_range_body
+{
+    class value_type
+    {
+        friend struct file_range_body;
+
+        beast::file file_;
+        std::uint64_t offset_ = 0;
+        std::uint64_t size_ = 0;
+
+    public:
+        value_type() = default;
+        value_type(value_type&&) = default;
+        value_type& operator=(value_type&&) = default;
+
+        /// Return the open file
+        beast::file&
+        file() noexcept
+        {
+            return file_;
+        }
+
+        /// Return the position in the file of the first byte
+        std::uint64_t
+        offset() const noexcept
+        {
+            return offset_;
+        }
+
+        /// Return the number of bytes in the body
+        std::uint64_t
+        size() const noexcept
+        {
+            return size_;
+        }
+
+        /// Returns `true` if the file is open
+        bool
+        is_open() const noexcept
+        {
+            return file_.is_open();
+        }
+
+        /** Open a file, setting the range to the entire file.
+
+            @param path The path of the file.
+
+            @param ec Set to the error, if any occurred.
+        */
+        void
+        open(
+            char const* path,
+            beast::error_code& ec)
+        {
+            file_.open(path, beast::file_mode::scan, ec);
+            if(ec)
+                return;
+            size_ = file_.size(ec);
+            offset_ = 0;
+            if(ec)
+                file_.close(ec);
+        }
+
+        /** Set the range of the file to send.
+
+            The range must lie within the file.
+        */
+        void
+        range(
+            std::uint64_t offset,
+            std::uint64_t size) noexcept
+        {
+            offset_ = offset;
+            size_ = size;
+        }
+    };
+
+    /// Returns the size of the body
+    static
+    std::uint64_t
+    size(value_type const& body) noexcept
+    {
+        return body.size_;
+    }
+
+    class writer
+    {
+        value_type& body_;
+        std::uint64_t remain_;
+        char buf_[4096];
+
+    public:
+        using const_buffers_type =
+            net::const_buffer;
+
+        template<bool isRequest, class Fields>
+        writer(
+            http::header<isRequest, Fields>&,
+            value_type& body)
+            : body_(body)
+            , remain_(body.size_)
+        {
+        }
+
+        void
+        init(beast::error_code& ec)
+        {
+            body_.file_.seek(body_.offset_, ec);
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>>
+        get(beast::error_code& ec)
+        {
+            auto const amount = static_cast<std::size_t>(
+                (std::min<std::uint64_t>)(remain_, sizeof(buf_)));
+            if(amount == 0)
+            {
+                ec = {};
+                return boost::none;
+            }
+            auto const n = body_.file_.read(buf_, amount, ec);
+            if(ec)
+                return boost::none;
+            if(n == 0)
+            {
+                // The file was truncated
+                ec = http::error::short_read;
+                return boost::none;
+            }
+            remain_ -= n;
+            return {{
+                const_buffers_type{buf_, n},
+                remain_ > 0}};
+        }
+    };
+};
+
+#endif
@@ -0,0 +1,205 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_GATED_STREAM_HPP
+#define LOUNGE_GATED_STREAM_HPP
+
+#include "config.hpp"
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/core/role.hpp>
+#include <boost/beast/core/stream_traits.hpp>
+#include <boost/beast/websocket/teardown.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/basic_waitable_timer.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/write.hpp>
+#include <chrono>
+#include <utility>
+
+/** A stream layer which makes every write complete and exclusive.
+
+    Each call to `async_write_some` transfers all of its
+    bytes before another write may start, and later writes
+    wait their turn in the order they were started. Placed
+    under a `websocket::stream`,
+    this lets a session write whole frames directly to the
+    layer without interleaving them with the control frames
+    which the websocket stream sends on its own.
+
+    Writers must run on the executor of the stream.
+*/
+template<class NextLayer>
+class gated_stream
+{
+public:
+    using executor_type =
+        typename NextLayer::executor_type;
+
+private:
+    using timer_type = net::basic_waitable_timer<
+        std::chrono::steady_clock,
+        net::wait_traits<std::chrono::steady_clock>,
+        executor_type>;
+
+    NextLayer next_;
+    timer_type gate_;
+    std::size_t waiting_ = 0;
+    bool busy_ = false;
+
+    // Hand the gate to the oldest waiting write, if any.
+    // Otherwise a writer which starts again from its
+    // completion handler would always get in first, and
+    // control frames could wait indefinitely.
+    void
+    release()
+    {
+        if(waiting_ > 0 && gate_.cancel_one() > 0)
+        {
+            --waiting_;
+            return;
+        }
+        busy_ = false;
+    }
+
+    template<class ConstBufferSequence>
+    class write_op
+    {
+        gated_stream& s_;
+        ConstBufferSequence b_;
+        bool waited_ = false;
+        bool writing_ = false;
+
+    public:
+        write_op(
+            gated_stream& s,
+            ConstBufferSequence const& b)
+            : s_(s)
+            , b_(b)
+        {
+        }
+
+        template<class Self>
+        void
+        operator()(
+            Self& self,
+            beast::error_code ec = {},
+            std::size_t bytes_transferred = 0)
+        {
+            if(! writing_)
+            {
+                // Wait for the current writer to finish,
+                // which then hands the gate to this one
+                if(! waited_)
+                {
+                    if(s_.busy_)
+                    {
+                        waited_ = true;
+                        ++s_.waiting_;
+                        return s_.gate_.async_wait(
+                            std::move(self));
+                    }
+                    s_.busy_ = true;
+                }
+                writing_ = true;
+                return net::async_write(
+                    s_.next_, b_, std::move(self));
+            }
+            s_.release();
+            self.complete(ec, bytes_transferred);
+        }
+    };
+
+public:
+    /// The type of the next layer
+    using next_layer_type = NextLayer;
+
+    /// Constructor
+    template<class... Args>
+    explicit
+    gated_stream(Args&&... args)
+        : next_(std::forward<Args>(args)...)
+        , gate_(next_.get_executor())
+    {
+        gate_.expires_at((timer_type::time_point::max)());
+    }
+
+    /// Return the executor of the stream
+    executor_type
+    get_executor() noexcept
+    {
+        return next_.get_executor();
+    }
+
+    /// Return the next layer
+    NextLayer&
+    next_layer() noexcept
+    {
+        return next_;
+    }
+
+    /// Return the next layer
+    NextLayer const&
+    next_layer() const noexcept
+    {
+        return next_;
+    }
+
+    template<class MutableBufferSequence, class ReadHandler>
+    BOOST_BEAST_ASYNC_RESULT2(ReadHandler)
+    async_read_some(
+        MutableBufferSequence const& buffers,
+        ReadHandler&& handler)
+    {
+        return next_.async_read_some(buffers,
+            std::forward<ReadHandler>(handler));
+    }
+
+    /** Write all of the buffers, after any earlier writes.
+
+        Unlike most streams, this never performs a
+        partial write unless an error occurs.
+    */
+    template<class ConstBufferSequence, class WriteHandler>
+    BOOST_BEAST_ASYNC_RESULT2(WriteHandler)
+    async_write_some(
+        ConstBufferSequence const& buffers,
+        WriteHandler&& handler)
+    {
+        return net::async_compose<WriteHandler,
+            void(beast::error_code, std::size_t)>(
+                write_op<ConstBufferSequence>(*this, buffers),
+                handler,
+                gate_);
+    }
+};
+
+template<class NextLayer>
+void
+teardown(
+    beast::role_type role,
+    gated_stream<NextLayer>& stream,
+    beast::error_code& ec)
+{
+    using beast::websocket::teardown;
+    teardown(role, stream.next_layer(), ec);
+}
+
+template<class NextLayer, class TeardownHandler>
+void
+async_teardown(
+    beast::role_type role,
+    gated_stream<NextLayer>& stream,
+    TeardownHandler&& handler)
+{
+    using beast::websocket::async_teardown;
+    async_teardown(role, stream.next_layer(),
+        std::forward<TeardownHandler>(handler));
+}
+
+#endif
@@ -7,13 +7,17 @@
 // Official repository: https://github.com/vinniefalco/BeastLounge
 //
 
+#include "conditional.hpp"
+#include "file_cache.hpp"
+#include "file_op.hpp"
 #include "listener.hpp"
 #include "logger.hpp"
+#include "sendfile.hpp"
 #include "server.hpp"
 #include "session.hpp"
 #include "utility.hpp"
 #include <boost/beast/core/stream_traits.hpp>
-#include <boost/beast/http/file_body.hpp>
+#include <boost/beast/http/empty_body.hpp>
 #include <boost/beast/http/read.hpp>
 #include <boost/beast/http/parser.hpp>
 #include <boost/beast/http/write.hpp>
@@ -23,9 +27,17 @@
 #include <boost/asio/coroutine.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/post.hpp>
+#include <boost/asio/write.hpp>
 #include <boost/asio/yield.hpp>
 #include <boost/optional.hpp>
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <vector>
+
+#ifdef LOUNGE_HAS_SENDFILE
+#include <fcntl.h>
+#endif
 
 extern
 void
@@ -48,42 +60,6 @@ run_ws_session(
 
 namespace {
 
-// Return a reasonable mime type based on the extension of a file.
-beast::string_view
-mime_type(beast::string_view path)
-{
-    using beast::iequals;
-    auto const ext = [&path]
-    {
-        auto const pos = path.rfind(".");
-        if(pos == beast::string_view::npos)
-            return beast::string_view{};
-        return path.substr(pos);
-    }();
-    if(iequals(ext, ".htm"))  return "text/html";
-    if(iequals(ext, ".html")) return "text/html";
-    if(iequals(ext, ".php"))  return "text/html";
-    if(iequals(ext, ".css"))  return "text/css";
-    if(iequals(ext, ".txt"))  return "text/plain";
-    if(iequals(ext, ".js"))   return "application/javascript";
-    if(iequals(ext, ".json")) return "application/json";
-    if(iequals(ext, ".xml"))  return "application/xml";
-    if(iequals(ext, ".swf"))  return "application/x-shockwave-flash";
-    if(iequals(ext, ".flv"))  return "video/x-flv";
-    if(iequals(ext, ".png"))  return "image/png";
-    if(iequals(ext, ".jpe"))  return "image/jpeg";
-    if(iequals(ext, ".jpeg")) return "image/jpeg";
-    if(iequals(ext, ".jpg"))  return "image/jpeg";
-    if(iequals(ext, ".gif"))  return "image/gif";
-    if(iequals(ext, ".bmp"))  return "image/bmp";
-    if(iequals(ext, ".ico"))  return "image/vnd.microsoft.icon";
-    if(iequals(ext, ".tiff")) return "image/tiff";
-    if(iequals(ext, ".tif"))  return "image/tiff";
-    if(iequals(ext, ".svg"))  return "image/svg+xml";
-    if(iequals(ext, ".svgz")) return "image/svg+xml";
-    return "application/text";
-}
-
 // Append an HTTP rel-path to a local filesystem path.
 // The returned path is normalized for the platform.
 std::string
@@ -111,32 +87,177 @@ path_cat(
     return result;
 }
 
-// This function produces an HTTP response for the given
-// request. The type of the response object depends on the
-// contents of the request, so the interface requires the
-// caller to pass a generic lambda for receiving the response.
-template<
-    class Body, class Allocator,
-    class Send>
-void
-handle_request(
-    beast::string_view doc_root,
-    http::request<Body, http::basic_fields<Allocator>>&& req,
-    Send&& send)
+// A response whose body comes from the file cache
+struct cached_response
 {
-    // Returns a bad request response
-    auto const bad_request =
-    [&req](beast::string_view why)
+    boost::shared_ptr<cached_file const> file;
+
+    // The header without the Connection field and
+    // the final empty line. When empty, the 200
+    // header stored with the file is used.
+    std::string header;
+
+    // The Connection field and the end of the header
+    beast::string_view tail;
+
+    // The parts of the file body to send, or
+    // empty to send the whole body.
+    std::vector<byte_range> ranges;
+
+    // For multipart/byteranges, the delimiter and part
+    // header before each range, then the closing delimiter.
+    std::vector<std::string> parts;
+
+    bool body = true;
+    bool need_eof = false;
+};
+
+// The amount of a file faulted in ahead of sendfile
+std::size_t const file_window_size = 1024 * 1024;
+
+// Returns the end of a cached response header
+beast::string_view
+header_tail(
+    bool keep_alive,
+    unsigned version)
+{
+    if(! keep_alive)
+        return "Connection: close\r\n\r\n";
+    if(version < 11)
+        return "Connection: keep-alive\r\n\r\n";
+    return "\r\n";
+}
+
+// Returns the status line of a response to
+// a request with the given HTTP version
+std::string
+status_line(
+    unsigned version,
+    beast::string_view status)
+{
+    std::string s = "HTTP/";
+    s += static_cast<char>('0' + version / 10);
+    s += '.';
+    s += static_cast<char>('0' + version % 10);
+    s += ' ';
+    s.append(status.data(), status.size());
+    s += "\r\n";
+    return s;
+}
+
+// Returns the value of a Content-Range field
+std::string
+content_range(
+    byte_range const& r,
+    std::uint64_t size)
+{
+    return
+        "bytes " + std::to_string(r.first) +
+        "-" + std::to_string(r.last) +
+        "/" + std::to_string(size);
+}
+
+// Build the response for a cached file, honoring
+// conditional and range requests.
+template<class Request>
+cached_response
+make_cached_response(
+    Request const& req,
+    boost::shared_ptr<cached_file const> file)
+{
+    cached_response res;
+    res.file = std::move(file);
+    res.tail = header_tail(req.keep_alive(), req.version());
+    res.need_eof = ! req.keep_alive();
+    res.body = req.method() != http::verb::head;
+
+    // The stored header is for HTTP/1.1
+    auto const& f = *res.file;
+    if(req.version() != 11)
+        res.header =
+            status_line(req.version(), "200 OK") +
+            f.header.substr(f.header.find("\r\n") + 2);
+
+    if(is_not_modified(
+        req[http::field::if_none_match],
+        req[http::field::if_modified_since],
+        f.etag, f.mtime))
     {
-        http::response<http::string_body> res{http::status::bad_request, req.version()};
-        res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
-        res.set(http::field::content_type, "text/html");
-        res.keep_alive(req.keep_alive());
-        res.body() = why.to_string();
-        res.prepare_payload();
+        res.header = status_line(
+            req.version(), "304 Not Modified") + f.fields;
+        res.body = false;
+        return res;
+    }
+
+    if( req.method() != http::verb::get ||
+        ! is_range_current(
+            req[http::field::if_range], f.etag, f.mtime))
         return res;
-    };
 
+    auto const size = f.body->size();
+    switch(parse_range(
+        req[http::field::range], size, res.ranges))
+    {
+    case range_status::ignore:
+        break;
+
+    case range_status::unsatisfiable:
+        res.header =
+            status_line(req.version(),
+                "416 Range Not Satisfiable") + f.fields +
+            "Content-Range: bytes */" + std::to_string(size) + "\r\n"
+            "Content-Length: 0\r\n";
+        res.body = false;
+        break;
+
+    case range_status::partial:
+        res.header = status_line(
+            req.version(), "206 Partial Content") + f.fields;
+        if(res.ranges.size() == 1)
+        {
+            auto const& r = res.ranges.front();
+            res.header +=
+                "Content-Type: " + f.type.to_string() + "\r\n"
+                "Content-Range: " + content_range(r, size) + "\r\n"
+                "Content-Length: " + std::to_string(r.size()) + "\r\n";
+            break;
+        }
+
+        // The boundary is derived from the entity tag
+        // so it can not collide with a part header.
+        std::string const boundary =
+            "lounge-" + f.etag.substr(1, f.etag.size() - 2);
+        std::uint64_t length = 0;
+        for(auto const& r : res.ranges)
+        {
+            res.parts.emplace_back(
+                "\r\n--" + boundary + "\r\n"
+                "Content-Type: " + f.type.to_string() + "\r\n"
+                "Content-Range: " + content_range(r, size) + "\r\n\r\n");
+            length += res.parts.back().size() + r.size();
+        }
+        res.parts.emplace_back("\r\n--" + boundary + "--\r\n");
+        length += res.parts.back().size();
+        res.header +=
+            "Content-Type: multipart/byteranges; boundary=" +
+                boundary + "\r\n"
+            "Content-Length: " + std::to_string(length) + "\r\n";
+        break;
+    }
+    return res;
+}
+
+// Produce the response for a file which is not in the file cache.
+// The file is either too large to cache or could not be loaded,
+// and was opened on the file I/O pool.
+template<class Request, class Send>
+void
+serve_file(
+    Request const& req,
+    std::string const& path,
+    opened_file&& f,
+    Send const& send)
+{
     // Returns a not found response
     auto const not_found =
     [&req](beast::string_view target)
@@ -163,61 +284,190 @@ handle_request(
         return res;
     };
 
-    // Make sure we can handle the method
-    if( req.method() != http::verb::get &&
-        req.method() != http::verb::head)
-        return send(bad_request("Unknown HTTP-method"));
-
-    // Request path must be absolute and not contain "..".
-    if( req.target().empty() ||
-        req.target()[0] != '/' ||
-        req.target().find("..") != beast::string_view::npos)
-        return send(bad_request("Illegal request-target"));
-
-    // Build the path to the requested file
-    std::string path = path_cat(doc_root, req.target());
-    if(req.target().back() == '/')
-        path.append("index.html");
-
-    // Attempt to open the file
-    beast::error_code ec;
-    http::file_body::value_type body;
-    body.open(path.c_str(), beast::file_mode::scan, ec);
-
     // Handle the case where the file doesn't exist
-    if(ec == boost::system::errc::no_such_file_or_directory)
+    if(f.ec == boost::system::errc::no_such_file_or_directory)
         return send(not_found(req.target()));
 
     // Handle an unknown error
-    if(ec)
-        return send(server_error(ec.message()));
+    if(f.ec)
+        return send(server_error(f.ec.message()));
+
+    auto& body = f.body;
+    auto const encoding = f.encoding;
+    auto const mtime = f.mtime;
+    auto const etag = make_etag(mtime, f.identity_size, encoding);
 
     // Cache the size since we need it after the move
     auto const size = body.size();
 
+    // Set the fields common to every status
+    auto const set_fields =
+    [&](http::response_header<>& res)
+    {
+        res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+        if(! encoding.empty())
+            res.set(http::field::content_encoding, encoding);
+        if(f.vary)
+            res.set(http::field::vary, "Accept-Encoding");
+        res.set(http::field::etag, etag);
+        res.set(http::field::last_modified, format_http_date(mtime));
+        res.set(http::field::accept_ranges, "bytes");
+    };
+
+    // Respond to a conditional request for a current file
+    if(is_not_modified(
+        req[http::field::if_none_match],
+        req[http::field::if_modified_since],
+        etag, mtime))
+    {
+        http::response<http::empty_body> res{
+            http::status::not_modified, req.version()};
+        set_fields(res);
+        res.keep_alive(req.keep_alive());
+        return send(std::move(res));
+    }
+
     // Respond to HEAD request
     if(req.method() == http::verb::head)
     {
         http::response<http::empty_body> res{http::status::ok, req.version()};
-        res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+        set_fields(res);
+        res.keep_alive(req.keep_alive());
         res.set(http::field::content_type, mime_type(path));
         res.content_length(size);
+        return send(std::move(res));
+    }
+
+    // Honor a single range. A multipart response would
+    // need its own body type, and files this large are
+    // resumed or seeked with one range at a time.
+    std::vector<byte_range> ranges;
+    auto const status = is_range_current(
+            req[http::field::if_range], etag, mtime) ?
+        parse_range(req[http::field::range], size, ranges) :
+        range_status::ignore;
+    if(status == range_status::unsatisfiable)
+    {
+        http::response<http::empty_body> res{
+            http::status::range_not_satisfiable, req.version()};
+        set_fields(res);
         res.keep_alive(req.keep_alive());
+        res.set(http::field::content_range,
+            "bytes */" + std::to_string(size));
+        res.content_length(0);
         return send(std::move(res));
     }
+    bool const partial =
+        status == range_status::partial &&
+        ranges.size() == 1;
+    if(partial)
+        body.range(ranges.front().first, ranges.front().size());
 
     // Respond to GET request
-    http::response<http::file_body> res{
+    http::response<file_range_body> res{
         std::piecewise_construct,
         std::make_tuple(std::move(body)),
-        std::make_tuple(http::status::ok, req.version())};
-    res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
-    res.set(http::field::content_type, mime_type(path));
-    res.content_length(size);
+        std::make_tuple(
+            partial ?
+                http::status::partial_content :
+                http::status::ok,
+            req.version())};
+    set_fields(res);
     res.keep_alive(req.keep_alive());
+    res.set(http::field::content_type, mime_type(path));
+    if(partial)
+        res.set(http::field::content_range,
+            content_range(ranges.front(), size));
+    res.content_length(res.body().size());
     return send(std::move(res));
 }
 
+// This function produces an HTTP response for the given
+// request. The type of the response object depends on the
+// contents of the request, so the interface requires the
+// caller to pass a generic lambda for receiving the response.
+template<
+    class Body, class Allocator,
+    class Send>
+void
+handle_request(
+    server& srv,
+    http::request<Body, http::basic_fields<Allocator>>&& req,
+    Send&& send)
+{
+    // Returns a bad request response
+    auto const bad_request =
+    [&req](beast::string_view why)
+    {
+        http::response<http::string_body> res{http::status::bad_request, req.version()};
+        res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+        res.set(http::field::content_type, "text/html");
+        res.keep_alive(req.keep_alive());
+        res.body() = why.to_string();
+        res.prepare_payload();
+        return res;
+    };
+
+    // Make sure we can handle the method
+    if( req.method() != http::verb::get &&
+        req.method() != http::verb::head)
+        return send(bad_request("Unknown HTTP-method"));
+
+    // Request path must be absolute and not contain "..".
+    if( req.target().empty() ||
+        req.target()[0] != '/' ||
+        req.target().find("..") != beast::string_view::npos)
+        return send(bad_request("Illegal request-target"));
+
+    // Build the path to the requested file
+    std::string path = path_cat(srv.doc_root(), req.target());
+    if(req.target().back() == '/')
+        path.append("index.html");
+
+    // Codings the client accepts, to pick a compressed representation
+    auto const accept = parse_accept_encoding(
+        req[http::field::accept_encoding]);
+
+    // Serve small files from memory
+    auto file = srv.file_cache().find(path, accept);
+    if(file)
+        return send(make_cached_response(req, std::move(file)));
+
+    // Load the file on the file I/O pool, so this thread
+    // never waits on the disk, then finish on our strand.
+    auto sp = std::make_shared<
+        http::request<Body, http::basic_fields<Allocator>>>(
+            std::move(req));
+    srv.file_cache().async_get(
+        path,
+        accept,
+        send.get_executor(),
+        [&srv, sp, path, accept, send](
+            beast::error_code,
+            boost::shared_ptr<cached_file const> file)
+        {
+            if(file)
+                return send(make_cached_response(
+                    *sp, std::move(file)));
+
+            // Not cached, so open it on the pool as well
+            net::post(
+                srv.file_cache().io_executor(),
+                [sp, path, accept, send]
+                {
+                    auto f = std::make_shared<opened_file>(
+                        open_file(path, accept));
+                    net::post(
+                        send.get_executor(),
+                        [sp, path, f, send]
+                        {
+                            serve_file(
+                                *sp, path, std::move(*f), send);
+                        });
+                });
+        });
+}
+
 //------------------------------------------------------------------------------
 
 template<class Derived>
@@ -292,28 +542,192 @@ public:
     //
     //--------------------------------------------------------------------------
 
+    // Write a message and resume the coroutine
+    template<bool isRequest, class Body, class Fields>
+    void
+    write_message(http::message<isRequest, Body, Fields>&& msg)
+    {
+        // The lifetime of the message has to extend
+        // for the duration of the async operation so
+        // we use a shared_ptr to manage it.
+        auto sp = std::make_shared<
+            http::message<isRequest, Body, Fields>>(
+                std::move(msg));
+
+        // Write the response
+        auto self = bind_front(this);
+        http::async_write(
+            impl()->stream(),
+            *sp,
+            [self, sp](
+                beast::error_code ec,
+                std::size_t bytes_transferred)
+            {
+                self(
+                    ec,
+                    bytes_transferred,
+                    sp->need_eof());
+            });
+    }
+
+    // Write a file response. The header goes out first, then
+    // the body is read in chunks on the file I/O pool so a slow
+    // disk never stalls the network thread, or through the ring
+    // when built for io_uring. The derived class may hide this
+    // to use a faster method.
+    void
+    write_file(http::response<file_range_body>&& res)
+    {
+        auto sp = std::make_shared<file_op>(std::move(res));
+        auto self = bind_front(this);
+        http::async_write_header(
+            impl()->stream(),
+            sp->sr,
+            [this, self, sp](
+                beast::error_code ec,
+                std::size_t bytes_transferred)
+            {
+                if(ec)
+                    return self(
+                        ec,
+                        bytes_transferred,
+                        sp->res.need_eof());
+                read_chunk(std::move(sp));
+            });
+    }
+
+    void
+    read_chunk(std::shared_ptr<file_op> sp)
+    {
+        auto self = bind_front(this);
+        if(sp->remain == 0)
+            return self(beast::error_code{}, 0, sp->res.need_eof());
+#ifdef LOUNGE_IO_URING
+        if(! sp->raf)
+        {
+            beast::error_code ec;
+            sp->open(impl()->stream().get_executor(), ec);
+            if(ec)
+                return self(ec, 0, sp->res.need_eof());
+        }
+        auto& raf = *sp->raf;
+        raf.async_read_some_at(
+            sp->offset,
+            net::buffer(sp->buf.get(), sp->chunk()),
+            [this, self, sp](
+                beast::error_code ec,
+                std::size_t bytes_transferred)
+            {
+                sp->on_read(ec, bytes_transferred);
+                if(ec)
+                    return self(ec, 0, sp->res.need_eof());
+                write_chunk(std::move(sp));
+            });
+#else
+        net::post(
+            srv_.file_cache().io_executor(),
+            [this, self, sp]
+            {
+                beast::error_code ec;
+                sp->read(ec);
+                net::post(
+                    impl()->stream().get_executor(),
+                    [this, self, sp, ec]
+                    {
+                        if(ec)
+                            return self(ec, 0, sp->res.need_eof());
+                        write_chunk(std::move(sp));
+                    });
+            });
+#endif
+    }
+
+    void
+    write_chunk(std::shared_ptr<file_op> sp)
+    {
+        auto self = bind_front(this);
+        net::async_write(
+            impl()->stream(),
+            net::buffer(sp->buf.get(), sp->n),
+            [this, self, sp](
+                beast::error_code ec,
+                std::size_t bytes_transferred)
+            {
+                if(ec)
+                    return self(
+                        ec,
+                        bytes_transferred,
+                        sp->res.need_eof());
+                read_chunk(std::move(sp));
+            });
+    }
+
     // We only require C++11, this helper is
     // the equivalent of a C++14 generic lambda.
+    //
+    // The lambda shares ownership of the session, so a
+    // copy may be held until a file is loaded.
     struct send_lambda
     {
-        http_session_base& self_;
+        boost::shared_ptr<http_session_base> self_;
+
+        // Return the executor used to invoke the lambda
+        executor_type
+        get_executor() const
+        {
+            return self_->impl()->stream().get_executor();
+        }
 
         template<bool isRequest, class Body, class Fields>
         void
         operator()(http::message<isRequest, Body, Fields>&& msg) const
         {
-            // The lifetime of the message has to extend
-            // for the duration of the async operation so
-            // we use a shared_ptr to manage it.
+            self_->write_message(std::move(msg));
+        }
+
+        void
+        operator()(http::response<file_range_body>&& res) const
+        {
+            self_->impl()->write_file(std::move(res));
+        }
+
+        void
+        operator()(cached_response&& res) const
+        {
+            // The buffers refer to the response, so it
+            // must stay in place until the write completes.
             auto sp = std::make_shared<
-                http::message<isRequest, Body, Fields>>(
-                    std::move(msg));
-
-            // Write the response
-            auto self = bind_front(&self_);
-            http::async_write(
-                self_.impl()->stream(),
-                *sp,
+                cached_response>(std::move(res));
+            auto const& f = *sp->file;
+
+            // Header and body go out in a single gather write
+            std::vector<net::const_buffer> b;
+            b.reserve(4 + 2 * sp->ranges.size());
+            b.emplace_back(net::buffer(
+                sp->header.empty() ? f.header : sp->header));
+            b.emplace_back(
+                sp->tail.data(), sp->tail.size());
+            if(sp->body)
+            {
+                if(sp->ranges.empty())
+                    b.emplace_back(net::buffer(*f.body));
+                for(std::size_t i = 0; i < sp->ranges.size(); ++i)
+                {
+                    if(! sp->parts.empty())
+                        b.emplace_back(net::buffer(sp->parts[i]));
+                    auto const& r = sp->ranges[i];
+                    b.emplace_back(
+                        f.body->data() + r.first,
+                        static_cast<std::size_t>(r.size()));
+                }
+                if(! sp->parts.empty())
+                    b.emplace_back(net::buffer(sp->parts.back()));
+            }
+
+            auto self = bind_front(self_.get());
+            net::async_write(
+                self_->impl()->stream(),
+                b,
                 [self, sp](
                     beast::error_code ec,
                     std::size_t bytes_transferred)
@@ -321,7 +735,7 @@ public:
                     self(
                         ec,
                         bytes_transferred,
-                        sp->need_eof());
+                        sp->need_eof);
                 });
         }
     };
@@ -382,9 +796,9 @@ public:
             // Send the response
             yield
             handle_request(
-                srv_.doc_root(),
+                srv_,
                 pr_->release(),
-                send_lambda{*this});
+                send_lambda{boost::shared_from(this)});
 
             // Handle the error, if any
             if(ec)
@@ -407,6 +821,9 @@ class plain_http_session_impl
     : public http_session_base<plain_http_session_impl>
 {
     stream_type stream_;
+#if defined(LOUNGE_HAS_SENDFILE) && ! defined(LOUNGE_IO_URING)
+    timer_type sendfile_timer_;
+#endif
 
 public:
     plain_http_session_impl(
@@ -418,6 +835,9 @@ public:
         : http_session_base(
             srv, lst, ep, std::move(storage))
         , stream_(std::move(stream))
+    #if defined(LOUNGE_HAS_SENDFILE) && ! defined(LOUNGE_IO_URING)
+        , sendfile_timer_(stream_.get_executor())
+    #endif
     {
     }
 
@@ -457,6 +877,102 @@ public:
             tcp::socket::shutdown_send, ec);
     }
 
+#if defined(LOUNGE_HAS_SENDFILE) && ! defined(LOUNGE_IO_URING)
+    // Write the header normally, then move the body
+    // from the page cache to the socket with sendfile.
+    // With io_uring, the base class reads through the
+    // ring instead of faulting pages in on the pool.
+    void
+    write_file(http::response<file_range_body>&& res)
+    {
+        auto sp = std::make_shared<file_op>(std::move(res));
+        auto self = bind_front(this);
+        http::async_write_header(
+            stream_,
+            sp->sr,
+            [this, self, sp](
+                beast::error_code ec,
+                std::size_t bytes_transferred)
+            {
+                if(ec)
+                    return self(
+                        ec,
+                        bytes_transferred,
+                        sp->res.need_eof());
+                send_window(std::move(sp));
+            });
+    }
+
+    // sendfile blocks when the pages are not resident, so
+    // each window is first read into the page cache on the
+    // file I/O pool. The body is still never copied.
+    void
+    send_window(std::shared_ptr<file_op> sp)
+    {
+        auto self = bind_front(this);
+        if(sp->remain == 0)
+            return self(beast::error_code{}, 0, sp->res.need_eof());
+        auto const n = static_cast<std::size_t>(
+            (std::min<std::uint64_t>)(
+                sp->remain, file_window_size));
+        net::post(
+            srv_.file_cache().io_executor(),
+            [this, self, sp, n]
+            {
+                // Advisory, errors surface in sendfile
+                ::readahead(
+                    sp->res.body().file().native_handle(),
+                    static_cast<off64_t>(sp->offset), n);
+                net::post(
+                    stream_.get_executor(),
+                    [this, self, sp, n]
+                    {
+                        expire_sendfile();
+                        auto const fd =
+                            sp->res.body().file().native_handle();
+                        async_sendfile(
+                            stream_.socket(),
+                            fd,
+                            sp->offset,
+                            n,
+                            [this, self, sp](
+                                beast::error_code ec,
+                                std::size_t bytes_transferred)
+                            {
+                                sendfile_timer_.cancel();
+                                if(ec)
+                                    return self(
+                                        ec,
+                                        bytes_transferred,
+                                        sp->res.need_eof());
+                                sp->offset += bytes_transferred;
+                                sp->remain -= bytes_transferred;
+                                send_window(std::move(sp));
+                            });
+                    });
+            });
+    }
+
+    // The timeout of the stream only covers its own
+    // operations, and sendfile writes to the socket
+    // directly. Cancel the socket if a window takes too
+    // long, which fails the sendfile with operation_aborted.
+    void
+    expire_sendfile()
+    {
+        auto self = boost::shared_from(this);
+        sendfile_timer_.expires_after(std::chrono::seconds(30));
+        sendfile_timer_.async_wait(
+            [this, self](beast::error_code ec)
+            {
+                if(ec || sendfile_timer_.expiry() >
+                        timer_type::clock_type::now())
+                    return;
+                stream_.socket().cancel(ec);
+            });
+    }
+#endif
+
     // Report a failure
     void
     fail(beast::error_code ec, char const* what)
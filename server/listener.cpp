@@ -12,14 +12,14 @@
 #include "server.hpp"
 #include "server_certificate.hpp"
 #include "service.hpp"
+#include "sharded_set.hpp"
 #include "utility.hpp"
 #include <boost/beast/core/detect_ssl.hpp>
 #include <boost/asio/coroutine.hpp>
-#include <boost/container/flat_set.hpp>
 #include <boost/make_unique.hpp>
 #include <boost/smart_ptr/weak_ptr.hpp>
+#include <atomic>
 #include <iostream>
-#include <mutex>
 #include <vector>
 
 extern
@@ -165,11 +165,14 @@ public:
 
 //------------------------------------------------------------------------------
 
-// Accepts incoming connections and launches the sessions
-class listener_impl
+class listener_impl;
+
+// One socket accepting connections for a listener.
+// When a listener has several acceptors they share
+// the port using SO_REUSEPORT and the kernel balances
+// incoming connections across them.
+class acceptor
     : public boost::asio::coroutine
-    , public service
-    , public listener
 {
     // This hack works around a bug in basic_socket_acceptor
     // which uses the wrong socket type here:
@@ -187,16 +190,73 @@ class listener_impl
                 tcp, executor_type>;
     };
 
+    server& srv_;
+    listener_impl& lst_;
+    net::basic_socket_acceptor<
+        tcp_ex, executor_type> sock_;
+    endpoint_type ep_;
+
+public:
+    acceptor(
+        server& srv,
+        listener_impl& lst)
+        : srv_(srv)
+        , lst_(lst)
+        , sock_(srv_.make_executor())
+    {
+    }
+
+    executor_type
+    get_executor() noexcept
+    {
+        return sock_.get_executor();
+    }
+
+    bool
+    open(
+        endpoint_type ep,
+        bool shared);
+
+    void
+    close()
+    {
+        beast::error_code ec;
+        sock_.close(ec);
+    }
+
+    void
+    run()
+    {
+        // Accept the first connection
+        sock_.async_accept(
+            srv_.make_executor(),
+            ep_,
+            bind_front(this));
+    }
+
+    void
+    operator()(
+        beast::error_code ec,
+        socket_type sock);
+};
+
+//------------------------------------------------------------------------------
+
+// Accepts incoming connections and launches the sessions
+class listener_impl
+    : public service
+    , public listener
+{
     server& srv_;
     section& log_;
-    std::mutex mutex_;
     listener_config cfg_;
     asio::ssl::context ctx_;
-    net::basic_socket_acceptor<
-        tcp_ex, executor_type> acceptor_;
-    boost::container::flat_set<
-        session*> sessions_;
-    endpoint_type ep_;
+    std::vector<std::unique_ptr<
+        acceptor>> acceptors_;
+    sharded_set<session> sessions_;
+    std::atomic<std::size_t> open_{0};
+
+    friend class acceptor;
 
 public:
     listener_impl(
@@ -206,7 +266,6 @@ public:
         , log_(srv_.log().get_section("listener"))
         , cfg_(std::move(cfg))
         , ctx_(asio::ssl::context::tlsv12)
-        , acceptor_(srv_.make_executor())
     {
         cfg_.kind = listener_config::allow_tls;
 
@@ -216,53 +275,32 @@ public:
 
     ~listener_impl()
     {
-        BOOST_ASSERT(sessions_.empty());
+        BOOST_ASSERT(sessions_.size() == 0);
     }
 
     bool
     open()
     {
-        beast::error_code ec;
         endpoint_type ep(cfg_.address, cfg_.port_num);
 
-        // Open the acceptor
-        acceptor_.open(ep.protocol(), ec);
-        if(ec)
+        auto n = cfg_.acceptors;
+    #ifndef SO_REUSEPORT
+        if(n > 1)
         {
             srv_.log().cerr() <<
-                "acceptor_.open: " << ec.message() << "\n";
-            return false;
+                "listener: SO_REUSEPORT is unavailable, "
+                "using one acceptor\n";
+            n = 1;
         }
-
-        // Allow address reuse
-        acceptor_.set_option(
-            net::socket_base::reuse_address(true));
-        if(ec)
+    #endif
+        while(acceptors_.size() < n)
         {
-            srv_.log().cerr() <<
-                "acceptor_.set_option: " << ec.message() << "\n";
-            return false;
+            acceptors_.emplace_back(
+                boost::make_unique<acceptor>(
+                    srv_, *this));
+            if(! acceptors_.back()->open(ep, n > 1))
+                return false;
         }
-
-        // Bind to the server address
-        acceptor_.bind(ep, ec);
-        if(ec)
-        {
-            srv_.log().cerr() <<
-                "acceptor_.bind: " << ec.message() << "\n";
-            return false;
-        }
-
-        // Start listening for connections
-        acceptor_.listen(
-            net::socket_base::max_listen_connections, ec);
-        if(ec)
-        {
-            srv_.log().cerr() <<
-                "acceptor_.listen: " << ec.message() << "\n";
-            return false;
-        }
-
         return true;
     }
 
@@ -271,85 +309,77 @@ public:
     {
         LOG_TRC(log_, "listener::do_stop");
 
-        // Close the acceptor
-        beast::error_code ec;
-        acceptor_.close(ec);
+        // Close the acceptors, each on its own strand. An
+        // acceptor may still launch a session until it is
+        // closed, so the last one to close stops the sessions.
+        open_ = acceptors_.size();
+        for(auto& a : acceptors_)
+        {
+            auto const p = a.get();
+            net::post(
+                a->get_executor(),
+                [this, p]
+                {
+                    p->close();
+                    if(--open_ == 0)
+                        stop_sessions();
+                });
+        }
+    }
 
+    void
+    stop_sessions()
+    {
         // Stop all the sessions
         std::vector<
             boost::weak_ptr<session>> v;
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            v.reserve(sessions_.size());
-            for(auto p : sessions_)
+        sessions_.extract(
+            [&v](session* p)
+            {
                 v.emplace_back(boost::weak_from(p));
-            sessions_.clear();
-            sessions_.shrink_to_fit();
-        }
+            });
         for(auto& e : v)
             if(auto sp = e.lock())
                 sp->on_stop();
     }
 
-#include <boost/asio/yield.hpp>
+    // Launch a new session for a connection
     void
-    operator()(
-        beast::error_code ec,
-        socket_type sock)
+    launch(
+        socket_type sock,
+        endpoint_type ep)
     {
-        reenter(*this)
+        if(cfg_.kind == listener_config::no_tls)
         {
-            for(;;)
-            {
-                // Report the error, if any
-                if(ec)
-                    return fail(ec, "listener::acceptor_.async_accept");
-
-                // If the acceptor is closed it means we stopped
-                if(! acceptor_.is_open())
-                    return;
-
-                // Launch a new session for this connection
-                if(cfg_.kind == listener_config::no_tls)
-                {
-                    run_http_session(
-                        srv_,
-                        *this,
-                        stream_type(std::move(sock)),
-                        ep_,
-                        {});
-                }
-                else if(cfg_.kind == listener_config::allow_tls)
-                {
-                    auto sp = boost::make_shared<detector>(
-                        srv_,
-                        *this,
-                        log_,
-                        ctx_,
-                        std::move(sock),
-                        ep_);
-                    sp->run();
-                }
-                else
-                {
-                    run_https_session(
-                        srv_,
-                        *this,
-                        ctx_,
-                        stream_type(std::move(sock)),
-                        ep_,
-                        {});
-                }
-
-                // Accept the next connection
-                yield acceptor_.async_accept(
-                    srv_.make_executor(),
-                    ep_,
-                    bind_front(this));
-            }
+            run_http_session(
+                srv_,
+                *this,
+                stream_type(std::move(sock)),
+                ep,
+                {});
+        }
+        else if(cfg_.kind == listener_config::allow_tls)
+        {
+            auto sp = boost::make_shared<detector>(
+                srv_,
+                *this,
+                log_,
+                ctx_,
+                std::move(sock),
+                ep);
+            sp->run();
+        }
+        else
+        {
+            run_https_session(
+                srv_,
+                *this,
+                ctx_,
+                stream_type(std::move(sock)),
+                ep,
+                {});
         }
     }
-#include <boost/asio/unyield.hpp>
 
     // Report a failure
     void
@@ -370,14 +400,12 @@ public:
     void
     insert(session* p) override
     {
-        std::lock_guard<std::mutex> lock(mutex_);
         sessions_.insert(p);
     }
 
     void
     erase(session* p) override
     {
-        std::lock_guard<std::mutex> lock(mutex_);
         sessions_.erase(p);
     }
 
@@ -391,11 +419,8 @@ public:
     void
     on_start() override
     {
-        // Accept the first connection
-        acceptor_.async_accept(
-            srv_.make_executor(),
-            ep_,
-            bind_front(this));
+        for(auto& a : acceptors_)
+            a->run();
     }
 
     /// Called when the server stops
@@ -404,13 +429,140 @@ public:
     {
         // Call do_stop from within the strand
         net::post(
-            acceptor_.get_executor(),
+            acceptors_.front()->get_executor(),
             beast::bind_front_handler(
                 &listener_impl::do_stop,
                 this));
     }
 };
 
+//------------------------------------------------------------------------------
+
+bool
+acceptor::
+open(
+    endpoint_type ep,
+    bool shared)
+{
+    beast::error_code ec;
+
+    // Open the acceptor
+    sock_.open(ep.protocol(), ec);
+    if(ec)
+    {
+        srv_.log().cerr() <<
+            "acceptor_.open: " << ec.message() << "\n";
+        return false;
+    }
+
+    // Allow address reuse
+    sock_.set_option(
+        net::socket_base::reuse_address(true), ec);
+    if(ec)
+    {
+        srv_.log().cerr() <<
+            "acceptor_.set_option: " << ec.message() << "\n";
+        return false;
+    }
+
+#ifdef SO_REUSEPORT
+    // Let every acceptor of this listener bind the port
+    if(shared)
+    {
+        sock_.set_option(reuse_port(true), ec);
+        if(ec)
+        {
+            srv_.log().cerr() <<
+                "acceptor_.set_option: " << ec.message() << "\n";
+            return false;
+        }
+    }
+#else
+    boost::ignore_unused(shared);
+#endif
+
+    // Bind to the server address
+    sock_.bind(ep, ec);
+    if(ec)
+    {
+        srv_.log().cerr() <<
+            "acceptor_.bind: " << ec.message() << "\n";
+        return false;
+    }
+
+    // Start listening for connections
+    sock_.listen(
+        net::socket_base::max_listen_connections, ec);
+    if(ec)
+    {
+        srv_.log().cerr() <<
+            "acceptor_.listen: " << ec.message() << "\n";
+        return false;
+    }
+
+    // Needed to drain the backlog without blocking
+    sock_.non_blocking(true, ec);
+    if(ec)
+    {
+        srv_.log().cerr() <<
+            "acceptor_.non_blocking: " << ec.message() << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+#include <boost/asio/yield.hpp>
+void
+acceptor::
+operator()(
+    beast::error_code ec,
+    socket_type sock)
+{
+    reenter(*this)
+    {
+        for(;;)
+        {
+            // Report the error, if any
+            if(ec)
+                return lst_.fail(ec, "listener::acceptor_.async_accept");
+
+            // If the acceptor is closed it means we stopped
+            if(! sock_.is_open())
+                return;
+
+            // Launch a new session for this connection
+            lst_.launch(std::move(sock), ep_);
+
+            // Connections arriving in a burst are already
+            // waiting in the backlog, so take several of them
+            // per wakeup before going back to the reactor.
+            for(std::size_t i = 1;
+                i < lst_.cfg_.accept_batch; ++i)
+            {
+                socket_type next(srv_.make_executor());
+                sock_.accept(next, ec);
+                if(ec)
+                    break;
+
+                // A peer which already reset the connection has
+                // no address, but the session still owns the
+                // socket and will fail on its first read.
+                auto const ep = next.remote_endpoint(ec);
+                lst_.launch(std::move(next), ep);
+            }
+            ec = {};
+
+            // Accept the next connection
+            yield sock_.async_accept(
+                srv_.make_executor(),
+                ep_,
+                bind_front(this));
+        }
+    }
+}
+#include <boost/asio/unyield.hpp>
+
 } // (anon)
 
 //------------------------------------------------------------------------------
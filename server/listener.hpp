@@ -16,15 +16,64 @@
 #include <boost/beast/core/error.hpp>
 #include <boost/json/string.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <cstddef>
 #include <memory>
 #include <string>
 
+#ifdef SO_REUSEPORT
+/** Socket option to let several sockets bind the same port.
+
+    This meets the requirements of SettableSocketOption.
+*/
+class reuse_port
+{
+    int value_;
+
+public:
+    explicit
+    reuse_port(bool value) noexcept
+        : value_(value ? 1 : 0)
+    {
+    }
+
+    template<class Protocol>
+    int
+    level(Protocol const&) const noexcept
+    {
+        return SOL_SOCKET;
+    }
+
+    template<class Protocol>
+    int
+    name(Protocol const&) const noexcept
+    {
+        return SO_REUSEPORT;
+    }
+
+    template<class Protocol>
+    int const*
+    data(Protocol const&) const noexcept
+    {
+        return &value_;
+    }
+
+    template<class Protocol>
+    std::size_t
+    size(Protocol const&) const noexcept
+    {
+        return sizeof(value_);
+    }
+};
+#endif
+
 //------------------------------------------------------------------------------
 
 /** Configuration for a listening socket.
 */
 struct listener_config
 {
+    listener_config() = default;
+
     explicit
     listener_config(json::value&& jv);
 
@@ -35,7 +84,15 @@ struct listener_config
     net::ip::address address;
 
     // port number
-    unsigned short port_num;
+    unsigned short port_num = 0;
+
+    // number of sockets accepting on the port, using
+    // SO_REUSEPORT when more than one. Usually set to
+    // the number of I/O threads.
+    unsigned acceptors = 1;
+
+    // maximum connections accepted per wakeup
+    unsigned accept_batch = 16;
 
     enum
     {
@@ -0,0 +1,293 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_MEMBER_SET_HPP
+#define LOUNGE_MEMBER_SET_HPP
+
+#include "config.hpp"
+#include <boost/assert.hpp>
+#include <boost/container/flat_set.hpp>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+/** A set of pointers with constant time insert and erase.
+
+    Elements are kept contiguously in insertion order
+    (modulo erasures) so iteration is as fast as for a
+    vector. An open-addressing table with linear probing
+    maps each pointer to its position in the dense array.
+    Erasing moves the last element into the hole.
+*/
+template<class T>
+class dense_set
+{
+    std::vector<T*> v_;
+
+    // 0 means empty, otherwise index+1 into v_
+    std::vector<std::size_t> t_;
+
+    static
+    std::size_t
+    hash(T const* p) noexcept
+    {
+        // Fibonacci hashing of the address, dropping
+        // the low bits which are always zero.
+        auto const h = static_cast<std::uint64_t>(
+            reinterpret_cast<std::uintptr_t>(p) >> 4);
+        return static_cast<std::size_t>(
+            (h * 11400714819323198485ull) >> 32);
+    }
+
+    std::size_t
+    mask() const noexcept
+    {
+        return t_.size() - 1;
+    }
+
+    // Returns the slot holding p, or the
+    // empty slot where p would be inserted.
+    std::size_t
+    find_slot(T const* p) const noexcept
+    {
+        auto i = hash(p) & mask();
+        while(t_[i] != 0 && v_[t_[i] - 1] != p)
+            i = (i + 1) & mask();
+        return i;
+    }
+
+    void
+    rehash(std::size_t n)
+    {
+        t_.assign(n, 0);
+        for(std::size_t i = 0; i < v_.size(); ++i)
+            t_[find_slot(v_[i])] = i + 1;
+    }
+
+public:
+    using value_type = T*;
+    using iterator = typename std::vector<T*>::const_iterator;
+
+    dense_set() = default;
+
+    /// Returns the number of elements
+    std::size_t
+    size() const noexcept
+    {
+        return v_.size();
+    }
+
+    /// Returns `true` if there are no elements
+    bool
+    empty() const noexcept
+    {
+        return v_.empty();
+    }
+
+    iterator
+    begin() const noexcept
+    {
+        return v_.begin();
+    }
+
+    iterator
+    end() const noexcept
+    {
+        return v_.end();
+    }
+
+    /// Returns `true` if p is in the set
+    bool
+    contains(T const* p) const noexcept
+    {
+        if(t_.empty())
+            return false;
+        return t_[find_slot(p)] != 0;
+    }
+
+    /** Insert an element.
+
+        @returns `false` if the element already exists.
+    */
+    bool
+    insert(T* p)
+    {
+        // Keep the load factor at or below one half
+        if(2 * (v_.size() + 1) > t_.size())
+            rehash(t_.empty() ? 16 : 2 * t_.size());
+        auto const i = find_slot(p);
+        if(t_[i] != 0)
+            return false;
+        v_.push_back(p);
+        t_[i] = v_.size();
+        return true;
+    }
+
+    /** Erase an element.
+
+        @returns `false` if the element was not found.
+    */
+    bool
+    erase(T const* p) noexcept
+    {
+        if(t_.empty())
+            return false;
+        auto i = find_slot(p);
+        if(t_[i] == 0)
+            return false;
+        auto const idx = t_[i] - 1;
+
+        // Backward-shift deletion keeps every
+        // probe sequence free of tombstones.
+        auto j = i;
+        for(;;)
+        {
+            j = (j + 1) & mask();
+            if(t_[j] == 0)
+                break;
+            auto const k =
+                hash(v_[t_[j] - 1]) & mask();
+            if( (j > i && (k <= i || k > j)) ||
+                (j < i && (k <= i && k > j)))
+            {
+                t_[i] = t_[j];
+                i = j;
+            }
+        }
+        t_[i] = 0;
+
+        // Move the last element into the hole
+        auto const last = v_.size() - 1;
+        if(idx != last)
+        {
+            v_[idx] = v_[last];
+            auto const s = find_slot(v_[idx]);
+            BOOST_ASSERT(t_[s] == last + 1);
+            t_[s] = idx + 1;
+        }
+        v_.pop_back();
+        return true;
+    }
+
+    /// Remove all elements
+    void
+    clear() noexcept
+    {
+        v_.clear();
+        t_.clear();
+    }
+};
+
+//------------------------------------------------------------------------------
+
+/// The container strategy used for a member set
+enum class membership
+{
+    /// A sorted vector, compact but with linear insert and erase
+    flat,
+
+    /// A hashed dense array, with constant time insert and erase
+    dense
+};
+
+/** A set of pointers whose container is chosen at runtime.
+
+    Small, slowly changing sets are best kept in a sorted
+    vector, while very large sets with frequent joins and
+    leaves need constant time insert and erase.
+*/
+template<class T>
+class member_set
+{
+    membership kind_;
+    boost::container::flat_set<T*> flat_;
+    dense_set<T> dense_;
+
+public:
+    explicit
+    member_set(membership kind = membership::flat)
+        : kind_(kind)
+    {
+    }
+
+    /// Returns the container strategy
+    membership
+    kind() const noexcept
+    {
+        return kind_;
+    }
+
+    /// Returns the number of elements
+    std::size_t
+    size() const noexcept
+    {
+        if(kind_ == membership::flat)
+            return flat_.size();
+        return dense_.size();
+    }
+
+    /// Returns `true` if there are no elements
+    bool
+    empty() const noexcept
+    {
+        return size() == 0;
+    }
+
+    /// Returns `true` if p is in the set
+    bool
+    contains(T* p) const noexcept
+    {
+        if(kind_ == membership::flat)
+            return flat_.find(p) != flat_.end();
+        return dense_.contains(p);
+    }
+
+    /** Insert an element.
+
+        @returns `false` if the element already exists.
+    */
+    bool
+    insert(T* p)
+    {
+        if(kind_ == membership::flat)
+            return flat_.insert(p).second;
+        return dense_.insert(p);
+    }
+
+    /** Erase an element.
+
+        @returns `false` if the element was not found.
+    */
+    bool
+    erase(T* p)
+    {
+        if(kind_ == membership::flat)
+            return flat_.erase(p) != 0;
+        return dense_.erase(p);
+    }
+
+    /// Invoke f(T*) for each element
+    template<class Function>
+    void
+    for_each(Function&& f) const
+    {
+        if(kind_ == membership::flat)
+        {
+            for(auto p : flat_)
+                f(p);
+        }
+        else
+        {
+            for(auto p : dense_)
+                f(p);
+        }
+    }
+};
+
+#endif
@@ -8,14 +8,27 @@
 //
 
 #include "message.hpp"
+#include "msgpack.hpp"
+#include "ws_deflate.hpp"
 #include <boost/beast/core/flat_static_buffer.hpp>
 #include <boost/json/serializer.hpp>
 
 //------------------------------------------------------------------------------
 
 message
-make_message(json::value const& jv)
+make_message(
+    json::value const& jv,
+    std::uint64_t key,
+    wire_format format)
 {
+    if(format == wire_format::msgpack)
+    {
+        std::string s;
+        msgpack_encode(jv, s);
+        return message::framed(
+            net::buffer(s), key, false);
+    }
+
     char buf[16384];
     json::serializer sr(jv);
     auto const n = sr.read(buf, sizeof(buf));
@@ -24,6 +37,51 @@ make_message(json::value const& jv)
         // buffer overflow!
         return {};
     }
-    return message(net::const_buffer(buf, n));
+    return message::framed(net::const_buffer(buf, n), key);
 }
 
+net::const_buffer
+message::
+deflated_frame(deflate_pool& pool) const
+{
+    if(! p_ || p_->frame.size() == 0)
+        return frame();
+    auto s = p_->deflated.load(std::memory_order_acquire);
+    if(! s)
+    {
+        // Recipients racing here may each compress
+        // the payload, but only the first is kept.
+        std::unique_ptr<std::string> sp(
+            new std::string(max_header, '\0'));
+        if(pool.deflate(p_->cb, *sp))
+        {
+            // Keep the opcode of the uncompressed frame
+            auto const text = (*static_cast<
+                unsigned char const*>(
+                    p_->frame.data()) & 0x0f) == 0x1;
+            ws_frame_header h(
+                sp->size() - max_header, text, true);
+            auto const hb = h.buffer();
+            auto const pos = max_header - hb.size();
+            sp->replace(pos, hb.size(),
+                static_cast<char const*>(hb.data()), hb.size());
+            sp->erase(0, pos);
+        }
+        else
+        {
+            // Not worth it, remember to send it as is
+            sp->clear();
+        }
+        std::string* expected = nullptr;
+        if(p_->deflated.compare_exchange_strong(
+                expected, sp.get(),
+                std::memory_order_acq_rel,
+                std::memory_order_acquire))
+            s = sp.release();
+        else
+            s = expected;
+    }
+    if(s->empty())
+        return p_->frame;
+    return net::buffer(*s);
+}
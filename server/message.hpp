@@ -11,40 +11,107 @@
 #define LOUNGE_MESSAGE_HPP
 
 #include "config.hpp"
+#include "wire_format.hpp"
+#include "ws_frame.hpp"
 #include <boost/beast/core/buffer_traits.hpp>
 #include <boost/json/value.hpp>
 #include <boost/assert.hpp>
 #include <boost/core/exchange.hpp>
 #include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <memory>
+#include <string>
 #include <utility>
 
+class deflate_pool;
+
 /** A shared buffer sequence of length 1.
 
     This is a reference counted, copyable handle to a constant
     buffer sequence of length one. It is used for broadcasting.
     The originating buffers are copied upon construction.
+
+    A message may also carry the complete WebSocket frame of
+    its payload, built once and shared by every recipient.
 */
 class message
 {
     struct impl
     {
         net::const_buffer cb;
+        net::const_buffer frame;
+        std::atomic<std::string*> deflated{nullptr};
         std::atomic<std::size_t> count;
+        std::uint64_t key;
 
-        explicit
-        impl(std::size_t n)
-            : cb(this + 1, n)
-            , count(1)
+        impl(
+            std::size_t n,
+            std::uint64_t key_,
+            bool framed,
+            bool text)
+            : count(1)
+            , key(key_)
         {
+            if(! framed)
+            {
+                cb = {this + 1, n};
+                return;
+            }
+
+            // The header goes right before the
+            // payload, so the frame is contiguous.
+            auto const payload =
+                reinterpret_cast<char*>(this + 1) +
+                    max_header;
+            ws_frame_header h(n, text);
+            auto const hb = h.buffer();
+            std::memcpy(
+                payload - hb.size(), hb.data(), hb.size());
+            cb = {payload, n};
+            frame = {payload - hb.size(), hb.size() + n};
         }
     };
 
+    static std::size_t constexpr max_header = 10;
+
     impl* p_ = nullptr;
 
     using allocator =
         std::allocator<impl>;
 
+    // Return the number of impl-sized units to allocate
+    static
+    std::size_t
+    units(std::size_t n, bool framed) noexcept
+    {
+        if(framed)
+            n += max_header;
+        return (2 * sizeof(impl) + n - 1) /
+            sizeof(impl);
+    }
+
+    template<class ConstBufferSequence>
+    static
+    impl*
+    construct(
+        ConstBufferSequence const& buffers,
+        std::uint64_t key,
+        bool framed,
+        bool text)
+    {
+        allocator a;
+        auto const n =
+            beast::buffer_bytes(buffers);
+        auto const p = ::new(a.allocate(
+            units(n, framed))) impl(n, key, framed, text);
+        net::buffer_copy(
+            net::mutable_buffer(
+                const_cast<void*>(p->cb.data()), n),
+            buffers);
+        return p;
+    }
+
 public:
     using value_type =
         net::const_buffer;
@@ -63,11 +130,10 @@ public:
     {
         if(p_ && --p_->count == 0)
         {
+            delete p_->deflated.load();
             allocator a;
-            a.deallocate(p_,
-                (2 * sizeof(impl) +
-                    p_->cb.size() - 1) /
-                sizeof(impl));
+            a.deallocate(p_, units(
+                p_->cb.size(), p_->frame.size() > 0));
         }
     }
 
@@ -75,6 +141,10 @@ public:
 
         This function allocates a flat copy of the input
         buffer sequence.
+
+        @param key If not zero, identifies state which a later
+        message with the same key supersedes. A slow recipient
+        may receive only the latest of such messages.
     */
     template<
         class ConstBufferSequence
@@ -85,23 +155,33 @@ public:
 #endif
     >
     message(
-        ConstBufferSequence const& buffers)
-        : p_(
-        [&buffers]
-        {
-            allocator a;
-            auto const n =
-                beast::buffer_bytes(buffers);
-            auto const p = ::new(a.allocate(
-                (2 * sizeof(impl) + n - 1) /
-                    sizeof(impl))) impl(n);
-            net::buffer_copy(
-                net::mutable_buffer(
-                    p + 1, n),
-                buffers);
-            return p;
-        }())
+        ConstBufferSequence const& buffers,
+        std::uint64_t key = 0)
+        : p_(construct(buffers, key, false, true))
+    {
+    }
+
+    /** Construct a message which carries its WebSocket frame.
+
+        The payload is copied after a frame header in a
+        single allocation, so recipients which have not
+        negotiated an extension can write the frame as is.
+
+        @param key The coalescing key, or zero for none.
+
+        @param text `true` for a text frame, else binary.
+    */
+    template<class ConstBufferSequence>
+    static
+    message
+    framed(
+        ConstBufferSequence const& buffers,
+        std::uint64_t key = 0,
+        bool text = true)
     {
+        message m;
+        m.p_ = construct(buffers, key, true, text);
+        return m;
     }
 
     message(message&& other) noexcept
@@ -117,6 +197,40 @@ public:
             ++p_->count;
     }
 
+    /// Returns `true` if this is not a null message
+    explicit
+    operator bool() const noexcept
+    {
+        return p_ != nullptr;
+    }
+
+    /** Return the pre-built WebSocket frame.
+
+        The buffer is empty if the message has no frame.
+    */
+    net::const_buffer
+    frame() const noexcept
+    {
+        return p_ ? p_->frame : net::const_buffer();
+    }
+
+    /** Return the frame compressed with permessage-deflate.
+
+        The payload is compressed on first use and the frame
+        is kept with the message for every later recipient.
+        If compression does not apply, this returns the
+        uncompressed @ref frame.
+    */
+    net::const_buffer
+    deflated_frame(deflate_pool& pool) const;
+
+    /// Return the coalescing key, or zero if there is none
+    std::uint64_t
+    key() const noexcept
+    {
+        return p_ ? p_->key : 0;
+    }
+
     iterator
     begin() const noexcept
     {
@@ -137,8 +251,19 @@ public:
     }
 };
 
-/// Construct a message from a JSON value
+/** Construct a message from a JSON value
+
+    The message carries its WebSocket frame: a text frame
+    holding JSON, or a binary frame holding MessagePack.
+
+    @param key The coalescing key, or zero for none.
+
+    @param format The encoding of the message.
+*/
 message
-make_message(json::value const& jv);
+make_message(
+    json::value const& jv,
+    std::uint64_t key = 0,
+    wire_format format = wire_format::json);
 
 #endif
@@ -0,0 +1,112 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_MPSC_QUEUE_HPP
+#define LOUNGE_MPSC_QUEUE_HPP
+
+#include "config.hpp"
+#include <atomic>
+
+/// The base class of elements in an @ref mpsc_queue
+class mpsc_node
+{
+    template<class T>
+    friend class mpsc_queue;
+
+    std::atomic<mpsc_node*> next_{nullptr};
+};
+
+/** An intrusive, unbounded, multi-producer single-consumer queue.
+
+    Pushing is wait-free: a single atomic exchange followed
+    by a store. The consumer never blocks, but may briefly
+    see the queue as empty while a push is in progress.
+
+    The queue does not own its elements.
+
+    @tparam T The element type, derived from @ref mpsc_node.
+*/
+template<class T>
+class mpsc_queue
+{
+    // producers
+    std::atomic<mpsc_node*> head_;
+
+    // consumer
+    mpsc_node* tail_;
+
+    mpsc_node stub_;
+
+    void
+    push_node(mpsc_node* n) noexcept
+    {
+        n->next_.store(nullptr, std::memory_order_relaxed);
+        auto const prev = head_.exchange(
+            n, std::memory_order_acq_rel);
+        prev->next_.store(n, std::memory_order_release);
+    }
+
+public:
+    mpsc_queue() noexcept
+        : head_(&stub_)
+        , tail_(&stub_)
+    {
+    }
+
+    mpsc_queue(mpsc_queue const&) = delete;
+    mpsc_queue& operator=(mpsc_queue const&) = delete;
+
+    /// Add an element. May be called from any thread.
+    void
+    push(T* p) noexcept
+    {
+        push_node(p);
+    }
+
+    /** Remove the oldest element.
+
+        Only one thread may call this at a time.
+
+        @returns The element, or null if the queue is
+        empty or the next push has not yet finished.
+    */
+    T*
+    pop() noexcept
+    {
+        auto tail = tail_;
+        auto next = tail->next_.load(std::memory_order_acquire);
+        if(tail == &stub_)
+        {
+            if(! next)
+                return nullptr;
+            tail_ = next;
+            tail = next;
+            next = next->next_.load(std::memory_order_acquire);
+        }
+        if(next)
+        {
+            tail_ = next;
+            return static_cast<T*>(tail);
+        }
+        if(tail != head_.load(std::memory_order_acquire))
+            return nullptr;
+
+        // Put the stub back so the last element can be taken
+        push_node(&stub_);
+        next = tail->next_.load(std::memory_order_acquire);
+        if(next)
+        {
+            tail_ = next;
+            return static_cast<T*>(tail);
+        }
+        return nullptr;
+    }
+};
+
+#endif
@@ -0,0 +1,451 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_MSGPACK_HPP
+#define LOUNGE_MSGPACK_HPP
+
+#include "config.hpp"
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/core/string.hpp>
+#include <boost/json/value.hpp>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+
+namespace detail {
+
+inline
+void
+msgpack_put_be(
+    std::string& out,
+    unsigned char tag,
+    std::uint64_t v,
+    int bytes)
+{
+    out.push_back(static_cast<char>(tag));
+    for(int i = bytes - 1; i >= 0; --i)
+        out.push_back(static_cast<char>(
+            (v >> (8 * i)) & 0xff));
+}
+
+inline
+void
+msgpack_put_uint(
+    std::string& out,
+    std::uint64_t v)
+{
+    if(v < 128)
+        out.push_back(static_cast<char>(v));
+    else if(v <= 0xff)
+        msgpack_put_be(out, 0xcc, v, 1);
+    else if(v <= 0xffff)
+        msgpack_put_be(out, 0xcd, v, 2);
+    else if(v <= 0xffffffff)
+        msgpack_put_be(out, 0xce, v, 4);
+    else
+        msgpack_put_be(out, 0xcf, v, 8);
+}
+
+inline
+void
+msgpack_put_int(
+    std::string& out,
+    std::int64_t v)
+{
+    if(v >= 0)
+        return msgpack_put_uint(out,
+            static_cast<std::uint64_t>(v));
+    auto const u = static_cast<std::uint64_t>(v);
+    if(v >= -32)
+        out.push_back(static_cast<char>(u & 0xff));
+    else if(v >= -128)
+        msgpack_put_be(out, 0xd0, u, 1);
+    else if(v >= -32768)
+        msgpack_put_be(out, 0xd1, u, 2);
+    else if(v >= -2147483647 - 1)
+        msgpack_put_be(out, 0xd2, u, 4);
+    else
+        msgpack_put_be(out, 0xd3, u, 8);
+}
+
+// Put the header of a string, array, or map
+inline
+void
+msgpack_put_size(
+    std::string& out,
+    std::size_t n,
+    unsigned char fix,
+    std::size_t fix_max,
+    unsigned char tag8,
+    unsigned char tag16)
+{
+    if(n <= fix_max)
+        out.push_back(static_cast<char>(fix | n));
+    else if(tag8 != 0 && n <= 0xff)
+        msgpack_put_be(out, tag8, n, 1);
+    else if(n <= 0xffff)
+        msgpack_put_be(out, tag16, n, 2);
+    else
+        msgpack_put_be(out, tag16 + 1, n, 4);
+}
+
+inline
+void
+msgpack_put_string(
+    std::string& out,
+    beast::string_view s)
+{
+    msgpack_put_size(out, s.size(), 0xa0, 31, 0xd9, 0xda);
+    out.append(s.data(), s.size());
+}
+
+class msgpack_reader
+{
+    unsigned char const* p_;
+    unsigned char const* end_;
+
+    // Nesting deeper than this is rejected
+    static int constexpr max_depth = 64;
+
+    bool
+    need(std::size_t n) const noexcept
+    {
+        return static_cast<std::size_t>(end_ - p_) >= n;
+    }
+
+    bool
+    read_be(std::uint64_t& v, int bytes) noexcept
+    {
+        if(! need(bytes))
+            return false;
+        v = 0;
+        for(int i = 0; i < bytes; ++i)
+            v = (v << 8) | *p_++;
+        return true;
+    }
+
+    // Read the size following a tag of the given width
+    bool
+    read_size(std::size_t& n, int bytes) noexcept
+    {
+        std::uint64_t v;
+        if(! read_be(v, bytes))
+            return false;
+        n = static_cast<std::size_t>(v);
+        return true;
+    }
+
+    bool
+    read_raw(beast::string_view& s, std::size_t n) noexcept
+    {
+        if(! need(n))
+            return false;
+        s = {reinterpret_cast<char const*>(p_), n};
+        p_ += n;
+        return true;
+    }
+
+    bool
+    read_key(beast::string_view& s)
+    {
+        if(! need(1))
+            return false;
+        auto const c = *p_++;
+        std::size_t n;
+        if(c >= 0xa0 && c <= 0xbf)
+            n = c & 0x1f;
+        else if(c == 0xd9)
+        {
+            if(! read_size(n, 1))
+                return false;
+        }
+        else if(c == 0xda)
+        {
+            if(! read_size(n, 2))
+                return false;
+        }
+        else if(c == 0xdb)
+        {
+            if(! read_size(n, 4))
+                return false;
+        }
+        else
+        {
+            return false;
+        }
+        return read_raw(s, n);
+    }
+
+    static
+    void
+    put_integer(json::value& jv, std::uint64_t v)
+    {
+        // Match what the JSON parser produces
+        if(v <= static_cast<std::uint64_t>(
+                (std::numeric_limits<std::int64_t>::max)()))
+            jv.emplace_int64() = static_cast<std::int64_t>(v);
+        else
+            jv.emplace_uint64() = v;
+    }
+
+    static
+    std::int64_t
+    sign_extend(std::uint64_t v, int bytes) noexcept
+    {
+        auto const shift = 64 - 8 * bytes;
+        return static_cast<std::int64_t>(v << shift) >> shift;
+    }
+
+    bool
+    read_array(json::value& jv, std::size_t n, int depth)
+    {
+        // Every element takes at least one byte
+        if(! need(n))
+            return false;
+        auto& arr = jv.emplace_array();
+        arr.reserve(n);
+        for(std::size_t i = 0; i < n; ++i)
+        {
+            arr.emplace_back(nullptr);
+            if(! read(arr.back(), depth + 1))
+                return false;
+        }
+        return true;
+    }
+
+    bool
+    read_map(json::value& jv, std::size_t n, int depth)
+    {
+        // Every pair takes at least two bytes
+        if(n > static_cast<std::size_t>(end_ - p_) / 2)
+            return false;
+        auto& obj = jv.emplace_object();
+        obj.reserve(n);
+        for(std::size_t i = 0; i < n; ++i)
+        {
+            beast::string_view key;
+            if(! read_key(key))
+                return false;
+            if(! read(obj[key], depth + 1))
+                return false;
+        }
+        return true;
+    }
+
+public:
+    msgpack_reader(
+        beast::string_view s) noexcept
+        : p_(reinterpret_cast<
+            unsigned char const*>(s.data()))
+        , end_(p_ + s.size())
+    {
+    }
+
+    bool
+    done() const noexcept
+    {
+        return p_ == end_;
+    }
+
+    bool
+    read(json::value& jv, int depth = 0)
+    {
+        if(depth > max_depth || ! need(1))
+            return false;
+        auto const c = *p_++;
+        std::uint64_t v;
+        std::size_t n;
+        beast::string_view s;
+        if(c <= 0x7f)
+        {
+            jv.emplace_int64() = c;
+            return true;
+        }
+        if(c >= 0xe0)
+        {
+            jv.emplace_int64() = static_cast<std::int64_t>(c) - 256;
+            return true;
+        }
+        if(c <= 0x8f)
+            return read_map(jv, c & 0x0f, depth);
+        if(c <= 0x9f)
+            return read_array(jv, c & 0x0f, depth);
+        if(c <= 0xbf)
+        {
+            if(! read_raw(s, c & 0x1f))
+                return false;
+            jv.emplace_string().assign(s.data(), s.size());
+            return true;
+        }
+        switch(c)
+        {
+        case 0xc0:
+            jv.emplace_null();
+            return true;
+
+        case 0xc2:
+        case 0xc3:
+            jv.emplace_bool() = c == 0xc3;
+            return true;
+
+        case 0xca:
+        {
+            if(! read_be(v, 4))
+                return false;
+            auto const u = static_cast<std::uint32_t>(v);
+            float f;
+            std::memcpy(&f, &u, sizeof(f));
+            jv.emplace_double() = f;
+            return true;
+        }
+
+        case 0xcb:
+        {
+            if(! read_be(v, 8))
+                return false;
+            double d;
+            std::memcpy(&d, &v, sizeof(d));
+            jv.emplace_double() = d;
+            return true;
+        }
+
+        case 0xcc: case 0xcd: case 0xce: case 0xcf:
+            if(! read_be(v, 1 << (c - 0xcc)))
+                return false;
+            put_integer(jv, v);
+            return true;
+
+        case 0xd0: case 0xd1: case 0xd2: case 0xd3:
+        {
+            auto const bytes = 1 << (c - 0xd0);
+            if(! read_be(v, bytes))
+                return false;
+            jv.emplace_int64() = sign_extend(v, bytes);
+            return true;
+        }
+
+        case 0xd9: case 0xda: case 0xdb:
+            if(! read_size(n, 1 << (c - 0xd9)))
+                return false;
+            if(! read_raw(s, n))
+                return false;
+            jv.emplace_string().assign(s.data(), s.size());
+            return true;
+
+        case 0xdc: case 0xdd:
+            if(! read_size(n, c == 0xdc ? 2 : 4))
+                return false;
+            return read_array(jv, n, depth);
+
+        case 0xde: case 0xdf:
+            if(! read_size(n, c == 0xde ? 2 : 4))
+                return false;
+            return read_map(jv, n, depth);
+
+        default:
+            // bin, ext, and the unused tag
+            return false;
+        }
+    }
+};
+
+} // detail
+
+/** Append the MessagePack encoding of a JSON value.
+
+    Numbers keep their kind: integers use the smallest
+    encoding which holds them, and doubles are always
+    encoded in 64 bits so nothing is lost.
+*/
+inline
+void
+msgpack_encode(
+    json::value const& jv,
+    std::string& out)
+{
+    using namespace detail;
+    if(jv.is_null())
+    {
+        out.push_back(static_cast<char>(0xc0));
+    }
+    else if(jv.is_bool())
+    {
+        out.push_back(static_cast<char>(
+            jv.get_bool() ? 0xc3 : 0xc2));
+    }
+    else if(jv.is_int64())
+    {
+        msgpack_put_int(out, jv.get_int64());
+    }
+    else if(jv.is_uint64())
+    {
+        msgpack_put_uint(out, jv.get_uint64());
+    }
+    else if(jv.is_double())
+    {
+        auto const d = jv.get_double();
+        std::uint64_t v;
+        std::memcpy(&v, &d, sizeof(v));
+        msgpack_put_be(out, 0xcb, v, 8);
+    }
+    else if(jv.is_string())
+    {
+        auto const& s = jv.get_string();
+        msgpack_put_string(out,
+            beast::string_view(s.data(), s.size()));
+    }
+    else if(jv.is_array())
+    {
+        auto const& arr = jv.get_array();
+        msgpack_put_size(out, arr.size(), 0x90, 15, 0, 0xdc);
+        for(auto const& e : arr)
+            msgpack_encode(e, out);
+    }
+    else
+    {
+        auto const& obj = jv.get_object();
+        msgpack_put_size(out, obj.size(), 0x80, 15, 0, 0xde);
+        for(auto const& kv : obj)
+        {
+            msgpack_put_string(out, kv.key());
+            msgpack_encode(kv.value(), out);
+        }
+    }
+}
+
+/** Decode a MessagePack value into JSON.
+
+    The input must hold exactly one value. Map keys must be
+    strings, and binary or extension types are rejected.
+
+    @param ec Set to the error, if any occurred.
+
+    @param sp The storage to use for the value.
+*/
+inline
+json::value
+msgpack_decode(
+    beast::string_view s,
+    beast::error_code& ec,
+    json::storage_ptr sp = {})
+{
+    json::value jv(std::move(sp));
+    detail::msgpack_reader r(s);
+    if(! r.read(jv) || ! r.done())
+    {
+        ec = boost::system::errc::make_error_code(
+            boost::system::errc::illegal_byte_sequence);
+        return nullptr;
+    }
+    ec = {};
+    return jv;
+}
+
+#endif
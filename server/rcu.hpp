@@ -0,0 +1,97 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_RCU_HPP
+#define LOUNGE_RCU_HPP
+
+#include "config.hpp"
+#include <boost/smart_ptr/atomic_shared_ptr.hpp>
+#include <boost/smart_ptr/make_shared.hpp>
+#include <boost/smart_ptr/shared_ptr.hpp>
+#include <utility>
+
+/** A read-copy-update container for an immutable value.
+
+    Readers obtain a reference-counted snapshot of the
+    current value without taking a lock and without
+    allocating. Writers build a new value and publish
+    it atomically; readers holding the old snapshot
+    continue to see it until they release it.
+
+    Writers must be serialized by the caller.
+*/
+template<class T>
+class rcu
+{
+    boost::atomic_shared_ptr<T const> p_;
+
+public:
+    using value_type = T;
+
+    using snapshot_type =
+        boost::shared_ptr<T const>;
+
+    /// Construct a default value
+    rcu()
+        : p_(boost::make_shared<T const>())
+    {
+    }
+
+    rcu(rcu const&) = delete;
+    rcu& operator=(rcu const&) = delete;
+
+    /** Return the current snapshot
+
+        This will be null after a call to @ref reset,
+        until a new value is stored.
+    */
+    snapshot_type
+    load() const noexcept
+    {
+        return p_.load();
+    }
+
+    /** Replace the current value
+
+        @returns The snapshot of the new value.
+    */
+    snapshot_type
+    store(T t)
+    {
+        snapshot_type sp =
+            boost::make_shared<T const>(std::move(t));
+        p_.store(sp);
+        return sp;
+    }
+
+    /// Discard the current value
+    void
+    reset() noexcept
+    {
+        p_.store(nullptr);
+    }
+
+    /** Copy the current value, modify it, and publish it.
+
+        The function is invoked with a mutable copy of
+        the current value, which becomes the new value
+        when the function returns. There must be a
+        current value.
+    */
+    template<class Function>
+    void
+    update(Function&& f)
+    {
+        auto sp = boost::make_shared<T>(*p_.load());
+        f(*sp);
+        p_.store(std::move(sp));
+    }
+};
+
+#endif
@@ -10,12 +10,44 @@
 #include "channel.hpp"
 #include "channel_list.hpp"
 #include "rpc.hpp"
+#include "rpc_params.hpp"
 #include "user.hpp"
 
 namespace {
 
+struct say_params
+{
+    beast::string_view message;
+};
+
+using say_param = rpc_param<say_params>;
+
+constexpr say_param say_schema[] = {
+    { "message", &say_param::member<
+        beast::string_view, &say_params::message> },
+};
+
+static_assert(rpc_params_unique(say_schema),
+    "two params have the same hash");
+
 class room_impl : public channel
 {
+    using handler = beast::error_code (room_impl::*)(rpc_call&);
+
+    static
+    rpc_method_table<handler>&
+    methods()
+    {
+        static constexpr rpc_method<handler> list[] = {
+            { "say",   &room_impl::do_say },
+            { "slash", &room_impl::do_say },
+        };
+        static_assert(rpc_methods_unique(list),
+            "two methods have the same hash");
+        static rpc_method_table<handler> tab(list);
+        return tab;
+    }
+
 public:
     room_impl(
         beast::string_view name,
@@ -23,7 +55,8 @@ public:
         : channel(
             2,
             name,
-            list)
+            list,
+            membership::dense)
     {
     }
 
@@ -43,21 +76,27 @@ public:
     {
     }
 
-    void
+    beast::error_code
     on_dispatch(rpc_call& rpc) override
     {
-        if(rpc.method == "say")
-        {
-            do_say(rpc);
-        }
-        else if(rpc.method == "slash")
-        {
-            do_say(rpc);
-        }
-        else
-        {
-            rpc.fail(rpc_code::method_not_found);
-        }
+        auto const m = methods().call(
+            {rpc.method.data(), rpc.method.size()});
+        if(! m)
+            return rpc_code::method_not_found;
+        return invoke(*m, rpc);
+    }
+
+    bool
+    on_needs_params(beast::string_view method) const override
+    {
+        auto const m = methods().find(method);
+        return m && m->needs_params;
+    }
+
+    void
+    on_get_methods(json::array& arr) const override
+    {
+        methods().to_json(arr);
     }
 
     //--------------------------------------------------------------------------
@@ -66,14 +105,18 @@ public:
     //
     //--------------------------------------------------------------------------
 
-    void
+    beast::error_code
     do_say(rpc_call& rpc)
     {
-        checked_user(rpc);
+        auto ec = expect_user(rpc);
+        if(ec)
+            return ec;
         if(! is_joined(*rpc.u))
-            rpc.fail("not in channel");
-        auto const& text =
-            checked_string(rpc.params, "message");
+            return rpc_code::not_joined;
+        say_params p;
+        ec = rpc_bind(say_schema, rpc.params, p);
+        if(ec)
+            return ec;
         {
             // broadcast: say
             json::value jv(json::object_kind);
@@ -82,17 +125,20 @@ public:
             obj["cid"] = cid();
             obj["name"] = name();
             obj["user"] = rpc.u->name;
-            obj["message"] = text;
+            obj["message"] = p.message;
             send(jv);
         }
         rpc.complete();
+        return {};
     }
 
-    void
+    beast::error_code
     do_slash(rpc_call& rpc)
     {
-        checked_user(rpc);
-        rpc.fail("Unimplemented");
+        auto ec = expect_user(rpc);
+        if(ec)
+            return ec;
+        return rpc_code::method_not_found;
     }
 };
 
@@ -8,8 +8,11 @@
 //
 
 #include "rpc.hpp"
+#include "rpc_arena.hpp"
+#include "rpc_scan.hpp"
 #include "user.hpp"
 #include <boost/beast/core/error.hpp>
+#include <boost/json/parser.hpp>
 #include <type_traits>
 
 //------------------------------------------------------------------------------
@@ -40,6 +43,8 @@ public:
             "Invalid method parameters";
         case rpc_code::internal_error: return
             "Internal JSON-RPC error";
+        case rpc_code::server_busy: return
+            "The server is busy";
 
         case rpc_code::expected_object: return
             "Expected object in JSON-RPC request";
@@ -63,6 +68,33 @@ public:
             "Missing params in JSON-RPC request version 1";
         case rpc_code::expected_array_params: return
             "Expected array params in JSON-RPC request version 1";
+
+        case rpc_code::missing_param: return
+            "Missing parameter";
+        case rpc_code::expected_object_param: return
+            "Expected object parameter";
+        case rpc_code::expected_array_param: return
+            "Expected array parameter";
+        case rpc_code::expected_string_param: return
+            "Expected string parameter";
+        case rpc_code::expected_uint64_param: return
+            "Expected unsigned integer parameter";
+        case rpc_code::expected_bool_param: return
+            "Expected bool parameter";
+        case rpc_code::expected_null_param: return
+            "Expected null parameter";
+        case rpc_code::unknown_cid: return
+            "Unknown cid";
+        case rpc_code::no_identity: return
+            "No identity set";
+        case rpc_code::identity_already_set: return
+            "Identity is already set";
+        case rpc_code::name_too_long: return
+            "Invalid \"name\": too long";
+        case rpc_code::already_joined: return
+            "Already in channel";
+        case rpc_code::not_joined: return
+            "Not in channel";
         }
         if( ev >= -32099 && ev <= -32000)
             return "An implementation defined server error was received";
@@ -76,14 +108,20 @@ public:
     }
 };
 
+beast::error_category const&
+rpc_category()
+{
+    static rpc_error_codes const cat{};
+    return cat;
+}
+
 } // (anon)
 
 beast::error_code
 make_error_code(rpc_code e)
 {
-    static rpc_error_codes const cat{};
     return {static_cast<std::underlying_type<
-        rpc_code>::type>(e), cat};
+        rpc_code>::type>(e), rpc_category()};
 }
 
 //------------------------------------------------------------------------------
@@ -91,9 +129,10 @@ make_error_code(rpc_code e)
 json::value
 rpc_error::
 to_json(
-    boost::optional<json::value> const& id) const
+    boost::optional<json::value> const& id,
+    json::storage_ptr sp) const
 {
-    json::value jv(json::object_kind);
+    json::value jv(json::object_kind, std::move(sp));
     auto& obj = jv.get_object();
     obj["jsonrpc"] = "2.0";
     auto& err = obj["error"].emplace_object();
@@ -117,6 +156,27 @@ rpc_call(
 {
 }
 
+rpc_call::
+rpc_call(
+    ::user& u_,
+    boost::shared_ptr<rpc_arena> arena,
+    boost::shared_ptr<rpc_batch> batch)
+    : arena_(std::move(arena))
+    , batch_(std::move(batch))
+    , u(boost::shared_from(&u_))
+    , method(arena_->storage())
+    , params(arena_->storage())
+    , result(arena_->storage())
+{
+}
+
+rpc_call::
+~rpc_call()
+{
+    if(batch_)
+        batch_->release();
+}
+
 void
 rpc_call::
 extract(
@@ -248,6 +308,41 @@ extract(
     }
 }
 
+void
+rpc_call::
+extract(
+    rpc_route const& r,
+    beast::error_code& ec)
+{
+    BOOST_ASSERT(r.v2);
+    BOOST_ASSERT(r.has_method);
+    BOOST_ASSERT(r.has_cid);
+    version = 2;
+
+    // The id is small, parse just that
+    if(! r.id.empty())
+    {
+        id_.emplace(json::parse(
+            r.id, ec, result.storage()));
+        if(ec)
+            return;
+        if(id_->is_null())
+        {
+            ec = rpc_code::invalid_null_id;
+            return;
+        }
+        if( ! id_->is_number() &&
+            ! id_->is_string())
+        {
+            ec = rpc_code::expected_strnum_id;
+            return;
+        }
+    }
+
+    method.assign(r.method.data(), r.method.size());
+    params.emplace_object()["cid"] = r.cid;
+}
+
 void
 rpc_call::
 complete()
@@ -260,7 +355,7 @@ complete()
     auto& obj = res.get_object();
     obj.emplace("id", *id_);
     obj.emplace("result", std::move(result));
-    u->send(res);
+    reply(std::move(res));
 }
 
 void
@@ -269,7 +364,79 @@ complete(rpc_error const& e)
 {
     if(! id_.has_value())
         return;
-    u->send(e.to_json(id_));
+    reply(e.to_json(id_, result.storage()));
+}
+
+void
+rpc_call::
+complete(beast::error_code const& ec)
+{
+    if(! id_.has_value())
+        return;
+    complete(rpc_error(
+        ec.category() == rpc_category() && ec.value() < 0 ?
+            static_cast<rpc_code>(ec.value()) :
+            rpc_code::invalid_params,
+        ec.message()));
+}
+
+void
+rpc_call::
+reply(json::value&& res)
+{
+    if(batch_)
+        batch_->insert(std::move(res));
+    else
+        u->send(res);
+}
+
+//------------------------------------------------------------------------------
+
+rpc_batch::
+rpc_batch(
+    ::user& u,
+    boost::shared_ptr<rpc_arena> arena,
+    std::size_t n)
+    : arena_(std::move(arena))
+    , u_(boost::shared_from(&u))
+    , replies_(json::array_kind)
+    , pending_(n)
+{
+}
+
+void
+rpc_batch::
+complete() noexcept
+{
+    // Every request is gone, so nothing else
+    // touches the replies and no lock is needed.
+    if(replies_.get_array().empty())
+        return;
+    try
+    {
+        u_->send(replies_);
+    }
+    catch(...)
+    {
+        // The replies are lost, as when the
+        // connection closes before they are sent.
+    }
+}
+
+void
+rpc_batch::
+insert(json::value&& res)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    replies_.get_array().emplace_back(std::move(res));
+}
+
+void
+rpc_batch::
+release() noexcept
+{
+    if(--pending_ == 0)
+        complete();
 }
 
 //------------------------------------------------------------------------------
@@ -393,3 +560,149 @@ checked_null(
 {
     checked_null(checked_value(jv, key));
 }
+
+//------------------------------------------------------------------------------
+
+rpc_expected<json::object>
+expect_object(json::value& jv)
+{
+    if(! jv.is_object())
+        return make_error_code(
+            rpc_code::expected_object_param);
+    return rpc_expected<json::object>(
+        jv.as_object());
+}
+
+rpc_expected<json::array>
+expect_array(json::value& jv)
+{
+    if(! jv.is_array())
+        return make_error_code(
+            rpc_code::expected_array_param);
+    return rpc_expected<json::array>(
+        jv.as_array());
+}
+
+rpc_expected<json::string>
+expect_string(json::value& jv)
+{
+    if(! jv.is_string())
+        return make_error_code(
+            rpc_code::expected_string_param);
+    return rpc_expected<json::string>(
+        jv.as_string());
+}
+
+beast::expected<std::uint64_t>
+expect_uint64(json::value const& jv)
+{
+    if(jv.is_uint64())
+        return beast::expected<std::uint64_t>(
+            jv.get_uint64());
+    if(jv.is_int64() && jv.get_int64() >= 0)
+        return beast::expected<std::uint64_t>(
+            static_cast<std::uint64_t>(jv.get_int64()));
+    return make_error_code(
+        rpc_code::expected_uint64_param);
+}
+
+beast::expected<bool>
+expect_bool(json::value const& jv)
+{
+    if(! jv.is_bool())
+        return make_error_code(
+            rpc_code::expected_bool_param);
+    return beast::expected<bool>(
+        jv.get_bool());
+}
+
+beast::error_code
+expect_null(json::value const& jv)
+{
+    if(! jv.is_null())
+        return rpc_code::expected_null_param;
+    return {};
+}
+
+rpc_expected<json::value>
+expect_value(
+    json::value& jv,
+    beast::string_view key)
+{
+    if(! jv.is_object())
+        return make_error_code(
+            rpc_code::expected_object_param);
+    auto& obj = jv.as_object();
+    auto it = obj.find(key);
+    if(it == obj.end())
+        return make_error_code(
+            rpc_code::missing_param);
+    return rpc_expected<json::value>(
+        it->value());
+}
+
+rpc_expected<json::object>
+expect_object(
+    json::value& jv,
+    beast::string_view key)
+{
+    auto v = expect_value(jv, key);
+    if(! v)
+        return v.error();
+    return expect_object(v->get());
+}
+
+rpc_expected<json::array>
+expect_array(
+    json::value& jv,
+    beast::string_view key)
+{
+    auto v = expect_value(jv, key);
+    if(! v)
+        return v.error();
+    return expect_array(v->get());
+}
+
+rpc_expected<json::string>
+expect_string(
+    json::value& jv,
+    beast::string_view key)
+{
+    auto v = expect_value(jv, key);
+    if(! v)
+        return v.error();
+    return expect_string(v->get());
+}
+
+beast::expected<std::uint64_t>
+expect_uint64(
+    json::value& jv,
+    beast::string_view key)
+{
+    auto v = expect_value(jv, key);
+    if(! v)
+        return v.error();
+    return expect_uint64(v->get());
+}
+
+beast::expected<bool>
+expect_bool(
+    json::value& jv,
+    beast::string_view key)
+{
+    auto v = expect_value(jv, key);
+    if(! v)
+        return v.error();
+    return expect_bool(v->get());
+}
+
+beast::error_code
+expect_null(
+    json::value& jv,
+    beast::string_view key)
+{
+    auto v = expect_value(jv, key);
+    if(! v)
+        return v.error();
+    return expect_null(v->get());
+}
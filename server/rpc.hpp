@@ -11,15 +11,23 @@
 #define LOUNGE_RPC_HPP
 
 #include "config.hpp"
+#include <boost/beast/_experimental/core/expected.hpp>
 #include <boost/beast/core/error.hpp>
 #include <boost/beast/core/string.hpp>
 #include <boost/json/value.hpp>
 #include <boost/smart_ptr/shared_ptr.hpp>
 #include <boost/optional.hpp>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
 #include <stdexcept>
 #include <utility>
 
+class rpc_arena;
+class rpc_batch;
 class user;
+struct rpc_route;
 
 /// Codes used in JSON-RPC error responses
 enum class rpc_code
@@ -30,6 +38,9 @@ enum class rpc_code
     invalid_params   = -32602,
     internal_error   = -32603,
 
+    /// Too many requests are waiting for the RPC pool
+    server_busy      = -32000,
+
     /// Expected object in JSON-RPC request
     expected_object = 1,
 
@@ -61,7 +72,46 @@ enum class rpc_code
     missing_params,
 
     /// Expected array params in JSON-RPC request version 1
-    expected_array_params
+    expected_array_params,
+
+    /// A required parameter is missing
+    missing_param,
+
+    /// Expected an object parameter
+    expected_object_param,
+
+    /// Expected an array parameter
+    expected_array_param,
+
+    /// Expected a string parameter
+    expected_string_param,
+
+    /// Expected an unsigned integer parameter
+    expected_uint64_param,
+
+    /// Expected a boolean parameter
+    expected_bool_param,
+
+    /// Expected a null parameter
+    expected_null_param,
+
+    /// The channel id is not in use
+    unknown_cid,
+
+    /// The user has not set an identity
+    no_identity,
+
+    /// The user has already set an identity
+    identity_already_set,
+
+    /// The name is too long
+    name_too_long,
+
+    /// The user is already in the channel
+    already_joined,
+
+    /// The user is not in the channel
+    not_joined
 };
 
 namespace boost {
@@ -125,7 +175,8 @@ public:
     json::value
     to_json(
         boost::optional<json::value> const&
-            id = boost::none) const;
+            id = boost::none,
+        json::storage_ptr sp = {}) const;
 };
 
 //------------------------------------------------------------------------------
@@ -134,6 +185,12 @@ public:
 */
 class rpc_call
 {
+    // Keeps the storage of the values below alive
+    boost::shared_ptr<rpc_arena> arena_;
+
+    // Collects the reply, if the request is part of a batch
+    boost::shared_ptr<rpc_batch> batch_;
+
     /** The request id
 
         If set, this will be string, number, or null
@@ -167,6 +224,9 @@ public:
     rpc_call(rpc_call&&) = default;
     rpc_call& operator=(rpc_call&&) = delete;
 
+    /// Release the batch, if the request is part of one
+    ~rpc_call();
+
     /** Construct an empty request using the specified storage.
 
         The method, params, and id will be null,
@@ -176,6 +236,19 @@ public:
         ::user& u,
         json::storage_ptr sp = {});
 
+    /** Construct an empty request using storage in an arena.
+
+        The values of the request and its reply are allocated
+        in the arena, which stays alive as long as the request.
+
+        @param batch If set, the reply is added to the batch
+        instead of being sent on its own.
+    */
+    rpc_call(
+        ::user& u,
+        boost::shared_ptr<rpc_arena> arena,
+        boost::shared_ptr<rpc_batch> batch = nullptr);
+
     /** Extract a JSON-RPC request or return an error.
     */
     void
@@ -183,6 +256,17 @@ public:
         json::value&& jv,
         beast::error_code& ec);
 
+    /** Extract a routed JSON-RPC 2.0 request or return an error.
+
+        This is used instead of parsing the request when its
+        method needs nothing from the params except the channel
+        id, which becomes the only member of the params.
+    */
+    void
+    extract(
+        rpc_route const& r,
+        beast::error_code& ec);
+
     /** Complete the RPC request with a success.
 
         This function sends the user originating the request
@@ -199,6 +283,15 @@ public:
     void
     complete(rpc_error const& e);
 
+    /** Complete the RPC request with an error code.
+
+        Codes defined by JSON-RPC are sent as they are. Any
+        other code is sent as invalid params, with the message
+        of the code.
+    */
+    void
+    complete(beast::error_code const& ec);
+
     /** Respond to a request with an error.
 
         This function will throw an `rpc_error`
@@ -212,6 +305,64 @@ public:
         throw rpc_error(
             std::forward<Args>(args)...);
     }
+
+private:
+    void
+    reply(json::value&& res);
+};
+
+//------------------------------------------------------------------------------
+
+/** The replies to a JSON-RPC batch request.
+
+    Each request in the batch holds a reference to this. The
+    replies are collected as the requests complete, in any
+    order. The batch counts the requests which are still
+    alive, and the last one to go calls @ref complete, which
+    sends the replies to the user as one array. No reply is
+    sent if none were collected.
+
+    The arena holding the parsed batch is kept alive, since
+    the ids of the requests refer to it. Nothing more is
+    allocated from it, because requests may complete on
+    other threads.
+
+    Thread safe.
+*/
+class rpc_batch
+{
+    boost::shared_ptr<rpc_arena> arena_;
+    boost::shared_ptr<user> u_;
+    std::mutex mutex_;
+    json::value replies_;
+    std::atomic<std::size_t> pending_;
+
+    void
+    complete() noexcept;
+
+public:
+    /** Constructor
+
+        @param n The number of requests in the batch.
+    */
+    rpc_batch(
+        ::user& u,
+        boost::shared_ptr<rpc_arena> arena,
+        std::size_t n);
+
+    rpc_batch(rpc_batch const&) = delete;
+    rpc_batch& operator=(rpc_batch const&) = delete;
+
+    /// Add the reply to one request
+    void
+    insert(json::value&& res);
+
+    /** Called when a request of the batch is gone.
+
+        The replies are sent when every request is gone.
+    */
+    void
+    release() noexcept;
 };
 
 //------------------------------------------------------------------------------
@@ -282,4 +433,81 @@ checked_null(
     json::value& jv,
     beast::string_view key);
 
+//------------------------------------------------------------------------------
+
+/** The result of a parameter lookup which does not throw.
+
+    On success this holds a reference to the element,
+    otherwise an error code from @ref rpc_code.
+*/
+template<class T>
+using rpc_expected =
+    beast::expected<std::reference_wrapper<T>>;
+
+extern
+rpc_expected<json::object>
+expect_object(json::value& jv);
+
+extern
+rpc_expected<json::array>
+expect_array(json::value& jv);
+
+extern
+rpc_expected<json::string>
+expect_string(json::value& jv);
+
+extern
+beast::expected<std::uint64_t>
+expect_uint64(json::value const& jv);
+
+extern
+beast::expected<bool>
+expect_bool(json::value const& jv);
+
+extern
+beast::error_code
+expect_null(json::value const& jv);
+
+extern
+rpc_expected<json::value>
+expect_value(
+    json::value& jv,
+    beast::string_view key);
+
+extern
+rpc_expected<json::object>
+expect_object(
+    json::value& jv,
+    beast::string_view key);
+
+extern
+rpc_expected<json::array>
+expect_array(
+    json::value& jv,
+    beast::string_view key);
+
+extern
+rpc_expected<json::string>
+expect_string(
+    json::value& jv,
+    beast::string_view key);
+
+extern
+beast::expected<std::uint64_t>
+expect_uint64(
+    json::value& jv,
+    beast::string_view key);
+
+extern
+beast::expected<bool>
+expect_bool(
+    json::value& jv,
+    beast::string_view key);
+
+extern
+beast::error_code
+expect_null(
+    json::value& jv,
+    beast::string_view key);
+
 #endif
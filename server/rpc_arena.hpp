@@ -0,0 +1,76 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_RPC_ARENA_HPP
+#define LOUNGE_RPC_ARENA_HPP
+
+#include "config.hpp"
+#include <boost/json/monotonic_resource.hpp>
+#include <boost/json/storage_ptr.hpp>
+#include <boost/smart_ptr/make_shared.hpp>
+#include <boost/smart_ptr/shared_ptr.hpp>
+
+/** Memory for the JSON of one RPC request and its reply.
+
+    Values are allocated from a buffer inside the arena and
+    spill into larger blocks only when it is exhausted. Nothing
+    is freed until @ref reset, which keeps the buffer.
+
+    A session reuses one arena for each request it reads, as
+    long as no earlier request still refers to it. A request
+    which completes later, for example on a game's strand,
+    holds a reference which keeps its arena alive.
+*/
+class rpc_arena
+{
+    static std::size_t constexpr buffer_size = 4096;
+
+    unsigned char buf_[buffer_size];
+    json::monotonic_resource mr_;
+
+public:
+    rpc_arena()
+        : mr_(buf_, buffer_size)
+    {
+    }
+
+    rpc_arena(rpc_arena const&) = delete;
+    rpc_arena& operator=(rpc_arena const&) = delete;
+
+    /// Return the storage to use for values in the arena
+    json::storage_ptr
+    storage() noexcept
+    {
+        return &mr_;
+    }
+
+    /// Free everything allocated so far
+    void
+    reset() noexcept
+    {
+        mr_.release();
+    }
+
+    /** Prepare an arena for the next request.
+
+        The arena is reset if the caller holds the only
+        reference, otherwise it is replaced with a new one.
+    */
+    static
+    void
+    recycle(boost::shared_ptr<rpc_arena>& sp)
+    {
+        if(sp && sp.use_count() == 1)
+            sp->reset();
+        else
+            sp = boost::make_shared<rpc_arena>();
+    }
+};
+
+#endif
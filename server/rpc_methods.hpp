@@ -0,0 +1,298 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_RPC_METHODS_HPP
+#define LOUNGE_RPC_METHODS_HPP
+
+#include "config.hpp"
+#include <boost/beast/core/string.hpp>
+#include <boost/json/array.hpp>
+#include <boost/json/object.hpp>
+#include <boost/json/value.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace detail {
+
+// FNV-1a, usable in constant expressions
+constexpr
+std::uint32_t
+rpc_method_hash(
+    char const* s,
+    std::size_t n,
+    std::uint32_t h = 2166136261u) noexcept
+{
+    return n == 0 ? h : rpc_method_hash(s + 1, n - 1,
+        (h ^ static_cast<unsigned char>(*s)) * 16777619u);
+}
+
+inline
+std::uint32_t
+rpc_method_hash(beast::string_view s) noexcept
+{
+    std::uint32_t h = 2166136261u;
+    for(auto c : s)
+        h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+    return h;
+}
+
+} // detail
+
+/** An RPC method of a channel.
+
+    A channel declares its methods once, as a constexpr
+    array of these, and dispatches through an
+    @ref rpc_method_table built from the array.
+
+    @tparam Handler The type of the function called
+    for the method, usually a pointer to member.
+*/
+template<class Handler>
+struct rpc_method
+{
+    /// The name of the method
+    char const* name;
+
+    /// The length of the name
+    std::size_t size;
+
+    /// The hash of the name
+    std::uint32_t hash;
+
+    /// The function which performs the method
+    Handler handler;
+
+    /// `false` if the method uses only the channel id
+    bool needs_params;
+
+    /** `true` if the method runs on the RPC pool.
+
+        This is for handlers which take long enough that
+        they should not hold up the session's strand. It
+        is honored by channels which dispatch through
+        `channel::invoke`. See @ref rpc_pool.
+    */
+    bool async;
+
+    template<std::size_t N>
+    constexpr
+    rpc_method(
+        char const(&name_)[N],
+        Handler handler_,
+        bool needs_params_ = true,
+        bool async_ = false)
+        : name(name_)
+        , size(N - 1)
+        , hash(detail::rpc_method_hash(name_, N - 1))
+        , handler(handler_)
+        , needs_params(needs_params_)
+        , async(async_)
+    {
+    }
+};
+
+namespace detail {
+
+// These work on any list of elements with a `hash`
+
+template<class T>
+constexpr
+bool
+rpc_hash_differs(
+    T const* first,
+    std::size_t n,
+    std::uint32_t hash) noexcept
+{
+    return n == 0 || (first->hash != hash &&
+        rpc_hash_differs(first + 1, n - 1, hash));
+}
+
+template<class T>
+constexpr
+bool
+rpc_hashes_unique(
+    T const* first,
+    std::size_t n) noexcept
+{
+    return n == 0 || (
+        rpc_hash_differs(first + 1, n - 1, first->hash) &&
+        rpc_hashes_unique(first + 1, n - 1));
+}
+
+template<class T>
+constexpr
+bool
+rpc_none_async(
+    T const* first,
+    std::size_t n) noexcept
+{
+    return n == 0 || (! first->async &&
+        rpc_none_async(first + 1, n - 1));
+}
+
+} // detail
+
+/** Return `true` if no two methods in a list have the same hash.
+
+    This is checked at compile time, so a lookup which finds
+    a matching hash needs only one string comparison:
+
+    @code
+    static constexpr rpc_method<handler> list[] = { ... };
+    static_assert(rpc_methods_unique(list), "");
+    @endcode
+*/
+template<class Handler, std::size_t N>
+constexpr
+bool
+rpc_methods_unique(
+    rpc_method<Handler> const(&list)[N]) noexcept
+{
+    return detail::rpc_hashes_unique(list, N);
+}
+
+/** Return `true` if no method in a list is marked `async`.
+
+    A channel which runs its methods on its own strand
+    checks this at compile time, since those methods
+    cannot be moved to the @ref rpc_pool.
+*/
+template<class Handler, std::size_t N>
+constexpr
+bool
+rpc_methods_sync(
+    rpc_method<Handler> const(&list)[N]) noexcept
+{
+    return detail::rpc_none_async(list, N);
+}
+
+/** A table of the RPC methods of a channel.
+
+    Methods are found by the hash of their name, which is
+    computed at compile time for the table and once for each
+    lookup. The methods are indexed in order of their hash
+    when the table is constructed, so a lookup is a binary
+    search. The table counts the calls to each method.
+
+    Thread safe.
+*/
+template<class Handler>
+class rpc_method_table
+{
+    rpc_method<Handler> const* list_;
+    std::size_t size_;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> calls_;
+    std::unique_ptr<rpc_method<Handler> const*[]> sorted_;
+
+    static
+    bool
+    hash_less(
+        rpc_method<Handler> const* m,
+        std::uint32_t h) noexcept
+    {
+        return m->hash < h;
+    }
+
+public:
+    using value_type = rpc_method<Handler>;
+    using const_iterator = value_type const*;
+
+    /// Construct a table from a static array of methods
+    template<std::size_t N>
+    explicit
+    rpc_method_table(
+        rpc_method<Handler> const(&list)[N])
+        : list_(list)
+        , size_(N)
+        , calls_(new std::atomic<std::uint64_t>[N])
+        , sorted_(new rpc_method<Handler> const*[N])
+    {
+        for(std::size_t i = 0; i < N; ++i)
+        {
+            calls_[i].store(0, std::memory_order_relaxed);
+            sorted_[i] = &list[i];
+        }
+        std::sort(sorted_.get(), sorted_.get() + N,
+            [](value_type const* lhs, value_type const* rhs)
+            {
+                return lhs->hash < rhs->hash;
+            });
+    }
+
+    /// Return the number of methods
+    std::size_t
+    size() const noexcept
+    {
+        return size_;
+    }
+
+    const_iterator
+    begin() const noexcept
+    {
+        return list_;
+    }
+
+    const_iterator
+    end() const noexcept
+    {
+        return list_ + size_;
+    }
+
+    /// Return a method by name, or null
+    value_type const*
+    find(beast::string_view name) const noexcept
+    {
+        // Hashes are unique, so at most one can match
+        auto const h = detail::rpc_method_hash(name);
+        auto const last = sorted_.get() + size_;
+        auto const it = std::lower_bound(
+            sorted_.get(), last, h, &hash_less);
+        if( it == last || (*it)->hash != h ||
+            name != beast::string_view((*it)->name, (*it)->size))
+            return nullptr;
+        return *it;
+    }
+
+    /// Return a method by name and count a call, or null
+    value_type const*
+    call(beast::string_view name) noexcept
+    {
+        auto const p = find(name);
+        if(p)
+            calls_[p - list_].fetch_add(
+                1, std::memory_order_relaxed);
+        return p;
+    }
+
+    /// Return the number of calls to a method
+    std::uint64_t
+    calls(value_type const& m) const noexcept
+    {
+        return calls_[&m - list_].load(
+            std::memory_order_relaxed);
+    }
+
+    /// Append the name and number of calls of each method
+    void
+    to_json(json::array& arr) const
+    {
+        for(auto const& m : *this)
+        {
+            json::value jv(json::object_kind);
+            auto& obj = jv.get_object();
+            obj["method"] = beast::string_view(m.name, m.size);
+            obj["calls"] = calls(m);
+            arr.emplace_back(std::move(jv));
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,206 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_RPC_PARAMS_HPP
+#define LOUNGE_RPC_PARAMS_HPP
+
+#include "config.hpp"
+#include "rpc.hpp"
+#include "rpc_methods.hpp"
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/core/string.hpp>
+#include <boost/json/object.hpp>
+#include <boost/json/value.hpp>
+#include <cstdint>
+
+namespace detail {
+
+inline
+beast::error_code
+rpc_param_value(
+    json::value& jv,
+    beast::string_view& v)
+{
+    if(! jv.is_string())
+        return rpc_code::expected_string_param;
+    auto const& s = jv.get_string();
+    v = {s.data(), s.size()};
+    return {};
+}
+
+inline
+beast::error_code
+rpc_param_value(
+    json::value& jv,
+    std::uint64_t& v)
+{
+    if(jv.is_uint64())
+        v = jv.get_uint64();
+    else if(jv.is_int64() && jv.get_int64() >= 0)
+        v = static_cast<std::uint64_t>(jv.get_int64());
+    else
+        return rpc_code::expected_uint64_param;
+    return {};
+}
+
+inline
+beast::error_code
+rpc_param_value(
+    json::value& jv,
+    bool& v)
+{
+    if(! jv.is_bool())
+        return rpc_code::expected_bool_param;
+    v = jv.get_bool();
+    return {};
+}
+
+inline
+beast::error_code
+rpc_param_value(
+    json::value& jv,
+    json::value*& v)
+{
+    v = &jv;
+    return {};
+}
+
+} // detail
+
+/** A named parameter of an RPC method.
+
+    A method declares its parameters once, as a constexpr
+    array of these, and reads them from the request with
+    @ref rpc_bind:
+
+    @code
+    struct say_params
+    {
+        beast::string_view message;
+    };
+
+    static constexpr rpc_param<say_params> say_schema[] = {
+        { "message", &rpc_param<say_params>::member<
+            beast::string_view, &say_params::message> },
+    };
+    @endcode
+
+    A member may be a `beast::string_view`, which refers to
+    the string in the params, a `std::uint64_t`, a `bool`,
+    or a `json::value*` which points to any value.
+
+    @tparam Params The struct which receives the values.
+*/
+template<class Params>
+struct rpc_param
+{
+    /// Store a value in the struct, or return an error
+    using bind_fn = beast::error_code(*)(
+        Params&, json::value&);
+
+    /// The key of the parameter
+    char const* name;
+
+    /// The length of the key
+    std::size_t size;
+
+    /// The hash of the key
+    std::uint32_t hash;
+
+    /// The function which stores the value
+    bind_fn bind;
+
+    /// `false` if the member keeps its value when the key is absent
+    bool required;
+
+    template<std::size_t N>
+    constexpr
+    rpc_param(
+        char const(&name_)[N],
+        bind_fn bind_,
+        bool required_ = true)
+        : name(name_)
+        , size(N - 1)
+        , hash(detail::rpc_method_hash(name_, N - 1))
+        , bind(bind_)
+        , required(required_)
+    {
+    }
+
+    /// A @ref bind_fn which stores the value in a data member
+    template<class T, T Params::*Member>
+    static
+    beast::error_code
+    member(Params& p, json::value& jv)
+    {
+        return detail::rpc_param_value(jv, p.*Member);
+    }
+};
+
+/** Return `true` if no two parameters in a list have the same hash.
+
+    @code
+    static_assert(rpc_params_unique(say_schema), "");
+    @endcode
+*/
+template<class Params, std::size_t N>
+constexpr
+bool
+rpc_params_unique(
+    rpc_param<Params> const(&list)[N]) noexcept
+{
+    return detail::rpc_hashes_unique(list, N);
+}
+
+/** Read the params of a request into a struct.
+
+    Each member of the params object is visited once, and
+    its key is hashed once and matched against the hashes
+    of the list. Keys which are not in the list are ignored.
+
+    @returns The first error, which is one of the codes
+    from @ref rpc_code. No message is built for it.
+*/
+template<class Params, std::size_t N>
+beast::error_code
+rpc_bind(
+    rpc_param<Params> const(&list)[N],
+    json::value& params,
+    Params& p)
+{
+    static_assert(N <= 64,
+        "too many parameters");
+    if(! params.is_object())
+        return rpc_code::expected_object_param;
+    std::uint64_t seen = 0;
+    for(auto&& kv : params.get_object())
+    {
+        beast::string_view const key = kv.key();
+        auto const h = detail::rpc_method_hash(key);
+        for(std::size_t i = 0; i < N; ++i)
+        {
+            if( list[i].hash != h ||
+                key != beast::string_view(
+                    list[i].name, list[i].size))
+                continue;
+            auto const ec = list[i].bind(p, kv.value());
+            if(ec)
+                return ec;
+            seen |= std::uint64_t(1) << i;
+            break;
+        }
+    }
+    for(std::size_t i = 0; i < N; ++i)
+        if( list[i].required &&
+            ! (seen & (std::uint64_t(1) << i)))
+            return rpc_code::missing_param;
+    return {};
+}
+
+#endif
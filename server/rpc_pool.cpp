@@ -0,0 +1,158 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#include "rpc_pool.hpp"
+#include "logger.hpp"
+#include "rpc.hpp"
+#include "server.hpp"
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/make_unique.hpp>
+#include <boost/smart_ptr/make_shared.hpp>
+#include <atomic>
+#include <exception>
+#include <utility>
+
+namespace {
+
+class rpc_pool_impl : public rpc_pool
+{
+    section& log_;
+    std::size_t const max_pending_;
+    std::atomic<std::size_t> pending_;
+
+    // runs the methods
+    net::thread_pool pool_;
+
+public:
+    rpc_pool_impl(
+        server& srv,
+        std::size_t threads,
+        std::size_t max_pending)
+        : log_(srv.log().get_section("rpc_pool"))
+        , max_pending_(max_pending > 0 ? max_pending : 1)
+        , pending_(0)
+        , pool_(threads > 0 ? threads : 1)
+    {
+    }
+
+    //--------------------------------------------------------------------------
+    //
+    // service
+    //
+    //--------------------------------------------------------------------------
+
+    void
+    on_start() override
+    {
+    }
+
+    void
+    on_stop() override
+    {
+        // Abandon pending requests
+        pool_.stop();
+    }
+
+    //--------------------------------------------------------------------------
+    //
+    // rpc_pool
+    //
+    //--------------------------------------------------------------------------
+
+    beast::error_code
+    post(rpc_call& rpc, handler_type f) override
+    {
+        if(pending_.fetch_add(1,
+            std::memory_order_relaxed) >= max_pending_)
+        {
+            pending_.fetch_sub(1,
+                std::memory_order_relaxed);
+            LOG_TRC(log_, "busy\t", beast::string_view(
+                rpc.method.data(), rpc.method.size()));
+            return rpc_code::server_busy;
+        }
+
+        // The function given to the pool must be
+        // copyable, and the request can only be moved.
+        auto sp = boost::make_shared<
+            rpc_call>(std::move(rpc));
+        net::post(
+            pool_,
+            [this, sp, f]
+            {
+                run(*sp, f);
+            });
+        return {};
+    }
+
+    std::size_t
+    pending() const noexcept override
+    {
+        return pending_.load(
+            std::memory_order_relaxed);
+    }
+
+private:
+    // Called on the pool
+    void
+    run(rpc_call& rpc, handler_type const& f)
+    {
+        // The request is counted until this returns,
+        // however the method ends.
+        struct release
+        {
+            std::atomic<std::size_t>& n;
+
+            ~release()
+            {
+                n.fetch_sub(1,
+                    std::memory_order_relaxed);
+            }
+        };
+        release r{pending_};
+
+        try
+        {
+            auto const ec = f(rpc);
+            if(ec)
+                rpc.complete(ec);
+        }
+        catch(rpc_error const& e)
+        {
+            rpc.complete(e);
+        }
+        catch(std::exception const& e)
+        {
+            LOG_ERR(log_, "exception\t", e.what());
+            rpc.complete(rpc_error(
+                rpc_code::internal_error));
+        }
+        catch(...)
+        {
+            LOG_ERR(log_, "exception");
+            rpc.complete(rpc_error(
+                rpc_code::internal_error));
+        }
+    }
+};
+
+} // (anon)
+
+//------------------------------------------------------------------------------
+
+std::unique_ptr<rpc_pool>
+make_rpc_pool(
+    server& srv,
+    std::size_t threads,
+    std::size_t max_pending)
+{
+    return boost::make_unique<rpc_pool_impl>(
+        srv, threads, max_pending);
+}
@@ -0,0 +1,69 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_RPC_POOL_HPP
+#define LOUNGE_RPC_POOL_HPP
+
+#include "config.hpp"
+#include "service.hpp"
+#include <boost/beast/core/error.hpp>
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+class rpc_call;
+class server;
+
+/** A pool of threads which runs expensive RPC methods.
+
+    Methods marked `async` in their channel's method table
+    are handed to this pool instead of running on the strand
+    of the session which read them, so the session goes on
+    reading while they run, and the network threads are not
+    held up by them.
+
+    The number of requests waiting for or running on the
+    pool is limited. Past the limit, requests are refused
+    with @ref rpc_code::server_busy.
+*/
+class rpc_pool : public service
+{
+public:
+    /** The type of function which performs a method.
+
+        The request is completed with the returned error, if
+        any, or with the `rpc_error` it throws. Any other
+        exception completes it with an internal error.
+        Otherwise the function must complete the request
+        itself.
+    */
+    using handler_type =
+        std::function<beast::error_code(rpc_call&)>;
+
+    /** Run a method on the pool.
+
+        On success the request is moved into the pool and the
+        function is called with it on one of the pool's threads.
+        Its reply is delivered to the session's strand by
+        @ref user::send, which may be called from any thread.
+
+        @returns @ref rpc_code::server_busy, leaving the
+        request unchanged, if the pool is full.
+    */
+    virtual
+    beast::error_code
+    post(rpc_call& rpc, handler_type f) = 0;
+
+    /// Return the number of requests waiting or running
+    virtual
+    std::size_t
+    pending() const noexcept = 0;
+};
+
+#endif
@@ -0,0 +1,428 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_RPC_SCAN_HPP
+#define LOUNGE_RPC_SCAN_HPP
+
+#include "config.hpp"
+#include <boost/beast/core/string.hpp>
+#include <cstddef>
+#include <limits>
+
+/** The fields of a JSON-RPC request needed to route it.
+
+    These are found by @ref rpc_prescan without building
+    a value. The views point into the scanned text.
+*/
+struct rpc_route
+{
+    /// The method, valid when `has_method` is set
+    beast::string_view method;
+
+    /// The JSON text of the id, or empty if there is none
+    beast::string_view id;
+
+    /// The "cid" of the params, valid when `has_cid` is set
+    std::size_t cid = 0;
+
+    /// `true` if the request has "jsonrpc": "2.0"
+    bool v2 = false;
+
+    /// `true` if the method is a string without escapes
+    bool has_method = false;
+
+    /// `true` if the params have an unsigned integer "cid"
+    bool has_cid = false;
+};
+
+namespace detail {
+
+class rpc_scanner
+{
+    char const* p_;
+    char const* end_;
+
+    // Nesting deeper than this is rejected
+    static int constexpr max_depth = 64;
+
+    static
+    bool
+    is_digit(char c) noexcept
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    static
+    bool
+    is_hex(char c) noexcept
+    {
+        return is_digit(c) ||
+            (c >= 'a' && c <= 'f') ||
+            (c >= 'A' && c <= 'F');
+    }
+
+    void
+    skip_ws() noexcept
+    {
+        while(p_ != end_ && (
+            *p_ == ' ' || *p_ == '\t' ||
+            *p_ == '\n' || *p_ == '\r'))
+            ++p_;
+    }
+
+    bool
+    consume(char c) noexcept
+    {
+        skip_ws();
+        if(p_ == end_ || *p_ != c)
+            return false;
+        ++p_;
+        return true;
+    }
+
+    bool
+    literal(beast::string_view s) noexcept
+    {
+        if(static_cast<std::size_t>(end_ - p_) < s.size() ||
+            beast::string_view(p_, s.size()) != s)
+            return false;
+        p_ += s.size();
+        return true;
+    }
+
+    // Set `s` to the contents, which are left escaped
+    bool
+    string(beast::string_view& s, bool& escaped) noexcept
+    {
+        if(! consume('"'))
+            return false;
+        auto const first = p_;
+        escaped = false;
+        while(p_ != end_)
+        {
+            auto const c = *p_;
+            if(c == '"')
+            {
+                s = {first, static_cast<std::size_t>(p_ - first)};
+                ++p_;
+                return true;
+            }
+            if(static_cast<unsigned char>(c) < 0x20)
+                return false;
+            ++p_;
+            if(c != '\\')
+                continue;
+            escaped = true;
+            if(p_ == end_)
+                return false;
+            switch(*p_++)
+            {
+            case '"': case '\\': case '/':
+            case 'b': case 'f': case 'n': case 'r': case 't':
+                break;
+            case 'u':
+                for(int i = 0; i < 4; ++i)
+                    if(p_ == end_ || ! is_hex(*p_++))
+                        return false;
+                break;
+            default:
+                return false;
+            }
+        }
+        return false;
+    }
+
+    bool
+    number() noexcept
+    {
+        if(p_ != end_ && *p_ == '-')
+            ++p_;
+        if(p_ == end_)
+            return false;
+        if(*p_ == '0')
+            ++p_;
+        else if(! digits())
+            return false;
+        if(p_ != end_ && *p_ == '.')
+        {
+            ++p_;
+            if(! digits())
+                return false;
+        }
+        if(p_ != end_ && (*p_ == 'e' || *p_ == 'E'))
+        {
+            ++p_;
+            if(p_ != end_ && (*p_ == '+' || *p_ == '-'))
+                ++p_;
+            if(! digits())
+                return false;
+        }
+        return true;
+    }
+
+    bool
+    digits() noexcept
+    {
+        auto const first = p_;
+        while(p_ != end_ && is_digit(*p_))
+            ++p_;
+        return p_ != first;
+    }
+
+    // Read an integer which fits in std::size_t, or
+    // leave the position unchanged and return false.
+    bool
+    unsigned_integer(std::size_t& n) noexcept
+    {
+        skip_ws();
+        auto p = p_;
+        if(p == end_ || ! is_digit(*p))
+            return false;
+        if(*p == '0')
+        {
+            n = 0;
+            ++p;
+        }
+        else
+        {
+            std::size_t v = 0;
+            while(p != end_ && is_digit(*p))
+            {
+                std::size_t const d = *p - '0';
+                if(v > ((std::numeric_limits<
+                        std::size_t>::max)() - d) / 10)
+                    return false;
+                v = v * 10 + d;
+                ++p;
+            }
+            n = v;
+        }
+        if(p != end_ && (
+            *p == '.' || *p == 'e' || *p == 'E' ||
+            is_digit(*p)))
+            return false;
+        p_ = p;
+        return true;
+    }
+
+    // Validate and skip one value, setting `text` to it
+    bool
+    value(beast::string_view& text, int depth = 0) noexcept
+    {
+        if(depth > max_depth)
+            return false;
+        skip_ws();
+        if(p_ == end_)
+            return false;
+        auto const first = p_;
+        bool ok;
+        switch(*p_)
+        {
+        case '"':
+        {
+            beast::string_view s;
+            bool escaped;
+            ok = string(s, escaped);
+            break;
+        }
+
+        case '{':
+        {
+            ++p_;
+            ok = members(depth,
+                [this, depth](beast::string_view)
+                {
+                    beast::string_view v;
+                    return value(v, depth + 1);
+                });
+            break;
+        }
+
+        case '[':
+        {
+            ++p_;
+            skip_ws();
+            if(p_ != end_ && *p_ == ']')
+            {
+                ++p_;
+                ok = true;
+                break;
+            }
+            beast::string_view v;
+            for(;;)
+            {
+                ok = value(v, depth + 1);
+                if(! ok || consume(']'))
+                    break;
+                ok = consume(',');
+                if(! ok)
+                    break;
+            }
+            break;
+        }
+
+        case 't': ok = literal("true"); break;
+        case 'f': ok = literal("false"); break;
+        case 'n': ok = literal("null"); break;
+        default: ok = number(); break;
+        }
+        if(! ok)
+            return false;
+        text = {first, static_cast<std::size_t>(p_ - first)};
+        return true;
+    }
+
+    // Visit the members of an object whose opening
+    // brace was consumed. The visitor reads the value.
+    template<class F>
+    bool
+    members(int depth, F const& f)
+    {
+        if(depth > max_depth)
+            return false;
+        if(consume('}'))
+            return true;
+        for(;;)
+        {
+            beast::string_view key;
+            bool escaped;
+            if(! string(key, escaped) || ! consume(':'))
+                return false;
+            // An escaped key can never match one of ours
+            if(! f(escaped ? beast::string_view() : key))
+                return false;
+            if(consume('}'))
+                return true;
+            if(! consume(','))
+                return false;
+        }
+    }
+
+    bool
+    params(rpc_route& r)
+    {
+        skip_ws();
+        if(p_ == end_ || *p_ != '{')
+        {
+            beast::string_view v;
+            return value(v, 1);
+        }
+        ++p_;
+        return members(1,
+            [this, &r](beast::string_view key)
+            {
+                if(key == "cid")
+                {
+                    if(r.has_cid)
+                        return false;
+                    if(unsigned_integer(r.cid))
+                    {
+                        r.has_cid = true;
+                        return true;
+                    }
+                }
+                beast::string_view v;
+                return value(v, 2);
+            });
+    }
+
+public:
+    explicit
+    rpc_scanner(beast::string_view s) noexcept
+        : p_(s.data())
+        , end_(s.data() + s.size())
+    {
+    }
+
+    bool
+    scan(rpc_route& r)
+    {
+        bool seen_method = false;
+        bool seen_params = false;
+        bool seen_version = false;
+        if(! consume('{'))
+            return false;
+        auto const ok = members(0,
+            [&](beast::string_view key)
+            {
+                beast::string_view v;
+                if(key == "method")
+                {
+                    if(seen_method)
+                        return false;
+                    seen_method = true;
+                    if(! value(v, 1))
+                        return false;
+                    // Only a string without escapes can
+                    // be compared without decoding it.
+                    if( v.size() >= 2 && v.front() == '"' &&
+                        v.find('\\') == beast::string_view::npos)
+                    {
+                        r.method = v.substr(1, v.size() - 2);
+                        r.has_method = true;
+                    }
+                    return true;
+                }
+                if(key == "id")
+                {
+                    if(! r.id.empty())
+                        return false;
+                    return value(r.id, 1);
+                }
+                if(key == "jsonrpc")
+                {
+                    if(seen_version)
+                        return false;
+                    seen_version = true;
+                    if(! value(v, 1))
+                        return false;
+                    r.v2 = v == "\"2.0\"";
+                    return true;
+                }
+                if(key == "params")
+                {
+                    if(seen_params)
+                        return false;
+                    seen_params = true;
+                    return params(r);
+                }
+                return value(v, 1);
+            });
+        skip_ws();
+        return ok && p_ == end_;
+    }
+};
+
+} // detail
+
+/** Find the routing fields of a JSON-RPC request.
+
+    This reads the method, the id, and the channel id in the
+    params without allocating or building a value, so that a
+    request can be routed before it is parsed, and need not be
+    parsed at all when its method uses nothing else.
+
+    The text is checked to be one well-formed JSON object,
+    except that strings are not checked to be valid UTF-8.
+
+    @returns `false` if the text is not a JSON object, or if
+    it repeats one of the keys used for routing. Then the
+    request must be parsed to find out what is wrong with it.
+*/
+inline
+bool
+rpc_prescan(
+    beast::string_view s,
+    rpc_route& r)
+{
+    r = {};
+    return detail::rpc_scanner(s).scan(r);
+}
+
+#endif
@@ -0,0 +1,360 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_SEND_QUEUE_HPP
+#define LOUNGE_SEND_QUEUE_HPP
+
+#include "config.hpp"
+#include "message.hpp"
+#include <boost/beast/core/buffer_traits.hpp>
+#include <boost/assert.hpp>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+/// What a session does when its outgoing queue is full
+enum class overflow_policy
+{
+    /// Discard the oldest messages which are not being written
+    drop_oldest,
+
+    /** Replace a queued message having the same key.
+
+        Messages with a non-zero key carry state which a
+        newer message with the same key supersedes. When
+        no such message is queued the oldest is dropped.
+    */
+    coalesce,
+
+    /// Close the connection
+    disconnect
+};
+
+/// Limits on the outgoing queue of each session
+struct send_limits
+{
+    /// The largest number of queued messages
+    std::size_t max_messages = 1024;
+
+    /// The largest number of queued bytes
+    std::size_t max_bytes = 4 * 1024 * 1024;
+
+    /// The action taken when a limit is exceeded
+    overflow_policy policy = overflow_policy::disconnect;
+};
+
+/// A snapshot of the counters of a send queue
+struct send_queue_stats
+{
+    /// The number of queued messages
+    std::size_t messages = 0;
+
+    /// The number of queued bytes
+    std::size_t bytes = 0;
+
+    /// The largest number of bytes ever queued
+    std::size_t peak_bytes = 0;
+
+    /// The number of messages discarded or replaced
+    std::uint64_t dropped = 0;
+};
+
+/** A bounded FIFO of outgoing messages.
+
+    Messages are held in a ring buffer which grows as needed
+    up to the limit. Messages at the front may be marked as
+    being written; these are never dropped or replaced.
+
+    All functions except @ref stats must be called from the
+    same strand. The counters may be read from any thread.
+*/
+class send_queue
+{
+    std::vector<message> v_;
+    std::size_t head_ = 0;
+    std::size_t size_ = 0;
+    std::size_t busy_ = 0;
+    std::size_t bytes_ = 0;
+    send_limits limits_;
+
+    std::atomic<std::size_t> messages_{0};
+    std::atomic<std::size_t> bytes_out_{0};
+    std::atomic<std::size_t> peak_{0};
+    std::atomic<std::uint64_t> dropped_{0};
+
+    message&
+    at(std::size_t i) noexcept
+    {
+        return v_[(head_ + i) & (v_.size() - 1)];
+    }
+
+    static
+    std::size_t
+    size_of(message const& m) noexcept
+    {
+        return beast::buffer_bytes(m);
+    }
+
+    void
+    grow()
+    {
+        std::vector<message> v(v_.empty() ? 16 : 2 * v_.size());
+        for(std::size_t i = 0; i < size_; ++i)
+            swap(v[i], at(i));
+        v_.swap(v);
+        head_ = 0;
+    }
+
+    bool
+    over() const noexcept
+    {
+        return
+            size_ > limits_.max_messages ||
+            bytes_ > limits_.max_bytes;
+    }
+
+    // Remove the message at position i
+    void
+    erase(std::size_t i) noexcept
+    {
+        BOOST_ASSERT(i >= busy_ && i < size_);
+        bytes_ -= size_of(at(i));
+        for(; i > 0; --i)
+            swap(at(i), at(i - 1));
+        message m;
+        swap(m, at(0));
+        head_ = (head_ + 1) & (v_.size() - 1);
+        --size_;
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Replace an unsent message with the same key
+    bool
+    replace(message& m) noexcept
+    {
+        if(m.key() == 0)
+            return false;
+        for(auto i = busy_; i < size_; ++i)
+        {
+            auto& e = at(i);
+            if(e.key() != m.key())
+                continue;
+            bytes_ = bytes_ - size_of(e) + size_of(m);
+            swap(e, m);
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    void
+    update() noexcept
+    {
+        messages_.store(size_, std::memory_order_relaxed);
+        bytes_out_.store(bytes_, std::memory_order_relaxed);
+        if(bytes_ > peak_.load(std::memory_order_relaxed))
+            peak_.store(bytes_, std::memory_order_relaxed);
+    }
+
+public:
+    class const_iterator
+    {
+        friend class send_queue;
+
+        send_queue* q_ = nullptr;
+        std::size_t i_ = 0;
+
+        const_iterator(
+            send_queue* q,
+            std::size_t i) noexcept
+            : q_(q)
+            , i_(i)
+        {
+        }
+
+    public:
+        using value_type = message;
+        using pointer = message const*;
+        using reference = message const&;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::forward_iterator_tag;
+
+        const_iterator() = default;
+
+        reference
+        operator*() const noexcept
+        {
+            return q_->at(i_);
+        }
+
+        pointer
+        operator->() const noexcept
+        {
+            return &q_->at(i_);
+        }
+
+        const_iterator&
+        operator++() noexcept
+        {
+            ++i_;
+            return *this;
+        }
+
+        const_iterator
+        operator++(int) noexcept
+        {
+            auto temp = *this;
+            ++i_;
+            return temp;
+        }
+
+        bool
+        operator==(const_iterator const& other) const noexcept
+        {
+            return i_ == other.i_;
+        }
+
+        bool
+        operator!=(const_iterator const& other) const noexcept
+        {
+            return i_ != other.i_;
+        }
+    };
+
+    explicit
+    send_queue(send_limits const& limits)
+        : limits_(limits)
+    {
+    }
+
+    /// Returns `true` if no messages are queued
+    bool
+    empty() const noexcept
+    {
+        return size_ == 0;
+    }
+
+    /// Return the number of queued messages
+    std::size_t
+    size() const noexcept
+    {
+        return size_;
+    }
+
+    /// Return the number of messages being written
+    std::size_t
+    busy() const noexcept
+    {
+        return busy_;
+    }
+
+    /// Return an iterator to the first message
+    const_iterator
+    begin() noexcept
+    {
+        return {this, 0};
+    }
+
+    /// Return an iterator to one past the last message
+    const_iterator
+    end() noexcept
+    {
+        return {this, size_};
+    }
+
+    /** Append a message, applying the overflow policy.
+
+        The message being added and those being written are
+        never dropped, so the queue may briefly hold more than
+        the limit while a large write is in progress.
+
+        @returns `false` if the policy is to disconnect and a
+        limit would be exceeded. The message is not queued.
+    */
+    bool
+    push(message m)
+    {
+        auto const n = size_of(m);
+        if( size_ + 1 > limits_.max_messages ||
+            bytes_ + n > limits_.max_bytes)
+        {
+            if(limits_.policy == overflow_policy::disconnect)
+                return false;
+            if( limits_.policy == overflow_policy::coalesce &&
+                replace(m))
+            {
+                while(over() && size_ > busy_ + 1)
+                    erase(busy_);
+                update();
+                return true;
+            }
+        }
+        if(size_ == v_.size())
+            grow();
+        swap(at(size_), m);
+        ++size_;
+        bytes_ += n;
+        while(over() && size_ > busy_ + 1)
+            erase(busy_);
+        update();
+        return true;
+    }
+
+    /// Mark the first `n` messages as being written
+    void
+    begin_write(std::size_t n) noexcept
+    {
+        BOOST_ASSERT(busy_ == 0 && n <= size_);
+        busy_ = n;
+    }
+
+    /// Remove the messages which were written
+    void
+    end_write() noexcept
+    {
+        for(; busy_ > 0; --busy_)
+        {
+            bytes_ -= size_of(at(0));
+            message m;
+            swap(m, at(0));
+            head_ = (head_ + 1) & (v_.size() - 1);
+            --size_;
+        }
+        update();
+    }
+
+    /// Remove all messages which are not being written
+    void
+    clear() noexcept
+    {
+        while(size_ > busy_)
+        {
+            --size_;
+            bytes_ -= size_of(at(size_));
+            message m;
+            swap(m, at(size_));
+        }
+        update();
+    }
+
+    /// Return the counters
+    send_queue_stats
+    stats() const noexcept
+    {
+        send_queue_stats st;
+        st.messages = messages_.load(std::memory_order_relaxed);
+        st.bytes = bytes_out_.load(std::memory_order_relaxed);
+        st.peak_bytes = peak_.load(std::memory_order_relaxed);
+        st.dropped = dropped_.load(std::memory_order_relaxed);
+        return st;
+    }
+};
+
+#endif
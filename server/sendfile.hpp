@@ -0,0 +1,146 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_SENDFILE_HPP
+#define LOUNGE_SENDFILE_HPP
+
+#include "config.hpp"
+
+#ifdef __linux__
+#define LOUNGE_HAS_SENDFILE 1
+
+#include <boost/beast/core/bind_handler.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/socket_base.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <sys/sendfile.h>
+
+namespace detail {
+
+template<class Socket>
+class sendfile_op
+{
+    Socket& sock_;
+    int fd_;
+    off_t offset_;
+    std::uint64_t remain_;
+    std::size_t total_ = 0;
+    bool cont_ = false;
+
+public:
+    sendfile_op(
+        Socket& sock,
+        int fd,
+        std::uint64_t offset,
+        std::uint64_t count)
+        : sock_(sock)
+        , fd_(fd)
+        , offset_(static_cast<off_t>(offset))
+        , remain_(count)
+    {
+    }
+
+    template<class Self>
+    void
+    operator()(
+        Self& self,
+        beast::error_code ec = {})
+    {
+        bool const start = ! cont_;
+        if(start)
+        {
+            cont_ = true;
+            sock_.native_non_blocking(true, ec);
+        }
+        while(! ec && remain_ > 0)
+        {
+            // The kernel advances offset_
+            auto const n = ::sendfile(
+                sock_.native_handle(), fd_, &offset_,
+                static_cast<std::size_t>((std::min)(
+                    remain_, std::uint64_t(0x7ffff000))));
+            if(n > 0)
+            {
+                remain_ -= static_cast<std::uint64_t>(n);
+                total_ += static_cast<std::size_t>(n);
+            }
+            else if(n == 0)
+            {
+                // The file was truncated
+                ec = net::error::eof;
+            }
+            else if(errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                // Wait until the socket buffer drains
+                return sock_.async_wait(
+                    net::socket_base::wait_write,
+                    std::move(self));
+            }
+            else if(errno != EINTR)
+            {
+                ec.assign(errno,
+                    boost::system::generic_category());
+            }
+        }
+        if(start)
+        {
+            // Never invoke the handler from
+            // inside the initiating function.
+            return net::post(
+                sock_.get_executor(),
+                beast::bind_front_handler(
+                    std::move(self), ec));
+        }
+        self.complete(ec, total_);
+    }
+};
+
+} // detail
+
+/** Send part of a file to a socket without copying it to user space.
+
+    The socket is put into non-blocking mode and bytes are
+    moved from the page cache to the socket with `sendfile`,
+    waiting for the socket to become writable as needed.
+
+    @param sock The connected socket to write to.
+
+    @param fd An open file descriptor of a regular file.
+
+    @param offset The position in the file of the first byte.
+
+    @param count The number of bytes to send.
+
+    @param handler Invoked with the signature
+    `void(error_code, std::size_t bytes_transferred)`.
+*/
+template<class Socket, class WriteHandler>
+BOOST_BEAST_ASYNC_RESULT2(WriteHandler)
+async_sendfile(
+    Socket& sock,
+    int fd,
+    std::uint64_t offset,
+    std::uint64_t count,
+    WriteHandler&& handler)
+{
+    return net::async_compose<WriteHandler,
+        void(beast::error_code, std::size_t)>(
+            detail::sendfile_op<Socket>(
+                sock, fd, offset, count),
+            handler, sock);
+}
+
+#endif
+
+#endif
@@ -11,13 +11,22 @@
 #include "channel_list.hpp"
 #include "listener.hpp"
 #include "logger.hpp"
+#include "message.hpp"
+#include "rpc_pool.hpp"
+#include "send_queue.hpp"
 #include "server.hpp"
 #include "service.hpp"
+#include "user.hpp"
 #include "utility.hpp"
+#include "ws_deflate.hpp"
 #include <boost/json.hpp>
 #include <boost/asio/basic_waitable_timer.hpp>
 #include <boost/asio/basic_signal_set.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
 #include <boost/assert.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
 #include <boost/make_unique.hpp>
 #include <boost/throw_exception.hpp>
 #include <atomic>
@@ -28,6 +37,19 @@
 #include <thread>
 #include <vector>
 
+#ifdef __linux__
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#endif
+
+#ifdef LOUNGE_IO_URING
+#include <liburing.h>
+#endif
+
 //------------------------------------------------------------------------------
 
 extern
@@ -38,6 +60,20 @@ extern
 std::unique_ptr<channel_list>
 make_channel_list(server&);
 
+extern
+std::unique_ptr<file_cache>
+make_file_cache(
+    server&,
+    std::size_t max_bytes,
+    std::size_t threads);
+
+extern
+std::unique_ptr<rpc_pool>
+make_rpc_pool(
+    server&,
+    std::size_t threads,
+    std::size_t max_pending);
+
 extern
 void
 make_system_channel(server&);
@@ -68,6 +104,17 @@ listener_config(json::value&& jv)
     , address(json::value_cast<net::ip::address>(jv.at("address")))
     , port_num(json::number_cast<unsigned short>(jv.at("port_num")))
 {
+    auto& obj = jv.as_object();
+    auto it = obj.find("acceptors");
+    if(it != obj.end())
+        acceptors = json::number_cast<unsigned>(it->value());
+    if(acceptors < 1)
+        acceptors = 1;
+    it = obj.find("accept-batch");
+    if(it != obj.end())
+        accept_batch = json::number_cast<unsigned>(it->value());
+    if(accept_batch < 1)
+        accept_batch = 1;
 }
 
 //------------------------------------------------------------------------------
@@ -79,6 +126,33 @@ struct server_config
     unsigned num_threads = 1;
     json::string doc_root;
 
+    // When true, each thread runs its own io_context
+    bool per_core = false;
+
+    // When true, io_uring was requested instead of epoll
+    bool io_uring = false;
+
+    // Upper limit on the bytes held by the static file cache
+    std::size_t file_cache_size = 16 * 1024 * 1024;
+
+    // Threads which perform blocking reads of static files
+    unsigned file_io_threads = 2;
+
+    // Threads which run RPC methods marked async, and
+    // the most requests which may wait for them
+    unsigned rpc_threads = 2;
+    std::size_t rpc_max_pending = 1024;
+
+    // Limits on the outgoing queue of each WebSocket session
+    ::send_limits send_limits;
+
+    // How each WebSocket session reads its messages
+    ::read_options read_options;
+
+    // When true, permessage-deflate is offered to clients
+    bool deflate = false;
+    deflate_options deflate_opt;
+
     server_config() = default;
 
     explicit
@@ -88,9 +162,216 @@ struct server_config
     {
         if( num_threads < 1)
             num_threads = 1;
+
+        auto& obj = jv.as_object();
+        auto it = obj.find("execution");
+        if(it != obj.end())
+        {
+            auto const& s = it->value().as_string();
+            if(s == "per-core")
+                per_core = true;
+            else if(s != "shared")
+                BOOST_THROW_EXCEPTION(beast::system_error(
+                    boost::system::errc::make_error_code(
+                        boost::system::errc::invalid_argument)));
+        }
+
+        it = obj.find("io-backend");
+        if(it != obj.end())
+        {
+            auto const& s = it->value().as_string();
+            if(s == "io_uring")
+                io_uring = true;
+            else if(s != "epoll")
+                BOOST_THROW_EXCEPTION(beast::system_error(
+                    boost::system::errc::make_error_code(
+                        boost::system::errc::invalid_argument)));
+        }
+
+        it = obj.find("file-cache-size");
+        if(it != obj.end())
+            file_cache_size = json::number_cast<
+                std::size_t>(it->value());
+
+        it = obj.find("file-io-threads");
+        if(it != obj.end())
+            file_io_threads = json::number_cast<
+                unsigned>(it->value());
+
+        it = obj.find("rpc-pool");
+        if(it != obj.end())
+        {
+            auto& rp = it->value().as_object();
+            auto it2 = rp.find("threads");
+            if(it2 != rp.end())
+                rpc_threads = json::number_cast<
+                    unsigned>(it2->value());
+            it2 = rp.find("max-pending");
+            if(it2 != rp.end())
+                rpc_max_pending = json::number_cast<
+                    std::size_t>(it2->value());
+        }
+
+        it = obj.find("send-queue");
+        if(it != obj.end())
+        {
+            auto& sq = it->value().as_object();
+            auto it2 = sq.find("max-messages");
+            if(it2 != sq.end())
+                send_limits.max_messages = json::number_cast<
+                    std::size_t>(it2->value());
+            it2 = sq.find("max-bytes");
+            if(it2 != sq.end())
+                send_limits.max_bytes = json::number_cast<
+                    std::size_t>(it2->value());
+            it2 = sq.find("overflow");
+            if(it2 != sq.end())
+            {
+                auto const& s = it2->value().as_string();
+                if(s == "drop-oldest")
+                    send_limits.policy = overflow_policy::drop_oldest;
+                else if(s == "coalesce")
+                    send_limits.policy = overflow_policy::coalesce;
+                else if(s == "disconnect")
+                    send_limits.policy = overflow_policy::disconnect;
+                else
+                    BOOST_THROW_EXCEPTION(beast::system_error(
+                        boost::system::errc::make_error_code(
+                            boost::system::errc::invalid_argument)));
+            }
+            if(send_limits.max_messages < 1)
+                send_limits.max_messages = 1;
+        }
+
+        it = obj.find("websocket");
+        if(it != obj.end())
+        {
+            auto& ws = it->value().as_object();
+            auto it2 = ws.find("message-max");
+            if(it2 != ws.end())
+                read_options.message_max = json::number_cast<
+                    std::size_t>(it2->value());
+            it2 = ws.find("incremental-parse");
+            if(it2 != ws.end())
+                read_options.incremental = it2->value().as_bool();
+            it2 = ws.find("read-size");
+            if(it2 != ws.end())
+                read_options.read_size = json::number_cast<
+                    std::size_t>(it2->value());
+            if(read_options.read_size < 1)
+                read_options.read_size = 1;
+        }
+
+        it = obj.find("deflate");
+        if(it != obj.end())
+        {
+            auto& d = it->value().as_object();
+            auto it2 = d.find("enable");
+            if(it2 != d.end())
+                deflate = it2->value().as_bool();
+            it2 = d.find("level");
+            if(it2 != d.end())
+                deflate_opt.level = json::number_cast<
+                    int>(it2->value());
+            it2 = d.find("min-size");
+            if(it2 != d.end())
+                deflate_opt.min_size = json::number_cast<
+                    std::size_t>(it2->value());
+            it2 = d.find("pool-size");
+            if(it2 != d.end())
+                deflate_opt.max_idle = json::number_cast<
+                    std::size_t>(it2->value());
+            if( deflate_opt.level < 1 ||
+                deflate_opt.level > 9)
+                BOOST_THROW_EXCEPTION(beast::system_error(
+                    boost::system::errc::make_error_code(
+                        boost::system::errc::invalid_argument)));
+        }
     }
 };
 
+#ifdef __linux__
+// Set by the io_uring executable when it hands off to
+// epoll, so the epoll executable does not hand it back.
+char const* const io_uring_unavailable =
+    "LOUNGE_IO_URING_UNAVAILABLE";
+
+// Replace this process with the named executable from
+// the same directory. Returns only if that fails.
+void
+exec_sibling(
+    char const* name,
+    char const* config_path,
+    logger& log)
+{
+    char buf[PATH_MAX];
+    auto const n = ::readlink(
+        "/proc/self/exe", buf, sizeof(buf) - 1);
+    if(n < 0)
+        return;
+    std::string path(buf, static_cast<std::size_t>(n));
+    path.resize(path.rfind('/') + 1);
+    path.append(name);
+    if(::access(path.c_str(), X_OK) != 0)
+        return;
+    char* argv[] = {
+        &path[0], const_cast<char*>(config_path), nullptr };
+    ::execv(path.c_str(), argv);
+    log.cerr() <<
+        "io-backend: " << path << ": " <<
+        std::strerror(errno) << "\n";
+}
+#endif
+
+// Asio selects its reactor at compile time, so a build
+// with LOUNGE_IO_URING produces two executables:
+// lounge-server using epoll, and lounge-server-uring.
+// Each hands off to the other at startup when the
+// configuration or the running kernel calls for it.
+// Returns false if no backend can be used.
+bool
+select_io_backend(
+    server_config const& cfg,
+    char const* config_path,
+    logger& log)
+{
+#ifdef LOUNGE_IO_URING
+    if(! cfg.io_uring)
+    {
+        exec_sibling("lounge-server", config_path, log);
+        log.cerr() <<
+            "io-backend: lounge-server not found, using io_uring\n";
+        return true;
+    }
+    // The io_context cannot be created without kernel support
+    io_uring ring;
+    if(::io_uring_queue_init(2, &ring, 0) < 0)
+    {
+        log.cerr() <<
+            "io-backend: io_uring is unavailable, using epoll\n";
+        ::setenv(io_uring_unavailable, "1", 1);
+        exec_sibling("lounge-server", config_path, log);
+        log.cerr() <<
+            "io-backend: lounge-server not found\n";
+        return false;
+    }
+    ::io_uring_queue_exit(&ring);
+#else
+    if(cfg.io_uring)
+    {
+    #ifdef __linux__
+        if(! std::getenv(io_uring_unavailable))
+            exec_sibling("lounge-server-uring", config_path, log);
+    #else
+        boost::ignore_unused(config_path);
+    #endif
+        log.cerr() <<
+            "io-backend: io_uring is unavailable, using epoll\n";
+    }
+#endif
+    return true;
+}
+
 //------------------------------------------------------------------------------
 
 json::value
@@ -152,10 +433,88 @@ parse_file(
 
 //------------------------------------------------------------------------------
 
+// The index of the shard run by the calling thread,
+// or no_shard if the thread is not an I/O thread.
+std::size_t constexpr no_shard = std::size_t(-1);
+thread_local std::size_t this_shard = no_shard;
+
+// Maximum letters queued from one shard to another
+std::size_t constexpr mailbox_capacity = 1024;
+
+// One io_context and its incoming mailboxes
+struct shard
+{
+    // A message waiting for delivery to a user
+    struct letter
+    {
+        boost::shared_ptr<user> u;
+        message m;
+    };
+
+    using queue_type =
+        boost::lockfree::spsc_queue<letter>;
+
+    net::io_context ioc;
+
+    // inbox[i] holds letters produced by shard i
+    std::vector<std::unique_ptr<queue_type>> inbox;
+
+    // true when a drain has been posted
+    std::atomic<bool> pending;
+
+    // A per-core shard is run by a single thread, so the
+    // hint of 1 tells the scheduler that only one thread
+    // runs handlers. The io_context still locks, since
+    // other shards post into it through forward(), which
+    // rules out BOOST_ASIO_CONCURRENCY_HINT_UNSAFE.
+    explicit
+    shard(std::size_t n)
+        : ioc(n > 1 ? 1 : BOOST_ASIO_CONCURRENCY_HINT_DEFAULT)
+        , pending(false)
+    {
+        if(n == 1)
+            return;
+        inbox.reserve(n);
+        while(inbox.size() < n)
+            inbox.emplace_back(
+                boost::make_unique<queue_type>(
+                    mailbox_capacity));
+    }
+
+    // Deliver everything in our mailboxes.
+    // Only called from our own thread.
+    void
+    drain()
+    {
+        // Clear the flag first, so a producer which pushes
+        // after we pass its queue will post another drain.
+        pending.store(false);
+        auto const f =
+            [](letter& e)
+            {
+                e.u->deliver(std::move(e.m));
+            };
+        for(auto& q : inbox)
+            q->consume_all(f);
+    }
+};
+
 class server_impl_base : public server
 {
 public:
-    net::io_context ioc_;
+    // Exactly one shard, unless running per-core
+    std::vector<std::unique_ptr<shard>> shards_;
+    std::atomic<std::size_t> next_shard_;
+
+    explicit
+    server_impl_base(std::size_t num_shards)
+        : next_shard_(0)
+    {
+        shards_.reserve(num_shards);
+        while(shards_.size() < num_shards)
+            shards_.emplace_back(
+                boost::make_unique<shard>(num_shards));
+    }
 
     // This function is in a base class because `server_impl`
     // needs to call it from the ctor-initializer list, which
@@ -169,10 +528,69 @@ public:
         return net::make_strand(
             net::system_executor{});
     #else
+        // Distribute new strands across the
+        // shards, pinning each to one thread.
+        auto const i = shards_.size() == 1 ? 0 :
+            next_shard_++ % shards_.size();
         return net::make_strand(
-            ioc_.get_executor());
+            shards_[i]->ioc.get_executor());
     #endif
     }
+
+    std::size_t
+    shard_of(executor_type const& ex) const noexcept override
+    {
+    #ifndef LOUNGE_USE_SYSTEM_EXECUTOR
+        auto const ctx = &ex.get_inner_executor().context();
+        for(std::size_t i = 0; i < shards_.size(); ++i)
+            if(&shards_[i]->ioc == ctx)
+                return i;
+    #else
+        boost::ignore_unused(ex);
+    #endif
+        return 0;
+    }
+
+    bool
+    forward(user& u, message const& m) override
+    {
+        if(shards_.size() == 1)
+            return false;
+
+        // Only I/O threads may produce, and messages
+        // to our own shard need no mailbox.
+        auto const from = this_shard;
+        auto const to = u.shard();
+        if(from == no_shard || from == to)
+            return false;
+
+        // A full mailbox means the owning shard is far
+        // behind. Delivering around the mailbox would let
+        // the message overtake the letters already queued,
+        // so the overflow policy of the send queues applies:
+        // the message is dropped, and when the policy is to
+        // disconnect the user is stopped as well.
+        auto& sh = *shards_[to];
+        if(! sh.inbox[from]->push(
+                shard::letter{boost::shared_from(&u), m}))
+        {
+            if(send_limits().policy ==
+                    overflow_policy::disconnect)
+                u.on_stop();
+            return true;
+        }
+
+        // Only the push which finds the
+        // mailbox idle schedules a drain.
+        if(! sh.pending.exchange(true))
+            net::post(
+                sh.ioc.get_executor(),
+                [&sh]
+                {
+                    sh.drain();
+                });
+        return true;
+    }
 };
 
 class server_impl
@@ -196,6 +614,9 @@ class server_impl
     std::atomic<bool> stop_;
 
     std::unique_ptr<::channel_list> channel_list_;
+    ::file_cache* file_cache_;
+    ::rpc_pool* rpc_pool_;
+    std::unique_ptr<::deflate_pool> deflate_pool_;
 
     static
     std::chrono::steady_clock::time_point
@@ -209,7 +630,8 @@ public:
     server_impl(
         server_config cfg,
         std::unique_ptr<logger> log)
-        : cfg_(std::move(cfg))
+        : server_impl_base(cfg.per_core ? cfg.num_threads : 1)
+        , cfg_(std::move(cfg))
         , log_(std::move(log))
         , timer_(this->make_executor())
         , signals_(
@@ -222,6 +644,22 @@ public:
     {
         timer_.expires_at(never());
 
+        if(cfg_.deflate)
+            deflate_pool_ = boost::make_unique<
+                ::deflate_pool>(cfg_.deflate_opt);
+
+        // The cache is owned by the list of services
+        auto fc = make_file_cache(*this,
+            cfg_.file_cache_size, cfg_.file_io_threads);
+        file_cache_ = fc.get();
+        insert(std::move(fc));
+
+        // So is the RPC pool
+        auto rp = make_rpc_pool(*this,
+            cfg_.rpc_threads, cfg_.rpc_max_pending);
+        rpc_pool_ = rp.get();
+        insert(std::move(rp));
+
         make_system_channel(*this);
     }
 
@@ -260,12 +698,34 @@ public:
 
     #ifndef LOUNGE_USE_SYSTEM_EXECUTOR
         std::vector<std::thread> vt;
-        while(vt.size() < cfg_.num_threads)
-            vt.emplace_back(
-                [this]
-                {
-                    this->ioc_.run();
-                });
+        std::vector<net::executor_work_guard<
+            net::io_context::executor_type>> work;
+        if(shards_.size() == 1)
+        {
+            while(vt.size() < cfg_.num_threads)
+                vt.emplace_back(
+                    [this]
+                    {
+                        this->shards_[0]->ioc.run();
+                    });
+        }
+        else
+        {
+            // One thread per shard. An idle shard must
+            // not return from run() before it is given
+            // its first session, so hold work on each.
+            for(std::size_t i = 0; i < shards_.size(); ++i)
+            {
+                work.emplace_back(
+                    shards_[i]->ioc.get_executor());
+                vt.emplace_back(
+                    [this, i]
+                    {
+                        this_shard = i;
+                        this->shards_[i]->ioc.run();
+                    });
+            }
+        }
     #endif
         // Block the main thread until stop() is called
         {
@@ -281,6 +741,12 @@ public:
         // services must be kept alive until after
         // all executor threads are joined.
 
+    #ifndef LOUNGE_USE_SYSTEM_EXECUTOR
+        // Let idle shards finish
+        for(auto& w : work)
+            w.reset();
+    #endif
+
         // If we get here, then the server has
         // stopped, so join the threads before
         // destroying them.
@@ -425,6 +891,24 @@ public:
         return cfg_.doc_root;
     }
 
+    ::send_limits const&
+    send_limits() const override
+    {
+        return cfg_.send_limits;
+    }
+
+    ::read_options const&
+    read_options() const override
+    {
+        return cfg_.read_options;
+    }
+
+    ::deflate_pool*
+    deflate_pool() override
+    {
+        return deflate_pool_.get();
+    }
+
     logger&
     log() noexcept override
     {
@@ -436,6 +920,18 @@ public:
     {
         return *channel_list_;
     }
+
+    ::file_cache&
+    file_cache() override
+    {
+        return *file_cache_;
+    }
+
+    ::rpc_pool&
+    rpc_pool() override
+    {
+        return *rpc_pool_;
+    }
 };
 
 } // (anon)
@@ -491,6 +987,8 @@ make_server(
         {
             auto& jo = jv.get_object()["server"];
             server_config cfg(std::move(jo));
+            if(! select_io_backend(cfg, config_path, *log))
+                return nullptr;
 
             // Create the server
             srv = boost::make_unique<server_impl>(
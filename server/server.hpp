@@ -20,10 +20,36 @@
 #include <utility>
 
 class channel_list;
+class deflate_pool;
+class file_cache;
 class logger;
+class message;
 class rpc_handler;
+class rpc_pool;
 class service;
 class user;
+struct send_limits;
+
+//------------------------------------------------------------------------------
+
+/// Settings for reading WebSocket messages
+struct read_options
+{
+    /// The largest incoming message
+    std::size_t message_max = 64 * 1024;
+
+    /** When true, JSON messages are parsed as they arrive.
+
+        A message which does not arrive in one read is fed
+        to the parser piece by piece, so the read buffer never
+        holds more than `read_size` bytes of it. MessagePack
+        messages are still read whole.
+    */
+    bool incremental = false;
+
+    /// The most bytes read at once when parsing incrementally
+    std::size_t read_size = 4096;
+};
 
 //------------------------------------------------------------------------------
 
@@ -40,6 +66,33 @@ public:
     executor_type
     make_executor() = 0;
 
+    /** Return the index of the I/O shard which runs an executor.
+
+        In per-core execution mode each shard is an
+        `io_context` run by exactly one thread. Otherwise
+        there is a single shard and this returns zero.
+    */
+    virtual
+    std::size_t
+    shard_of(executor_type const& ex) const noexcept = 0;
+
+    /** Hand a message to a user owned by another shard.
+
+        In per-core execution mode, when called from a shard
+        thread other than the one owning the user, the message
+        is pushed to a single-producer, single-consumer mailbox
+        which the owning thread drains, instead of posting to
+        the user's strand from a foreign thread. When the
+        mailbox is full the message is dropped, and the user
+        is stopped if the overflow policy is to disconnect.
+
+        @returns `false` if the caller should deliver the
+        message through the user's executor instead.
+    */
+    virtual
+    bool
+    forward(user& u, message const& m) = 0;
+
     /** Add a service to the server.
 
         Services may only be added before calling start().
@@ -56,9 +109,22 @@ public:
     //--------------------------------------------------------------------------
 
     virtual beast::string_view  doc_root() const = 0;
+    virtual ::send_limits const& send_limits() const = 0;
+    virtual ::read_options const& read_options() const = 0;
+
+    /** Return the pool used to compress outgoing messages.
+
+        This returns `nullptr` if WebSocket compression
+        is disabled.
+    */
+    virtual ::deflate_pool* deflate_pool() = 0;
 
     virtual logger&             log() = 0;
     virtual ::channel_list&     channel_list() = 0;
+    virtual ::file_cache&       file_cache() = 0;
+
+    /// Return the pool which runs methods marked `async`
+    virtual ::rpc_pool&         rpc_pool() = 0;
 
     //--------------------------------------------------------------------------
 
@@ -0,0 +1,122 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_SHARDED_SET_HPP
+#define LOUNGE_SHARDED_SET_HPP
+
+#include "config.hpp"
+#include "member_set.hpp"
+#include <boost/align/aligned_allocator.hpp>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+/** A thread-safe set of pointers split into independently locked shards.
+
+    Each pointer is assigned to a shard by its address, so
+    concurrent inserts and erases of different elements
+    rarely contend on the same mutex. Insert and erase are
+    constant time.
+*/
+template<class T>
+class sharded_set
+{
+    // Each shard starts its own cache line, so
+    // neighboring mutexes never share one.
+    struct alignas(64) shard
+    {
+        mutable std::mutex mutex;
+        dense_set<T> set;
+    };
+
+    // The default allocator only honors the
+    // alignment of over-aligned types since C++17.
+    std::size_t n_;
+    std::vector<shard,
+        boost::alignment::aligned_allocator<shard>> v_;
+
+    shard&
+    get(T const* p) noexcept
+    {
+        // Skip the low bits, which are mostly
+        // zero due to allocation alignment.
+        return v_[(reinterpret_cast<
+            std::uintptr_t>(p) >> 6) % n_];
+    }
+
+public:
+    using value_type = T*;
+
+    /// Construct the set with the given number of shards
+    explicit
+    sharded_set(std::size_t shards = 64)
+        : n_(shards > 0 ? shards : 1)
+        , v_(n_)
+    {
+    }
+
+    /// Returns the number of elements
+    std::size_t
+    size() const
+    {
+        std::size_t n = 0;
+        for(std::size_t i = 0; i < n_; ++i)
+        {
+            std::lock_guard<std::mutex> lock(v_[i].mutex);
+            n += v_[i].set.size();
+        }
+        return n;
+    }
+
+    /** Insert an element.
+
+        @returns `false` if the element already exists.
+    */
+    bool
+    insert(T* p)
+    {
+        auto& s = get(p);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        return s.set.insert(p);
+    }
+
+    /** Erase an element.
+
+        @returns `false` if the element was not found.
+    */
+    bool
+    erase(T* p)
+    {
+        auto& s = get(p);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        return s.set.erase(p);
+    }
+
+    /** Remove every element, invoking f(T*) on each.
+
+        Each shard is locked while its elements are
+        visited and removed, so the function must not
+        insert or erase elements of this set.
+    */
+    template<class Function>
+    void
+    extract(Function&& f)
+    {
+        for(std::size_t i = 0; i < n_; ++i)
+        {
+            std::lock_guard<std::mutex> lock(v_[i].mutex);
+            for(auto p : v_[i].set)
+                f(p);
+            v_[i].set.clear();
+        }
+    }
+};
+
+#endif
@@ -8,27 +8,83 @@
 //
 
 #include "rpc.hpp"
+#include "rpc_params.hpp"
+#include "rpc_pool.hpp"
 #include "channel.hpp"
 #include "channel_list.hpp"
+#include "send_queue.hpp"
 #include "server.hpp"
 #include "user.hpp"
 #include <boost/make_shared.hpp>
+#include <boost/smart_ptr/weak_ptr.hpp>
+#include <algorithm>
+#include <utility>
+#include <vector>
 
 //------------------------------------------------------------------------------
 
 namespace {
 
+struct identify_params
+{
+    beast::string_view name;
+};
+
+using identify_param = rpc_param<identify_params>;
+
+constexpr identify_param identify_schema[] = {
+    { "name", &identify_param::member<
+        beast::string_view, &identify_params::name> },
+};
+
+struct methods_params
+{
+    std::uint64_t channel;
+};
+
+using methods_param = rpc_param<methods_params>;
+
+constexpr methods_param methods_schema[] = {
+    { "channel", &methods_param::member<
+        std::uint64_t, &methods_params::channel> },
+};
+
+static_assert(rpc_params_unique(identify_schema),
+    "two params have the same hash");
+static_assert(rpc_params_unique(methods_schema),
+    "two params have the same hash");
+
 class system_channel : public channel
 {
+    using handler = beast::error_code (system_channel::*)(rpc_call&);
+
     server& srv_;
 
+    static
+    rpc_method_table<handler>&
+    methods()
+    {
+        static constexpr rpc_method<handler> list[] = {
+            { "identify", &system_channel::do_identify },
+            { "shutdown", &system_channel::do_shutdown, false },
+            { "stop",     &system_channel::do_stop,     false },
+            { "queues",   &system_channel::do_queues,   false, true },
+            { "methods",  &system_channel::do_methods },
+        };
+        static_assert(rpc_methods_unique(list),
+            "two methods have the same hash");
+        static rpc_method_table<handler> tab(list);
+        return tab;
+    }
+
 public:
     explicit
     system_channel(server& srv)
         :  channel(
             1,
             "System",
-            srv.channel_list())
+            srv.channel_list(),
+            membership::dense)
         , srv_(srv)
     {
     }
@@ -44,44 +100,51 @@ protected:
     {
     }
 
-    void
+    beast::error_code
     on_dispatch(
         rpc_call& rpc) override
     {
-        if(rpc.method == "identify")
-        {
-            do_identify(rpc);
-        }
-        else if(rpc.method == "shutdown")
-        {
-            do_shutdown(rpc);
-        }
-        else if(rpc.method == "stop")
-        {
-            do_stop(rpc);
-        }
-        else
-        {
-            rpc.fail(rpc_code::method_not_found);
-        }
+        auto const m = methods().call(
+            {rpc.method.data(), rpc.method.size()});
+        if(! m)
+            return rpc_code::method_not_found;
+        return invoke(*m, rpc);
+    }
+
+    bool
+    on_needs_params(beast::string_view method) const override
+    {
+        auto const m = methods().find(method);
+        return m && m->needs_params;
     }
 
     void
+    on_get_methods(json::array& arr) const override
+    {
+        methods().to_json(arr);
+    }
+
+    beast::error_code
     do_identify(rpc_call& rpc)
     {
-        auto const& name =
-            checked_string(rpc.params, "name");
-        if(name.size() > 20)
-            rpc.fail("Invalid \"name\": too long");
+        identify_params p;
+        auto const ec = rpc_bind(
+            identify_schema, rpc.params, p);
+        if(ec)
+            return ec;
+        auto const s = p.name;
+        if(s.size() > 20)
+            return rpc_code::name_too_long;
         if(! rpc.u->name.empty())
-            rpc.fail("Identity is already set");
+            return rpc_code::identity_already_set;
         // VFALCO NOT THREAD SAFE!
-        rpc.u->name.assign(name.data(), name.size());
+        rpc.u->name.assign(s.data(), s.size());
         insert(*rpc.u);
         rpc.complete();
+        return {};
     }
 
-    void
+    beast::error_code
     do_shutdown(rpc_call& rpc)
     {
         // TODO check user perms
@@ -89,15 +152,83 @@ protected:
         srv_.shutdown(
             std::chrono::seconds(30));
         rpc.complete();
+        return {};
     }
 
-    void
+    beast::error_code
     do_stop(rpc_call& rpc)
     {
         // TODO check user perms
         boost::ignore_unused(rpc);
         srv_.stop();
         rpc.complete();
+        return {};
+    }
+
+    // Report the users with the most bytes waiting
+    // to be sent, to help find slow consumers. This
+    // visits every user, so it runs on the RPC pool.
+    beast::error_code
+    do_queues(rpc_call& rpc)
+    {
+        // TODO check user perms
+        std::vector<boost::weak_ptr<user>> v;
+        for_each_user(
+            [&v](user* p)
+            {
+                v.emplace_back(boost::weak_from(p));
+            });
+
+        std::vector<std::pair<
+            send_queue_stats,
+            boost::shared_ptr<user>>> top;
+        top.reserve(v.size());
+        for(auto const& wp : v)
+            if(auto sp = wp.lock())
+                top.emplace_back(sp->queue_stats(), std::move(sp));
+        auto const n = (std::min)(top.size(), std::size_t(20));
+        std::partial_sort(
+            top.begin(), top.begin() + n, top.end(),
+            []( std::pair<send_queue_stats,
+                    boost::shared_ptr<user>> const& lhs,
+                std::pair<send_queue_stats,
+                    boost::shared_ptr<user>> const& rhs)
+            {
+                return lhs.first.bytes > rhs.first.bytes;
+            });
+
+        auto& arr = rpc.result.emplace_array();
+        for(std::size_t i = 0; i < n; ++i)
+        {
+            auto const& st = top[i].first;
+            json::value jv(json::object_kind);
+            auto& obj = jv.get_object();
+            obj["user"] = top[i].second->name;
+            obj["messages"] = st.messages;
+            obj["bytes"] = st.bytes;
+            obj["peak-bytes"] = st.peak_bytes;
+            obj["dropped"] = st.dropped;
+            arr.emplace_back(std::move(jv));
+        }
+        rpc.complete();
+        return {};
+    }
+
+    // Report the calls to each method of a channel
+    beast::error_code
+    do_methods(rpc_call& rpc)
+    {
+        methods_params p;
+        auto const ec = rpc_bind(
+            methods_schema, rpc.params, p);
+        if(ec)
+            return ec;
+        auto c = srv_.channel_list().at(p.channel);
+        if(! c)
+            return rpc_code::unknown_cid;
+        c->get_methods(rpc.result.emplace_array());
+        rpc.complete();
+        return {};
     }
 };
 
@@ -13,6 +13,7 @@
 #include "config.hpp"
 #include "session.hpp"
 #include "utility.hpp"
+#include "wire_format.hpp"
 #include <boost/json/value.hpp>
 #include <boost/container/flat_set.hpp>
 #include <mutex>
@@ -20,6 +21,7 @@
 
 class channel;
 class message;
+struct send_queue_stats;
 
 /// Represents a connected user
 class user : public session
@@ -27,6 +29,10 @@ class user : public session
     std::mutex mutex_;
     boost::container::flat_set<channel*> channels_;
 
+protected:
+    std::size_t shard_ = 0;
+    wire_format format_ = wire_format::json;
+
 public:
     std::string name;
 
@@ -51,6 +57,42 @@ public:
     virtual
     void
     send(message m) = 0;
+
+    /** Send a message from the thread owning the user.
+
+        This is called by the per-core mailboxes. It must
+        only be invoked from the thread running the shard
+        which owns the user.
+    */
+    virtual
+    void
+    deliver(message m) = 0;
+
+    /** Return the counters of the outgoing queue.
+
+        May be called from any thread.
+    */
+    virtual
+    send_queue_stats
+    queue_stats() const = 0;
+
+    /// Return the index of the I/O shard owning the user
+    std::size_t
+    shard() const noexcept
+    {
+        return shard_;
+    }
+
+    /** Return the encoding the user's client speaks.
+
+        A message built by @ref make_message for this
+        format may be passed to @ref send.
+    */
+    wire_format
+    format() const noexcept
+    {
+        return format_;
+    }
 };
 
 #endif
@@ -0,0 +1,79 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_WIRE_FORMAT_HPP
+#define LOUNGE_WIRE_FORMAT_HPP
+
+#include "config.hpp"
+#include <boost/beast/core/string.hpp>
+
+/// The encoding of messages on a WebSocket connection
+enum class wire_format
+{
+    /// JSON text frames, the default
+    json,
+
+    /// MessagePack binary frames
+    msgpack
+};
+
+/// The subprotocol a client offers to use JSON
+static char constexpr json_subprotocol[] = "lounge.json";
+
+/// The subprotocol a client offers to use MessagePack
+static char constexpr msgpack_subprotocol[] = "lounge.msgpack";
+
+/** Choose a wire format from a client's offered subprotocols.
+
+    MessagePack is preferred when offered. A client which
+    offers no subprotocol, or none of ours, gets JSON.
+
+    @param offered The value of the Sec-WebSocket-Protocol
+    field in the upgrade request.
+
+    @param format Set to the chosen format.
+
+    @returns The subprotocol to put in the response, or an
+    empty string if the response must not name one.
+*/
+inline
+beast::string_view
+select_wire_format(
+    beast::string_view offered,
+    wire_format& format)
+{
+    bool has_json = false;
+    format = wire_format::json;
+    while(! offered.empty())
+    {
+        auto pos = offered.find(',');
+        auto item = offered.substr(0, pos);
+        offered.remove_prefix(
+            pos == beast::string_view::npos ?
+                offered.size() : pos + 1);
+        while(! item.empty() &&
+                (item.front() == ' ' || item.front() == '\t'))
+            item.remove_prefix(1);
+        while(! item.empty() &&
+                (item.back() == ' ' || item.back() == '\t'))
+            item.remove_suffix(1);
+        if(item == msgpack_subprotocol)
+        {
+            format = wire_format::msgpack;
+            return msgpack_subprotocol;
+        }
+        if(item == json_subprotocol)
+            has_json = true;
+    }
+    if(has_json)
+        return json_subprotocol;
+    return {};
+}
+
+#endif
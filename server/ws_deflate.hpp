@@ -0,0 +1,144 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_WS_DEFLATE_HPP
+#define LOUNGE_WS_DEFLATE_HPP
+
+#include "config.hpp"
+#include <boost/beast/zlib/deflate_stream.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/assert.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// Settings for compressing outgoing WebSocket messages
+struct deflate_options
+{
+    /// The deflate compression level, from 1 to 9
+    int level = 6;
+
+    /// The deflate memory level, from 1 to 9
+    int mem_level = 8;
+
+    /// Payloads smaller than this are sent uncompressed
+    std::size_t min_size = 128;
+
+    /// The largest number of idle streams kept for reuse
+    std::size_t max_idle = 16;
+};
+
+/** A pool of deflate streams for permessage-deflate (RFC 7692).
+
+    Outgoing messages are compressed without context takeover,
+    so each one starts from a fresh state and the result is the
+    same for every recipient. A stream is borrowed only for the
+    duration of one message, instead of every connection holding
+    its own compressor between messages.
+
+    Thread safe.
+*/
+class deflate_pool
+{
+    using stream_type = beast::zlib::deflate_stream;
+
+    deflate_options opt_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<stream_type>> idle_;
+
+    std::unique_ptr<stream_type>
+    acquire()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if(! idle_.empty())
+            {
+                auto sp = std::move(idle_.back());
+                idle_.pop_back();
+                return sp;
+            }
+        }
+        std::unique_ptr<stream_type> sp(new stream_type);
+        sp->reset(opt_.level, 15, opt_.mem_level,
+            beast::zlib::Strategy::normal);
+        return sp;
+    }
+
+    void
+    release(std::unique_ptr<stream_type> sp)
+    {
+        // Keep the buffers, forget the history
+        sp->reset();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(idle_.size() < opt_.max_idle)
+            idle_.push_back(std::move(sp));
+    }
+
+public:
+    explicit
+    deflate_pool(deflate_options const& opt)
+        : opt_(opt)
+    {
+    }
+
+    /// Return the settings
+    deflate_options const&
+    options() const noexcept
+    {
+        return opt_;
+    }
+
+    /** Compress a message payload.
+
+        The compressed data is appended to `out` in the form
+        carried by a permessage-deflate frame: a sync flush
+        with the trailing four octets removed.
+
+        @returns `false` if the payload is below the minimum
+        size or would not shrink. Then `out` is unchanged.
+    */
+    bool
+    deflate(
+        net::const_buffer in,
+        std::string& out)
+    {
+        namespace zlib = beast::zlib;
+
+        if(in.size() < opt_.min_size)
+            return false;
+
+        auto sp = acquire();
+        auto const pos = out.size();
+        out.resize(pos + sp->upper_bound(in.size()) + 16);
+        zlib::z_params zs;
+        zs.next_in = in.data();
+        zs.avail_in = in.size();
+        zs.next_out = &out[pos];
+        zs.avail_out = out.size() - pos;
+        beast::error_code ec;
+        sp->write(zs, zlib::Flush::sync, ec);
+        BOOST_ASSERT(! ec);
+        BOOST_ASSERT(zs.avail_in == 0);
+        release(std::move(sp));
+
+        // The sync flush ends with 00 00 ff ff
+        BOOST_ASSERT(zs.total_out >= 4);
+        auto const n = zs.total_out - 4;
+        if(ec || n >= in.size())
+        {
+            out.resize(pos);
+            return false;
+        }
+        out.resize(pos + n);
+        return true;
+    }
+};
+
+#endif
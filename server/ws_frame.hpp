@@ -0,0 +1,215 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_WS_FRAME_HPP
+#define LOUNGE_WS_FRAME_HPP
+
+#include "config.hpp"
+#include <boost/beast/core/buffer_traits.hpp>
+#include <boost/beast/core/buffers_range.hpp>
+#include <boost/asio/buffer.hpp>
+#include <cstdint>
+#include <vector>
+
+/** The header of a complete, unmasked WebSocket frame.
+
+    Frames sent by a server are never masked, so a message
+    framed once is valid for every connection which has not
+    negotiated an extension.
+*/
+class ws_frame_header
+{
+    unsigned char buf_[10];
+    unsigned char size_;
+
+public:
+    /** Constructor
+
+        @param payload The size of the payload.
+
+        @param text `true` for a text frame, else binary.
+
+        @param compressed `true` if the payload is compressed
+        with permessage-deflate, which sets the RSV1 bit.
+    */
+    explicit
+    ws_frame_header(
+        std::uint64_t payload,
+        bool text = true,
+        bool compressed = false) noexcept
+    {
+        // FIN, RSV1 if compressed, opcode
+        buf_[0] = 0x80 | (compressed ? 0x40 : 0) |
+            (text ? 0x1 : 0x2);
+        if(payload < 126)
+        {
+            buf_[1] = static_cast<unsigned char>(payload);
+            size_ = 2;
+        }
+        else if(payload < 65536)
+        {
+            buf_[1] = 126;
+            buf_[2] = static_cast<unsigned char>(payload >> 8);
+            buf_[3] = static_cast<unsigned char>(payload);
+            size_ = 4;
+        }
+        else
+        {
+            buf_[1] = 127;
+            for(int i = 0; i < 8; ++i)
+                buf_[2 + i] = static_cast<unsigned char>(
+                    payload >> (56 - 8 * i));
+            size_ = 10;
+        }
+    }
+
+    /// Return the serialized header
+    net::const_buffer
+    buffer() const noexcept
+    {
+        return {buf_, size_};
+    }
+};
+
+namespace detail {
+
+// Return the frame a message was built with, if any
+template<class Message>
+auto
+prebuilt_frame(Message const& m, int) ->
+    decltype(net::const_buffer(m.frame()))
+{
+    return m.frame();
+}
+
+template<class Message>
+net::const_buffer
+prebuilt_frame(Message const&, long)
+{
+    return {};
+}
+
+struct default_frame
+{
+    template<class Message>
+    net::const_buffer
+    operator()(Message const& m) const
+    {
+        return prebuilt_frame(m, 0);
+    }
+};
+
+} // detail
+
+/** A gathered write of several complete WebSocket messages.
+
+    Each message is sent as a single text frame. Messages
+    which carry a pre-built frame, such as broadcasts, are
+    written as is. The object must outlive the write, and
+    the messages must remain valid until it completes.
+*/
+class ws_frame_batch
+{
+    std::vector<ws_frame_header> headers_;
+    std::vector<net::const_buffer> buffers_;
+    std::size_t bytes_ = 0;
+
+public:
+    /** Frame messages from a range of buffer sequences.
+
+        Messages are taken in order until the next one would
+        make the batch larger than `limit`. The first message
+        is always taken regardless of its size.
+
+        @returns The number of messages in the batch.
+    */
+    template<class FwdIt>
+    std::size_t
+    assign(
+        FwdIt first,
+        FwdIt last,
+        std::size_t limit)
+    {
+        return assign(first, last, limit,
+            detail::default_frame{});
+    }
+
+    /** Frame messages, choosing the frame of each message.
+
+        @param frame_of A function called with a message which
+        returns the complete frame to write, or an empty buffer
+        to frame the message here. It may be called more than
+        once for each message, and must return the same frame.
+    */
+    template<class FwdIt, class FrameOf>
+    std::size_t
+    assign(
+        FwdIt first,
+        FwdIt last,
+        std::size_t limit,
+        FrameOf const& frame_of)
+    {
+        headers_.clear();
+        buffers_.clear();
+        bytes_ = 0;
+        std::size_t n = 0;
+        for(auto it = first; it != last; ++it)
+        {
+            auto const frame = frame_of(*it);
+            if(frame.size() > 0)
+            {
+                if(n > 0 && bytes_ + frame.size() > limit)
+                    break;
+                bytes_ += frame.size();
+                ++n;
+                continue;
+            }
+            auto const size = beast::buffer_bytes(*it);
+            if(n > 0 && bytes_ + size + 10 > limit)
+                break;
+            headers_.emplace_back(size);
+            bytes_ += size + headers_.back().buffer().size();
+            ++n;
+        }
+
+        // The headers are in place, now refer to them
+        auto h = headers_.begin();
+        auto it = first;
+        for(std::size_t i = 0; i < n; ++i, ++it)
+        {
+            auto const frame = frame_of(*it);
+            if(frame.size() > 0)
+            {
+                buffers_.push_back(frame);
+                continue;
+            }
+            buffers_.push_back(h->buffer());
+            ++h;
+            for(auto b : beast::buffers_range_ref(*it))
+                buffers_.push_back(b);
+        }
+        return n;
+    }
+
+    /// Return the buffers to write
+    std::vector<net::const_buffer> const&
+    buffers() const noexcept
+    {
+        return buffers_;
+    }
+
+    /// Return the total size of the framed messages
+    std::size_t
+    size() const noexcept
+    {
+        return bytes_;
+    }
+};
+
+#endif
@@ -7,22 +7,33 @@
 // Official repository: https://github.com/vinniefalco/BeastLounge
 //
 
+#include "channel.hpp"
 #include "channel_list.hpp"
+#include "gated_stream.hpp"
 #include "listener.hpp"
 #include "logger.hpp"
 #include "message.hpp"
+#include "mpsc_queue.hpp"
+#include "msgpack.hpp"
 #include "rpc.hpp"
+#include "rpc_arena.hpp"
+#include "rpc_scan.hpp"
+#include "send_queue.hpp"
 #include "server.hpp"
 #include "user.hpp"
+#include "wire_format.hpp"
+#include "ws_deflate.hpp"
+#include "ws_frame.hpp"
 #include <boost/beast/websocket/stream.hpp>
 #include <boost/beast/core/stream_traits.hpp>
 #include <boost/beast/ssl/ssl_stream.hpp>
 #include <boost/json/parser.hpp>
 #include <boost/asio/coroutine.hpp>
 #include <boost/asio/ip/tcp.hpp>
-#include <boost/asio/dispatch.hpp>
 #include <boost/asio/post.hpp>
+#include <atomic>
 #include <iostream>
+#include <memory>
 #include <vector>
 
 //------------------------------------------------------------------------------
@@ -40,7 +51,36 @@ protected:
     section& log_;
     endpoint_type ep_;
     flat_storage msg_;
-    std::vector<message> mq_;
+    boost::shared_ptr<rpc_arena> arena_;
+
+    // Parses a message which arrives in several reads
+    json::parser pr_;
+    bool parsing_ = false;
+    send_queue mq_;
+    ws_frame_batch wb_;
+
+    // Set when permessage-deflate is negotiated
+    deflate_pool* deflate_ = nullptr;
+
+    // Messages sent from other threads wait here
+    // until the strand drains them.
+    struct inbox_node : mpsc_node
+    {
+        message m;
+
+        explicit
+        inbox_node(message m_)
+            : m(std::move(m_))
+        {
+        }
+    };
+
+    mpsc_queue<inbox_node> inbox_;
+    std::atomic<std::size_t> inbox_size_{0};
+
+    // Upper limit on the bytes in one write, so a long
+    // queue does not hold up reads for too long.
+    static std::size_t constexpr write_limit = 64 * 1024;
 
 public:
     ws_session_base(
@@ -51,12 +91,15 @@ public:
         , lst_(lst)
         , log_(srv_.log().get_section("ws_session"))
         , ep_(ep)
+        , mq_(srv_.send_limits())
     {
         lst_.insert(this);
     }
 
     ~ws_session_base()
     {
+        while(auto p = inbox_.pop())
+            delete p;
         lst_.erase(this);
     }
 
@@ -76,13 +119,59 @@ public:
     void
     run(websocket::request_type req)
     {
+        // Remember which shard owns us
+        shard_ = srv_.shard_of(
+            impl()->ws().get_executor());
+
         // Apply settings to stream
         impl()->ws().set_option(
             websocket::stream_base::timeout::suggested(
                 beast::role_type::server));
 
         // Limit the maximum incoming message size
-        impl()->ws().read_message_max(64 * 1024);
+        impl()->ws().read_message_max(
+            srv_.read_options().message_max);
+
+        // Clients which offer our binary subprotocol
+        // get MessagePack instead of JSON text.
+        auto const protocol = select_wire_format(
+            req[http::field::sec_websocket_protocol],
+            format_);
+
+        if(srv_.deflate_pool())
+        {
+            // Neither side keeps history between messages,
+            // so outgoing messages are compressed once for all
+            // recipients, and the stream frees its inflate
+            // window when each incoming message ends.
+            websocket::permessage_deflate pmd;
+            pmd.server_enable = true;
+            pmd.server_no_context_takeover = true;
+            pmd.client_no_context_takeover = true;
+            impl()->ws().set_option(pmd);
+        }
+
+        impl()->ws().set_option(
+            websocket::stream_base::decorator(
+            [this, protocol](websocket::response_type& res)
+            {
+                if(! protocol.empty())
+                    res.set(
+                        http::field::sec_websocket_protocol,
+                        protocol);
+
+                // The stream compresses nothing it sends, we
+                // do. A client which limits the server's window
+                // cannot share frames compressed for everyone
+                // else, and gets them uncompressed, which is
+                // still allowed.
+                auto const ext = res[
+                    http::field::sec_websocket_extensions];
+                if( ext.starts_with("permessage-deflate") &&
+                    ext.find("server_max_window_bits") ==
+                        beast::string_view::npos)
+                    deflate_ = srv_.deflate_pool();
+            }));
 
         // TODO check credentials in `req`
 
@@ -105,39 +194,124 @@ public:
 
             for(;;)
             {
-                // Read the next message
-                yield impl()->ws().async_read(
-                    msg_, bind_front(impl()));
-
-                // Report any errors reading
-                if(ec)
-                    return fail(ec, "async_read");
-
-                // Parse the buffer into JSON
-                json::parser pr;
-                auto const cb = msg_.data();
-                json::value jv = json::parse(
-                    { static_cast<char const*>(
-                        cb.data()), cb.size() }, ec);
-                if(ec)
-                    return fail(ec, "parse-json");
+                // The request, and the reply built from it,
+                // are allocated in an arena reused per message
+                rpc_arena::recycle(arena_);
 
-                // Validate and extract the JSON-RPC request
-                rpc_call rpc(*this);
-                rpc.extract(std::move(jv), ec);
-                try
+                if(! srv_.read_options().incremental)
                 {
+                    // Read the next message
+                    yield impl()->ws().async_read(
+                        msg_, bind_front(impl()));
+
+                    // Report any errors reading
                     if(ec)
-                        rpc.fail(
-                            rpc_code::invalid_request,
-                            ec.message());
+                        return fail(ec, "async_read");
+                }
+                else
+                {
+                    // Read the next message a piece at a time.
+                    // One which fits in a single read is handled
+                    // as if it were read whole.
+                    parsing_ = false;
+                    for(;;)
+                    {
+                        yield impl()->ws().async_read_some(
+                            msg_,
+                            srv_.read_options().read_size,
+                            bind_front(impl()));
+
+                        // Report any errors reading
+                        if(ec)
+                            return fail(ec, "async_read_some");
+
+                        if(impl()->ws().is_message_done() &&
+                                ! parsing_)
+                            break;
+
+                        // MessagePack is decoded only when whole
+                        if(format_ == wire_format::msgpack)
+                        {
+                            if(impl()->ws().is_message_done())
+                                break;
+                            continue;
+                        }
+
+                        // Parse what arrived so far and
+                        // release it from the buffer
+                        if(! parsing_)
+                        {
+                            pr_.start(arena_->storage());
+                            parsing_ = true;
+                        }
+                        pr_.write(
+                            static_cast<char const*>(
+                                msg_.data().data()),
+                            msg_.size(),
+                            ec);
+                        msg_.clear();
+                        if(ec)
+                            return fail(ec, "parse-json");
+
+                        if(impl()->ws().is_message_done())
+                            break;
+                    }
+                }
 
-                    // Dispatch to the proper channel
-                    srv_.channel_list().dispatch(rpc);
+                auto const cb = msg_.data();
+                beast::string_view const s(
+                    static_cast<char const*>(
+                        cb.data()), cb.size());
+
+                // Find the channel before parsing, so a method
+                // which uses only the channel id skips the parse,
+                // and one which needs its params is parsed on the
+                // channel's strand when it has one.
+                rpc_route route;
+                boost::shared_ptr<channel> c;
+                if( format_ == wire_format::json &&
+                    ! parsing_ &&
+                    rpc_prescan(s, route) &&
+                    route.v2 &&
+                    route.has_method &&
+                    route.has_cid)
+                    c = srv_.channel_list().at(route.cid);
+
+                boost::optional<executor_type> ex;
+                if(c && ! c->needs_params(route.method))
+                {
+                    rpc_call rpc(*this, arena_);
+                    rpc.extract(route, ec);
+                    do_rpc(rpc, ec, c.get());
+                }
+                else if(c && (ex = c->get_executor()))
+                {
+                    parse_on(*ex, std::move(c), s, route.id);
                 }
-                catch(rpc_error const& e)
+                else
                 {
-                    rpc.complete(e);
+                    // Parse the buffer into JSON, unless
+                    // it was parsed as it arrived
+                    json::value jv =
+                        parsing_ ?
+                            finish_parse(ec) :
+                        format_ == wire_format::msgpack ?
+                            msgpack_decode(s, ec, arena_->storage()) :
+                            json::parse(s, ec, arena_->storage());
+                    if(ec)
+                        return fail(ec, "parse-json");
+
+                    if(jv.is_array())
+                    {
+                        do_batch(jv.get_array());
+                    }
+                    else
+                    {
+                        // Validate and extract the JSON-RPC request
+                        rpc_call rpc(*this, arena_);
+                        rpc.extract(std::move(jv), ec);
+                        do_rpc(rpc, ec, c.get());
+                    }
                 }
 
                 // Clear the buffer for the next message
@@ -147,6 +321,114 @@ public:
     #include <boost/asio/unyield.hpp>
     }
 
+    // Reply to a request which could not be extracted,
+    // or dispatch it to its channel if already known.
+    void
+    do_rpc(
+        rpc_call& rpc,
+        beast::error_code ec,
+        channel* c)
+    {
+        if(ec)
+            return rpc.complete(rpc_error(
+                rpc_code::invalid_request,
+                ec.message()));
+
+        // Handlers return their errors, but those written
+        // with the checked_* helpers may still throw.
+        try
+        {
+            ec = c ?
+                c->dispatch(rpc) :
+                srv_.channel_list().dispatch(rpc);
+            if(ec)
+                rpc.complete(ec);
+        }
+        catch(rpc_error const& e)
+        {
+            rpc.complete(e);
+        }
+    }
+
+    // Parse a request on the strand of the channel which
+    // runs its method, rather than holding up this one.
+    // The text was already checked by the prescan, which
+    // also found the id.
+    void
+    parse_on(
+        executor_type const& ex,
+        boost::shared_ptr<channel> c,
+        beast::string_view s,
+        beast::string_view id)
+    {
+        // The arena goes with the request, so
+        // the next message is given a new one.
+        auto const self = boost::shared_from(this);
+        auto const text = boost::make_shared<std::string>(
+            s.data(), s.size());
+        auto const id_text = boost::make_shared<std::string>(
+            id.data(), id.size());
+        auto const arena = arena_;
+        net::post(ex,
+            [self, c, text, id_text, arena]
+            {
+                beast::error_code ec;
+                auto jv = json::parse(
+                    *text, ec, arena->storage());
+                if(ec)
+                {
+                    beast::error_code ec2;
+                    json::value id;
+                    if(! id_text->empty())
+                        id = json::parse(*id_text, ec2);
+                    return self->send(rpc_error(
+                        rpc_code::parse_error,
+                        ec.message()).to_json(
+                            ec2 ? json::value(nullptr) :
+                                std::move(id)));
+                }
+                rpc_call rpc(*self, arena);
+                rpc.extract(std::move(jv), ec);
+                self->do_rpc(rpc, ec, c.get());
+            });
+    }
+
+    // Dispatch each request of a batch in order. The
+    // replies are sent together once all are complete.
+    void
+    do_batch(json::array& arr)
+    {
+        if(arr.empty())
+            return send(rpc_error(
+                rpc_code::invalid_request).to_json(
+                    json::value(nullptr)));
+
+        // Each request gets its own arena, since some
+        // complete on other threads while the rest are
+        // still being dispatched here.
+        auto const batch =
+            boost::make_shared<rpc_batch>(
+                *this, arena_, arr.size());
+        for(auto& jv : arr)
+        {
+            beast::error_code ec;
+            rpc_call rpc(*this,
+                boost::make_shared<rpc_arena>(), batch);
+            rpc.extract(std::move(jv), ec);
+            do_rpc(rpc, ec, nullptr);
+        }
+    }
+
+    // Return the value of a message parsed as it arrived
+    json::value
+    finish_parse(beast::error_code& ec)
+    {
+        pr_.finish(ec);
+        if(ec)
+            return nullptr;
+        return pr_.release();
+    }
+
     // Report a failure
     void
     fail(beast::error_code ec, char const* what)
@@ -190,18 +472,58 @@ public:
     void
     send(json::value const& jv) override
     {
-        send(make_message(jv));
+        send(make_message(jv, 0, format_));
     }
 
     void
     send(message m) override
     {
-        net::dispatch(
-            impl()->ws().get_executor(),
-            beast::bind_front_handler(
-                &ws_session_base::do_send,
-                boost::shared_from(this),
-                std::move(m)));
+        // In per-core mode, messages from other
+        // shards go through the owner's mailbox.
+        if(srv_.forward(*this, m))
+            return;
+
+        auto const ex = impl()->ws().get_executor();
+        if(ex.running_in_this_thread())
+            return do_send(std::move(m));
+
+        // Only the push which makes the inbox non-empty
+        // schedules a drain, so a burst of messages costs
+        // one completion on the strand instead of one each.
+        inbox_.push(new inbox_node(std::move(m)));
+        if(inbox_size_.fetch_add(1,
+                std::memory_order_acq_rel) == 0)
+            net::post(ex, beast::bind_front_handler(
+                &ws_session_base::do_drain,
+                boost::shared_from(this)));
+    }
+
+    void
+    do_drain()
+    {
+        std::size_t n = 0;
+        while(auto p = inbox_.pop())
+        {
+            std::unique_ptr<inbox_node> node(p);
+            ++n;
+            do_send(std::move(node->m));
+        }
+
+        // Run again if more arrived, or if a push
+        // was still linking its node into the inbox.
+        if(inbox_size_.fetch_sub(n,
+                std::memory_order_acq_rel) != n)
+            net::post(
+                impl()->ws().get_executor(),
+                beast::bind_front_handler(
+                    &ws_session_base::do_drain,
+                    boost::shared_from(this)));
+    }
+
+    void
+    deliver(message m) override
+    {
+        do_send(std::move(m));
     }
 
     void
@@ -210,37 +532,68 @@ public:
         if(! beast::get_lowest_layer(
             impl()->ws()).socket().is_open())
             return;
-        mq_.emplace_back(std::move(m));
-        if(mq_.size() == 1)
+        if(! mq_.push(std::move(m)))
+        {
+            // The client is not reading fast enough
+            LOG_INF(log_, "send queue full\t", ep_);
+            return do_stop();
+        }
+        if(mq_.busy() == 0)
             do_write();
     }
 
+    send_queue_stats
+    queue_stats() const override
+    {
+        return mq_.stats();
+    }
+
+    // Send everything queued, up to the write limit, as
+    // one gathered write of complete frames. Framing here
+    // rather than in the websocket stream lets a burst of
+    // messages go out in a single system call, and for TLS
+    // in as few records as possible. No extension is
+    // negotiated unless permessage-deflate, so the frames need
+    // no further processing. Broadcasts go out with the frame
+    // they were built with, compressed once if need be, instead
+    // of being framed again for each recipient.
     void
     do_write()
     {
         BOOST_ASSERT(! mq_.empty());
-        impl()->ws().async_write(
-            mq_.back(),
+
+        // Nothing may follow a close frame
+        if(! impl()->ws().is_open())
+            return mq_.clear();
+
+        if(deflate_)
+            mq_.begin_write(wb_.assign(
+                mq_.begin(), mq_.end(), write_limit,
+                [this](message const& m)
+                {
+                    return m.deflated_frame(*deflate_);
+                }));
+        else
+            mq_.begin_write(wb_.assign(
+                mq_.begin(), mq_.end(), write_limit));
+
+        // Writes to this layer are never partial, and never
+        // interleave with control frames from the stream.
+        impl()->ws().next_layer().async_write_some(
+            wb_.buffers(),
             beast::bind_front_handler(
                 &ws_session_base::on_write,
-                boost::shared_from(this),
-                mq_.size() - 1));
-
+                boost::shared_from(this)));
     }
 
     void
     on_write(
-        std::size_t idx,
         beast::error_code ec,
         std::size_t)
     {
-        BOOST_ASSERT(! mq_.empty());
         if(ec)
             return fail(ec, "on_write");
-        auto const last = mq_.size() - 1;
-        if(idx != last)
-            swap(mq_[idx], mq_[last]);
-        mq_.resize(last);
+        mq_.end_write();
         if(! mq_.empty())
             do_write();
     }
@@ -251,7 +604,8 @@ public:
 class plain_ws_session_impl
     : public ws_session_base<plain_ws_session_impl>
 {
-    websocket::stream<stream_type> ws_;
+    websocket::stream<
+        gated_stream<stream_type>> ws_;
 
 public:
     plain_ws_session_impl(
@@ -265,7 +619,8 @@ public:
     {
     }
 
-    websocket::stream<stream_type>&
+    websocket::stream<
+        gated_stream<stream_type>>&
     ws()
     {
         return ws_;
@@ -288,8 +643,8 @@ class ssl_ws_session_impl
     : public ws_session_base<ssl_ws_session_impl>
 {
     websocket::stream<
-        beast::ssl_stream<
-            stream_type>> ws_;
+        gated_stream<beast::ssl_stream<
+            stream_type>>> ws_;
 
 public:
     ssl_ws_session_impl(
@@ -305,8 +660,8 @@ public:
     }
 
     websocket::stream<
-        beast::ssl_stream<
-            stream_type>>&
+        gated_stream<beast::ssl_stream<
+            stream_type>>>&
     ws()
     {
         return ws_;
@@ -29,6 +29,21 @@ function LoungeChat(uri, user_name) {
         id++
     }
 
+    // Send several calls as one batch, each a [method, params] pair.
+    // The replies arrive together, and are passed to on_message in turn.
+    this.send_batch = function(calls) {
+        let json = calls.map(function(call) {
+            return {
+                jsonrpc: "2.0",
+                method: call[0],
+                id: id++,
+                params: call[1],
+            }
+        })
+
+        ws.send(JSON.stringify(json))
+    }
+
     this.disconnect = function() {
         ws.close()
     }
@@ -39,8 +54,10 @@ function LoungeChat(uri, user_name) {
     this.on_message = function() {}
 
     ws.addEventListener('open', function(event) {
-        this.send_message("identify", { cid: 1, name: user_name } )
-        this.send_message("join", { cid: 2 } )
+        this.send_batch([
+            ["identify", { cid: 1, name: user_name }],
+            ["join", { cid: 2 }],
+        ])
         this.on_open()
     }.bind(this))
 
@@ -54,7 +71,11 @@ function LoungeChat(uri, user_name) {
 
     ws.addEventListener('message', function(event) {
         try {
-            this.on_message(JSON.parse(event.data))
+            let json = JSON.parse(event.data)
+            if (Array.isArray(json))
+                json.forEach(this.on_message, this)
+            else
+                this.on_message(json)
         } catch (error) {
             this.on_error(error)
         }
@@ -0,0 +1,215 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+#include "bench_server.hpp"
+#include "listener.hpp"
+
+#include <boost/beast/_experimental/unit_test/suite.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/write.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Measures the rate at which a listener accepts loopback
+// connections and runs their sessions, as the number of
+// threads grows. Each thread runs its own io_context, as in
+// per-core execution mode, with one SO_REUSEPORT acceptor
+// per thread.
+class accept_bench_test : public beast::unit_test::suite
+{
+    using clock_type = std::chrono::steady_clock;
+    using tcp = net::ip::tcp;
+
+    // Opens connections one after another. Each sends one
+    // byte, which the listener's TLS detector reads, then
+    // waits for the HTTP session to reject the incomplete
+    // request and close the connection.
+    struct connector
+    {
+        tcp::endpoint ep;
+        tcp::socket sock;
+        std::size_t& remain;
+        std::atomic<std::size_t>& done;
+        std::atomic<std::size_t>& failed;
+        char buf[256];
+
+        connector(
+            net::io_context& ioc,
+            tcp::endpoint ep_,
+            std::size_t& remain_,
+            std::atomic<std::size_t>& done_,
+            std::atomic<std::size_t>& failed_)
+            : ep(ep_)
+            , sock(ioc)
+            , remain(remain_)
+            , done(done_)
+            , failed(failed_)
+        {
+        }
+
+        void
+        run()
+        {
+            if(remain == 0)
+                return;
+            --remain;
+            sock.async_connect(ep,
+                [this](beast::error_code ec)
+                {
+                    if(ec)
+                        return next(ec);
+                    net::async_write(sock,
+                        net::buffer("G", 1),
+                        [this](beast::error_code ec, std::size_t)
+                        {
+                            if(! ec)
+                                sock.shutdown(
+                                    tcp::socket::shutdown_send, ec);
+                            if(ec)
+                                return next(ec);
+                            do_read();
+                        });
+                });
+        }
+
+        void
+        do_read()
+        {
+            sock.async_read_some(net::buffer(buf),
+                [this](beast::error_code ec, std::size_t)
+                {
+                    if(! ec)
+                        return do_read();
+                    next(ec);
+                });
+        }
+
+        void
+        next(beast::error_code ec)
+        {
+            if(ec == net::error::eof)
+                ++done;
+            else
+                ++failed;
+            sock.close(ec);
+            run();
+        }
+    };
+
+    static
+    unsigned short
+    free_port()
+    {
+        net::io_context ioc;
+        tcp::acceptor a(ioc, tcp::endpoint(
+            net::ip::make_address("127.0.0.1"), 0));
+        return a.local_endpoint().port();
+    }
+
+    void
+    measure(
+        std::size_t threads,
+        std::size_t clients,
+        std::size_t connections)
+    {
+        connections /= clients;
+        auto const total = connections * clients;
+
+        std::vector<std::unique_ptr<net::io_context>> ctx;
+        std::vector<net::io_context*> v;
+        while(ctx.size() < threads)
+        {
+            ctx.emplace_back(new net::io_context(1));
+            v.push_back(ctx.back().get());
+        }
+        bench_server srv(v);
+
+        listener_config cfg;
+        cfg.address = net::ip::make_address("127.0.0.1");
+        cfg.port_num = free_port();
+        cfg.acceptors = static_cast<unsigned>(threads);
+        if(! BEAST_EXPECT(run_listener(srv, cfg)))
+            return;
+        endpoint_type const ep(cfg.address, cfg.port_num);
+
+        auto const t0 = clock_type::now();
+        srv.start();
+        std::vector<std::thread> vt;
+        for(auto p : v)
+            vt.emplace_back(
+                [p]
+                {
+                    p->run();
+                });
+
+        // Keep several connections in flight per client
+        std::atomic<std::size_t> done{0};
+        std::atomic<std::size_t> failed{0};
+        std::vector<std::thread> vc;
+        for(std::size_t i = 0; i < clients; ++i)
+            vc.emplace_back(
+                [&]
+                {
+                    net::io_context ioc(1);
+                    std::size_t remain = connections;
+                    std::vector<std::unique_ptr<connector>> cv;
+                    for(int j = 0; j < 16; ++j)
+                    {
+                        cv.emplace_back(new connector(
+                            ioc, ep, remain, done, failed));
+                        cv.back()->run();
+                    }
+                    ioc.run();
+                });
+        for(auto& t : vc)
+            t.join();
+        auto const t1 = clock_type::now();
+
+        srv.stop_services();
+        for(auto& t : vt)
+            t.join();
+
+        using ms = std::chrono::duration<double, std::milli>;
+        auto const elapsed = ms(t1 - t0).count();
+        log <<
+            threads << " threads\t" <<
+            elapsed << "ms, " <<
+            1000 * done / elapsed << " connections/s" <<
+            std::endl;
+        BEAST_EXPECT(failed == 0);
+        BEAST_EXPECT(done == total);
+    }
+
+    void
+    run() override
+    {
+        // Few enough to stay clear of
+        // exhausting the ephemeral ports
+        std::size_t const connections = 20000;
+        std::size_t const cores = (std::max)(
+            std::thread::hardware_concurrency(), 1u);
+        for(int i = 0; i < 2; ++i)
+        {
+            for(std::size_t n = 1;; n *= 2)
+            {
+                n = (std::min)(n, cores);
+                measure(n, cores, connections);
+                if(n == cores)
+                    break;
+            }
+        }
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(lounge,bench,accept_bench);
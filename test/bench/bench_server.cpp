@@ -0,0 +1,39 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+#include "listener.hpp"
+#include "server.hpp"
+
+#include <boost/beast/ssl/ssl_stream.hpp>
+#include <boost/beast/websocket/rfc6455.hpp>
+
+// The benchmarks link the HTTP sessions without the
+// WebSocket sessions, which would bring in the channels
+// and users. An upgrade request just closes the stream.
+
+void
+run_ws_session(
+    server&,
+    listener&,
+    stream_type,
+    endpoint_type,
+    websocket::request_type)
+{
+}
+
+void
+run_ws_session(
+    server&,
+    listener&,
+    beast::ssl_stream<
+        stream_type>,
+    endpoint_type,
+    websocket::request_type)
+{
+}
@@ -0,0 +1,192 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+#ifndef LOUNGE_BENCH_SERVER_HPP
+#define LOUNGE_BENCH_SERVER_HPP
+
+#include "logger.hpp"
+#include "server.hpp"
+#include "service.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/throw_exception.hpp>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Discards everything
+class null_section : public section
+{
+    void
+    prepare(int, std::ostream&) override
+    {
+    }
+
+    void
+    do_write(beast::string_view) override
+    {
+    }
+
+public:
+    int
+    threshold() const noexcept override
+    {
+        return 5;
+    }
+};
+
+class null_logger : public logger
+{
+    null_section sect_;
+
+public:
+    std::ostream&
+    cerr() override
+    {
+        return std::cerr;
+    }
+
+    bool
+    open(logger_config) override
+    {
+        return true;
+    }
+
+    section&
+    get_section(beast::string_view) override
+    {
+        return sect_;
+    }
+};
+
+/** A server which provides only executors, a log, services
+    and optionally static files.
+
+    Executors are distributed across the given contexts,
+    each of which acts as one shard in per-core mode.
+*/
+class bench_server : public server
+{
+    std::vector<net::io_context*> v_;
+    std::atomic<std::size_t> next_{0};
+    null_logger log_;
+    std::vector<std::unique_ptr<service>> services_;
+    std::string doc_root_;
+    ::file_cache* file_cache_ = nullptr;
+
+    [[noreturn]]
+    static
+    void
+    unused()
+    {
+        BOOST_THROW_EXCEPTION(std::logic_error(
+            "not used by the benchmark"));
+    }
+
+public:
+    explicit
+    bench_server(net::io_context& ioc)
+        : v_{&ioc}
+    {
+    }
+
+    explicit
+    bench_server(std::vector<net::io_context*> v)
+        : v_(std::move(v))
+    {
+    }
+
+    /// Serve static files from a document root through a cache
+    void
+    serve_files(
+        std::string doc_root,
+        ::file_cache& fc)
+    {
+        doc_root_ = std::move(doc_root);
+        file_cache_ = &fc;
+    }
+
+    /// Call on_start for every service
+    void
+    start()
+    {
+        for(auto const& sp : services_)
+            sp->on_start();
+    }
+
+    /// Call on_stop for every service
+    void
+    stop_services()
+    {
+        for(auto const& sp : services_)
+            sp->on_stop();
+    }
+
+    executor_type
+    make_executor() override
+    {
+        return net::make_strand(
+            *v_[next_++ % v_.size()]);
+    }
+
+    std::size_t
+    shard_of(executor_type const& ex) const noexcept override
+    {
+        auto const ctx = &ex.get_inner_executor().context();
+        for(std::size_t i = 0; i < v_.size(); ++i)
+            if(v_[i] == ctx)
+                return i;
+        return 0;
+    }
+
+    bool
+    forward(user&, message const&) override
+    {
+        return false;
+    }
+
+    void
+    insert(std::unique_ptr<service> sp) override
+    {
+        services_.emplace_back(std::move(sp));
+    }
+
+    beast::string_view
+    doc_root() const override
+    {
+        if(! file_cache_)
+            unused();
+        return doc_root_;
+    }
+
+    ::send_limits const& send_limits() const override { unused(); }
+    ::read_options const& read_options() const override { unused(); }
+    ::deflate_pool* deflate_pool() override { return nullptr; }
+    logger& log() override { return log_; }
+    ::channel_list& channel_list() override { unused(); }
+    ::file_cache&
+    file_cache() override
+    {
+        if(! file_cache_)
+            unused();
+        return *file_cache_;
+    }
+
+    ::rpc_pool& rpc_pool() override { unused(); }
+    void run() override { unused(); }
+    bool is_shutting_down() override { return false; }
+    void shutdown(std::chrono::seconds) override { unused(); }
+    void stop() override { unused(); }
+};
+
+#endif
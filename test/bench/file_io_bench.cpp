@@ -0,0 +1,299 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+#include "bench_server.hpp"
+#include "file_cache.hpp"
+#include "file_op.hpp"
+
+#include <boost/beast/_experimental/unit_test/suite.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/websocket/stream.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+extern
+std::unique_ptr<file_cache>
+make_file_cache(
+    server&,
+    std::size_t max_bytes,
+    std::size_t threads);
+
+// Measures the round trip time of a small WebSocket echo
+// while the same network thread serves static files. Each
+// file is dropped from the page cache before it is opened,
+// so the reads reach the disk. Files are loaded through
+// file_cache::async_get, or opened with open_file and
+// streamed with file_op as done for a file too large to
+// cache. The streamed files are either opened and read on
+// the network thread, or entirely on the file I/O pool as
+// the server does.
+class file_io_bench_test : public beast::unit_test::suite
+{
+    using clock_type = std::chrono::steady_clock;
+    using tcp = net::ip::tcp;
+
+    enum class mode
+    {
+        idle,
+        inline_reads,
+        pool_reads,
+        cache_misses
+    };
+
+    net::io_context ioc_;
+    bench_server srv_;
+    std::unique_ptr<file_cache> cache_;
+    std::unique_ptr<websocket::stream<tcp::socket>> ws_;
+    beast::flat_buffer rb_;
+    std::vector<std::string> paths_;
+    std::shared_ptr<file_op> op_;
+    std::size_t next_ = 0;
+    std::size_t loads_ = 0;
+    std::atomic<bool> reading_{false};
+    std::atomic<int> pending_{0};
+
+public:
+    file_io_bench_test()
+        : srv_(ioc_)
+    {
+        // Locate the files relative to this source file
+        std::string root = __FILE__;
+        root.resize(root.rfind("test"));
+        root.append("static/wwwroot/");
+        for(auto name : {
+                "admin.html", "admin.js", "data_64K.html",
+                "index.css", "index.html" })
+            paths_.push_back(root + name);
+
+        // Every file fits, so only erase() causes a miss.
+        // The inotify watch is never started.
+        cache_ = make_file_cache(srv_, 1024 * 1024, 2);
+    }
+
+    // Evict a file from the page cache
+    static
+    void
+    drop(std::string const& path)
+    {
+    #if defined(__linux__) && defined(POSIX_FADV_DONTNEED)
+        auto const fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+            return;
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    #else
+        boost::ignore_unused(path);
+    #endif
+    }
+
+    std::string const&
+    next_path()
+    {
+        auto const& path = paths_[next_++ % paths_.size()];
+        drop(path);
+        return path;
+    }
+
+    void
+    do_echo()
+    {
+        ws_->async_read(
+            rb_,
+            [this](beast::error_code ec, std::size_t)
+            {
+                if(ec)
+                    return;
+                ws_->async_write(
+                    rb_.data(),
+                    [this](beast::error_code ec, std::size_t)
+                    {
+                        if(ec)
+                            return;
+                        rb_.consume(rb_.size());
+                        do_echo();
+                    });
+            });
+    }
+
+    // Start streaming the next file if the last one is done
+    void
+    next_file(beast::error_code& ec)
+    {
+        if(op_ && op_->remain > 0)
+            return;
+        auto f = open_file(next_path(), 0);
+        ec = f.ec;
+        if(ec)
+            return;
+        http::response<file_range_body> res{
+            std::piecewise_construct,
+            std::make_tuple(std::move(f.body))};
+        op_ = std::make_shared<file_op>(std::move(res));
+        ++loads_;
+    }
+
+    // Read one chunk of a file and schedule the next
+    void
+    do_file(mode m)
+    {
+        if(! reading_)
+            return;
+        if(m == mode::inline_reads)
+        {
+            beast::error_code ec;
+            next_file(ec);
+            if(! ec)
+                op_->read(ec);
+            if(! BEAST_EXPECTS(! ec, ec.message()))
+                return;
+            net::post(ioc_, [this, m]{ do_file(m); });
+            return;
+        }
+
+        // As in handle_request and http_session::read_chunk,
+        // the network thread only starts the work.
+        ++pending_;
+        net::post(
+            cache_->io_executor(),
+            [this, m]
+            {
+                if(m == mode::cache_misses)
+                {
+                    auto const& path = next_path();
+                    cache_->erase(path);
+                    return cache_->async_get(
+                        path, 0, srv_.make_executor(),
+                        [this, m](
+                            beast::error_code ec,
+                            boost::shared_ptr<cached_file const> sp)
+                        {
+                            --pending_;
+                            if(! BEAST_EXPECTS(! ec, ec.message()) ||
+                                ! BEAST_EXPECT(sp))
+                                return;
+                            ++loads_;
+                            do_file(m);
+                        });
+                }
+                beast::error_code ec;
+                next_file(ec);
+                if(! ec)
+                    op_->read(ec);
+                net::post(ioc_,
+                    [this, m, ec]
+                    {
+                        --pending_;
+                        if(BEAST_EXPECTS(! ec, ec.message()))
+                            do_file(m);
+                    });
+            });
+    }
+
+    void
+    measure(char const* name, mode m)
+    {
+        tcp::acceptor a(ioc_, tcp::endpoint(
+            net::ip::make_address("127.0.0.1"), 0));
+        ws_.reset(new websocket::stream<tcp::socket>(ioc_));
+        op_.reset();
+        loads_ = 0;
+
+        std::vector<double> rtt;
+        std::thread t(
+            [&]
+            {
+                using us = std::chrono::duration<
+                    double, std::micro>;
+                net::io_context cioc;
+                websocket::stream<tcp::socket> client(cioc);
+                beast::error_code ec;
+                client.next_layer().connect(a.local_endpoint(), ec);
+                if(! ec)
+                    client.next_layer().set_option(
+                        tcp::no_delay(true), ec);
+                if(! ec)
+                    client.handshake("localhost", "/", ec);
+                beast::flat_buffer b;
+                for(int i = 0; ! ec && i < 2000; ++i)
+                {
+                    auto const t0 = clock_type::now();
+                    client.write(net::buffer("ping", 4), ec);
+                    if(! ec)
+                        client.read(b, ec);
+                    if(ec)
+                        break;
+                    b.consume(b.size());
+                    rtt.push_back(us(clock_type::now() - t0).count());
+                    std::this_thread::sleep_for(
+                        std::chrono::microseconds(500));
+                }
+                BEAST_EXPECTS(! ec, ec.message());
+                reading_ = false;
+                client.close(websocket::close_code::normal, ec);
+            });
+
+        a.accept(ws_->next_layer());
+        ws_->next_layer().set_option(tcp::no_delay(true));
+        ws_->async_accept(
+            [this](beast::error_code ec)
+            {
+                if(BEAST_EXPECTS(! ec, ec.message()))
+                    do_echo();
+            });
+
+        reading_ = m != mode::idle;
+        if(reading_)
+            net::post(ioc_, [this, m]{ do_file(m); });
+        ioc_.restart();
+        ioc_.run();
+        t.join();
+
+        // Retire a read still on the pool
+        while(pending_ > 0)
+        {
+            ioc_.restart();
+            ioc_.poll();
+        }
+
+        BEAST_EXPECT(! rtt.empty());
+        if(rtt.empty())
+            return;
+        std::sort(rtt.begin(), rtt.end());
+        log <<
+            name <<
+            "\tp50 " << rtt[rtt.size() / 2] << "us" <<
+            "\tp99 " << rtt[rtt.size() * 99 / 100] << "us" <<
+            "\t" << loads_ << " files" <<
+            std::endl;
+    }
+
+    void
+    run() override
+    {
+        measure("idle", mode::idle);
+        measure("inline reads", mode::inline_reads);
+        measure("pool reads", mode::pool_reads);
+        measure("cache misses", mode::cache_misses);
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(lounge,bench,file_io_bench);
@@ -0,0 +1,189 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+#include "mpsc_queue.hpp"
+
+#include <boost/beast/_experimental/unit_test/suite.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Measures broadcasting from several threads to 1000
+// sessions, comparing one dispatch to the session's
+// strand per message with the lock-free inbox, which
+// schedules one drain for each burst.
+class inbox_bench_test : public beast::unit_test::suite
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+    using message = std::shared_ptr<std::string const>;
+    using strand_type =
+        net::strand<net::io_context::executor_type>;
+
+    struct node : mpsc_node
+    {
+        message m;
+
+        explicit
+        node(message m_)
+            : m(std::move(m_))
+        {
+        }
+    };
+
+    struct session
+    {
+        strand_type strand;
+        std::size_t bytes = 0;
+        mpsc_queue<node> inbox;
+        std::atomic<std::size_t> inbox_size{0};
+
+        explicit
+        session(net::io_context& ioc)
+            : strand(net::make_strand(ioc))
+        {
+        }
+    };
+
+    std::atomic<std::size_t> delivered_{0};
+    std::atomic<std::size_t> completions_{0};
+
+    void
+    deliver(session& s, message const& m)
+    {
+        s.bytes += m->size();
+        delivered_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void
+    send_dispatch(session& s, message m)
+    {
+        net::dispatch(s.strand,
+            [this, &s, m]
+            {
+                completions_.fetch_add(
+                    1, std::memory_order_relaxed);
+                deliver(s, m);
+            });
+    }
+
+    void
+    drain(session& s)
+    {
+        completions_.fetch_add(1, std::memory_order_relaxed);
+        std::size_t n = 0;
+        while(auto p = s.inbox.pop())
+        {
+            std::unique_ptr<node> np(p);
+            ++n;
+            deliver(s, np->m);
+        }
+        if(s.inbox_size.fetch_sub(n,
+                std::memory_order_acq_rel) != n)
+            net::post(s.strand, [this, &s]{ drain(s); });
+    }
+
+    void
+    send_inbox(session& s, message m)
+    {
+        s.inbox.push(new node(std::move(m)));
+        if(s.inbox_size.fetch_add(1,
+                std::memory_order_acq_rel) == 0)
+            net::post(s.strand, [this, &s]{ drain(s); });
+    }
+
+    template<class Send>
+    void
+    measure(
+        char const* name,
+        std::size_t threads,
+        std::size_t sessions,
+        std::size_t messages,
+        Send const& send)
+    {
+        net::io_context ioc;
+        std::vector<std::unique_ptr<session>> v;
+        for(std::size_t i = 0; i < sessions; ++i)
+            v.emplace_back(new session(ioc));
+
+        auto work = net::make_work_guard(ioc);
+        std::vector<std::thread> vt;
+        for(std::size_t i = 0; i < threads; ++i)
+            vt.emplace_back([&ioc]{ ioc.run(); });
+
+        delivered_ = 0;
+        completions_ = 0;
+        auto const total = threads * sessions * messages;
+        auto const t0 = clock_type::now();
+        std::vector<std::thread> producers;
+        for(std::size_t t = 0; t < threads; ++t)
+            producers.emplace_back(
+                [&, t]
+                {
+                    for(std::size_t i = 0; i < messages; ++i)
+                    {
+                        auto const m = std::make_shared<
+                            std::string const>(
+                                "{\"method\":\"say\",\"params\":"
+                                "{\"message\":\"" +
+                                std::to_string(t) + "\"}}");
+                        for(auto& sp : v)
+                            send(*sp, m);
+                    }
+                });
+        for(auto& t : producers)
+            t.join();
+        while(delivered_.load() < total)
+            std::this_thread::yield();
+        auto const t1 = clock_type::now();
+
+        work.reset();
+        for(auto& t : vt)
+            t.join();
+
+        using ms = std::chrono::duration<double, std::milli>;
+        log <<
+            name << "\t" <<
+            ms(t1 - t0).count() << "ms, " <<
+            static_cast<double>(completions_) / total <<
+            " completions/message" << std::endl;
+    }
+
+    void
+    run() override
+    {
+        std::size_t const threads = 4;
+        std::size_t const sessions = 1000;
+        std::size_t const messages = 500;
+        for(int i = 0; i < 2; ++i)
+        {
+            measure("dispatch", threads, sessions, messages,
+                [this](session& s, message const& m)
+                {
+                    send_dispatch(s, m);
+                });
+            measure("inbox", threads, sessions, messages,
+                [this](session& s, message const& m)
+                {
+                    send_inbox(s, m);
+                });
+        }
+        pass();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(lounge,bench,inbox_bench);
@@ -0,0 +1,164 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+#include "config.hpp"
+
+#include <boost/beast/_experimental/unit_test/suite.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Measures round trips of small messages over loopback
+// echo connections. The reactor is chosen when Asio is
+// compiled, so compare the output of lounge-bench (epoll)
+// with lounge-bench-uring, built with LOUNGE_IO_URING.
+class io_backend_bench_test : public beast::unit_test::suite
+{
+    using clock_type = std::chrono::steady_clock;
+    using tcp = net::ip::tcp;
+
+    // The size of a short chat message
+    static std::size_t constexpr message_size = 128;
+
+    struct peer
+    {
+        tcp::socket sock;
+        char buf[message_size];
+        std::size_t rounds = 0;
+
+        explicit
+        peer(net::io_context& ioc)
+            : sock(ioc)
+        {
+        }
+    };
+
+    static
+    char const*
+    backend() noexcept
+    {
+    #ifdef LOUNGE_IO_URING
+        return "io_uring";
+    #else
+        return "epoll";
+    #endif
+    }
+
+    // Send back whatever arrives
+    static
+    void
+    do_echo(peer& p)
+    {
+        net::async_read(p.sock, net::buffer(p.buf),
+            [&p](beast::error_code ec, std::size_t)
+            {
+                if(ec)
+                    return;
+                net::async_write(p.sock, net::buffer(p.buf),
+                    [&p](beast::error_code ec, std::size_t)
+                    {
+                        if(! ec)
+                            do_echo(p);
+                    });
+            });
+    }
+
+    // Send a message and wait for it to return
+    void
+    do_ping(peer& p)
+    {
+        if(p.rounds-- == 0)
+            return p.sock.shutdown(
+                tcp::socket::shutdown_send);
+        net::async_write(p.sock, net::buffer(p.buf),
+            [this, &p](beast::error_code ec, std::size_t)
+            {
+                if(! BEAST_EXPECTS(! ec, ec.message()))
+                    return;
+                net::async_read(p.sock, net::buffer(p.buf),
+                    [this, &p](beast::error_code ec, std::size_t)
+                    {
+                        if(! BEAST_EXPECTS(! ec, ec.message()))
+                            return;
+                        do_ping(p);
+                    });
+            });
+    }
+
+    void
+    measure(
+        std::size_t connections,
+        std::size_t rounds)
+    {
+        // One thread serves, as a shard would
+        net::io_context sioc(1);
+        net::io_context cioc(1);
+        tcp::acceptor a(sioc, tcp::endpoint(
+            net::ip::make_address("127.0.0.1"), 0));
+        std::vector<std::unique_ptr<peer>> servers;
+        std::vector<std::unique_ptr<peer>> clients;
+        for(std::size_t i = 0; i < connections; ++i)
+        {
+            clients.emplace_back(new peer(cioc));
+            clients.back()->sock.connect(a.local_endpoint());
+            clients.back()->sock.set_option(
+                tcp::no_delay(true));
+            servers.emplace_back(new peer(sioc));
+            a.accept(servers.back()->sock);
+            servers.back()->sock.set_option(
+                tcp::no_delay(true));
+        }
+
+        auto const t0 = clock_type::now();
+        for(auto& p : servers)
+            do_echo(*p);
+        for(auto& p : clients)
+        {
+            p->rounds = rounds;
+            do_ping(*p);
+        }
+        std::thread t(
+            [&]
+            {
+                sioc.run();
+            });
+        cioc.run();
+        t.join();
+        auto const t1 = clock_type::now();
+
+        using ms = std::chrono::duration<double, std::milli>;
+        auto const elapsed = ms(t1 - t0).count();
+        log <<
+            backend() << "\t" <<
+            connections << " connections\t" <<
+            elapsed << "ms, " <<
+            1000 * connections * rounds / elapsed <<
+                " round trips/s" <<
+            std::endl;
+    }
+
+    void
+    run() override
+    {
+        for(int i = 0; i < 2; ++i)
+        {
+            measure(1, 50000);
+            measure(100, 500);
+            measure(1000, 50);
+        }
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(lounge,bench,io_backend_bench);
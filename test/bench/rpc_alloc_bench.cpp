@@ -0,0 +1,142 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+#include "rpc_arena.hpp"
+
+#include <boost/beast/_experimental/unit_test/suite.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/core/string.hpp>
+#include <boost/json.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::atomic<std::size_t> allocations{0};
+
+} // (anon)
+
+// Count every allocation made by this program
+void*
+operator new(std::size_t n)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if(auto p = std::malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void
+operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+// Measures heap allocations per JSON-RPC request, from
+// parsing through building the reply, comparing default
+// storage with a session's reusable arena.
+class rpc_alloc_bench_test : public beast::unit_test::suite
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    // The work of rpc_call::extract and rpc_call::complete
+    static
+    std::size_t
+    handle(
+        beast::string_view request,
+        json::storage_ptr sp)
+    {
+        beast::error_code ec;
+        auto jv = json::parse(request, ec, sp);
+        auto& obj = jv.as_object();
+        json::value id(std::move(obj["id"]));
+        json::string method(sp);
+        method = std::move(obj["method"].as_string());
+        json::value params(sp);
+        params = std::move(obj["params"]);
+
+        json::value result(json::object_kind, sp);
+        auto& r = result.get_object();
+        r["cid"] = params.as_object()["cid"];
+        r["method"] = method;
+        r["ok"] = true;
+
+        json::value res(json::object_kind, sp);
+        auto& ro = res.get_object();
+        ro.emplace("id", id);
+        ro.emplace("result", std::move(result));
+
+        char buf[4096];
+        json::serializer sr(res);
+        return sr.read(buf, sizeof(buf));
+    }
+
+    template<class F>
+    void
+    measure(
+        char const* name,
+        std::vector<std::string> const& requests,
+        std::size_t rounds,
+        F const& f)
+    {
+        std::size_t bytes = 0;
+        auto const a0 = allocations.load();
+        auto const t0 = clock_type::now();
+        for(std::size_t i = 0; i < rounds; ++i)
+            for(auto const& s : requests)
+                bytes += f(s);
+        auto const t1 = clock_type::now();
+        auto const a1 = allocations.load();
+
+        using ms = std::chrono::duration<double, std::milli>;
+        auto const n = rounds * requests.size();
+        log <<
+            name << "\t" <<
+            ms(t1 - t0).count() << "ms, " <<
+            static_cast<double>(a1 - a0) / n <<
+            " allocations/rpc" << std::endl;
+        BEAST_EXPECT(bytes > 0);
+    }
+
+    void
+    run() override
+    {
+        std::vector<std::string> requests = {
+            R"({"jsonrpc":"2.0","id":1,"method":"say",)"
+            R"("params":{"cid":1,"message":"Hello, world!"}})",
+            R"({"jsonrpc":"2.0","id":2,"method":"bet",)"
+            R"("params":{"cid":2,"amount":25}})",
+            R"({"jsonrpc":"2.0","id":"x","method":"join",)"
+            R"("params":{"cid":3,"name":"lounge","seat":4,)"
+            R"("options":{"watch":false,"tags":["a","b","c"]}}})"
+        };
+        std::size_t const rounds = 100000;
+
+        measure("default", requests, rounds,
+            [](std::string const& s)
+            {
+                return handle(s, {});
+            });
+
+        boost::shared_ptr<rpc_arena> arena;
+        measure("arena", requests, rounds,
+            [&arena](std::string const& s)
+            {
+                rpc_arena::recycle(arena);
+                return handle(s, arena->storage());
+            });
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(lounge,bench,rpc_alloc_bench);
@@ -0,0 +1,143 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+#include "rpc.hpp"
+
+#include <boost/beast/_experimental/unit_test/suite.hpp>
+#include <boost/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// Measures rejecting requests whose params are wrong,
+// comparing the checked_* helpers, which throw, with
+// the expect_* helpers, which return the error.
+class rpc_error_bench_test : public beast::unit_test::suite
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    std::atomic<std::size_t> failed_{0};
+
+    // A handler written with the throwing helpers
+    static
+    void
+    say_checked(json::value& params)
+    {
+        auto const& text =
+            checked_string(params, "message");
+        if(text.empty())
+            throw rpc_error("empty message");
+    }
+
+    // The same handler returning its error
+    static
+    beast::error_code
+    say_expected(json::value& params)
+    {
+        auto const text =
+            expect_string(params, "message");
+        if(! text)
+            return text.error();
+        if(text->get().empty())
+            return rpc_code::invalid_params;
+        return {};
+    }
+
+    // The dispatcher around each kind of handler. The code
+    // stands in for the reply, which costs the same for both.
+    static
+    int
+    dispatch_checked(json::value& params)
+    {
+        try
+        {
+            say_checked(params);
+            return 0;
+        }
+        catch(rpc_error const&)
+        {
+            return 1;
+        }
+    }
+
+    static
+    int
+    dispatch_expected(json::value& params)
+    {
+        auto const ec = say_expected(params);
+        return ec ? 1 : 0;
+    }
+
+    template<class Dispatch>
+    void
+    measure(
+        char const* name,
+        std::size_t threads,
+        std::size_t calls,
+        Dispatch const& dispatch)
+    {
+        failed_ = 0;
+        auto const t0 = clock_type::now();
+        std::vector<std::thread> vt;
+        for(std::size_t t = 0; t < threads; ++t)
+            vt.emplace_back(
+                [&]
+                {
+                    // Half are missing the key, half have
+                    // the wrong type for it.
+                    auto missing = json::parse(
+                        "{\"cid\":2,\"text\":\"hello\"}");
+                    auto wrong = json::parse(
+                        "{\"cid\":2,\"message\":42}");
+                    std::size_t n = 0;
+                    for(std::size_t i = 0; i < calls; ++i)
+                        n += dispatch(
+                            (i & 1) ? wrong : missing);
+                    failed_.fetch_add(n);
+                });
+        for(auto& t : vt)
+            t.join();
+        auto const t1 = clock_type::now();
+
+        using ms = std::chrono::duration<double, std::milli>;
+        auto const elapsed = ms(t1 - t0).count();
+        log <<
+            name << "\t" <<
+            threads << " threads\t" <<
+            elapsed << "ms, " <<
+            1e6 * elapsed / (threads * calls) <<
+            "ns/error" << std::endl;
+        BEAST_EXPECT(failed_ == threads * calls);
+    }
+
+    void
+    run() override
+    {
+        std::size_t const calls = 200000;
+        std::size_t const cores = (std::max)(
+            std::thread::hardware_concurrency(), 1u);
+        for(int i = 0; i < 2; ++i)
+        {
+            for(std::size_t threads = 1;; threads = cores)
+            {
+                measure("checked", threads, calls,
+                    &rpc_error_bench_test::dispatch_checked);
+                measure("expected", threads, calls,
+                    &rpc_error_bench_test::dispatch_expected);
+                if(threads == cores)
+                    break;
+            }
+        }
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(lounge,bench,rpc_error_bench);
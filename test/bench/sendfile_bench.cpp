@@ -0,0 +1,189 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+#include "bench_server.hpp"
+#include "file_cache.hpp"
+#include "listener.hpp"
+#include "sendfile.hpp"
+
+#include <boost/beast/_experimental/unit_test/suite.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/empty_body.hpp>
+#include <boost/beast/http/read.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <boost/beast/http/write.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern
+std::unique_ptr<file_cache>
+make_file_cache(
+    server&,
+    std::size_t max_bytes,
+    std::size_t threads);
+
+// Measures serving static/wwwroot/data_64K.html through
+// the listener and the plain HTTP sessions over loopback
+// connections. The file is either sent from the
+// file cache with a gathered write, or with the cache
+// disabled it is opened on the file I/O pool and its body
+// sent with sendfile, as for a file too large to cache.
+class sendfile_bench_test : public beast::unit_test::suite
+{
+    using clock_type = std::chrono::steady_clock;
+    using tcp = net::ip::tcp;
+
+    std::string root_;
+    std::uint64_t size_ = 0;
+
+public:
+    sendfile_bench_test()
+    {
+        // Locate the files relative to this source file
+        root_ = __FILE__;
+        root_.resize(root_.rfind("test"));
+        root_.append("static/wwwroot");
+    }
+
+    static
+    unsigned short
+    free_port()
+    {
+        net::io_context ioc;
+        tcp::acceptor a(ioc, tcp::endpoint(
+            net::ip::make_address("127.0.0.1"), 0));
+        return a.local_endpoint().port();
+    }
+
+    // Request the file n times, returning the number of
+    // complete responses. The HTTP session closes the
+    // connection after each response, so every request
+    // goes out on a new connection.
+    std::size_t
+    fetch(
+        tcp::endpoint ep,
+        std::size_t n)
+    {
+        net::io_context ioc;
+        http::request<http::empty_body> req{
+            http::verb::get, "/data_64K.html", 11};
+        req.set(http::field::host, "localhost");
+        std::size_t ok = 0;
+        for(std::size_t i = 0; i < n; ++i)
+        {
+            tcp::socket sock(ioc);
+            beast::error_code ec;
+            sock.connect(ep, ec);
+            if(! ec)
+                http::write(sock, req, ec);
+            if(ec)
+                continue;
+            beast::flat_buffer b;
+            http::response_parser<http::string_body> p;
+            p.body_limit(1024 * 1024);
+            http::read(sock, b, p, ec);
+            if(! ec &&
+                p.get().result() == http::status::ok &&
+                p.get().body().size() == size_)
+                ++ok;
+        }
+        return ok;
+    }
+
+    void
+    measure(
+        char const* name,
+        std::size_t max_bytes,
+        std::size_t clients,
+        std::size_t requests)
+    {
+        requests /= clients;
+        auto const total = requests * clients;
+
+        net::io_context ioc(1);
+        bench_server srv(ioc);
+        auto fc = make_file_cache(srv, max_bytes, 2);
+        srv.serve_files(root_, *fc);
+
+        listener_config cfg;
+        cfg.address = net::ip::make_address("127.0.0.1");
+        cfg.port_num = free_port();
+        if(! BEAST_EXPECT(run_listener(srv, cfg)))
+            return;
+        tcp::endpoint const ep(cfg.address, cfg.port_num);
+
+        srv.start();
+        std::thread t(
+            [&ioc]
+            {
+                ioc.run();
+            });
+
+        auto const t0 = clock_type::now();
+        std::atomic<std::size_t> done{0};
+        std::vector<std::thread> vc;
+        for(std::size_t i = 0; i < clients; ++i)
+            vc.emplace_back(
+                [&]
+                {
+                    done += fetch(ep, requests);
+                });
+        for(auto& c : vc)
+            c.join();
+        auto const t1 = clock_type::now();
+
+        srv.stop_services();
+        t.join();
+
+        using ms = std::chrono::duration<double, std::milli>;
+        auto const elapsed = ms(t1 - t0).count();
+        log <<
+            name << "\t" <<
+            elapsed << "ms, " <<
+            static_cast<std::size_t>(
+                1000 * done / elapsed) << " responses/s, " <<
+            static_cast<std::size_t>(
+                done * size_ / elapsed / 1000) << " MB/s" <<
+            std::endl;
+        BEAST_EXPECT(done == total);
+    }
+
+    void
+    run() override
+    {
+        std::time_t mtime;
+        if(! BEAST_EXPECT(stat_file(
+                root_ + "/data_64K.html", mtime, size_)))
+            return;
+        log << "data_64K.html\t" << size_ << " bytes" << std::endl;
+    #ifndef LOUNGE_HAS_SENDFILE
+        log << "sendfile is unavailable, "
+            "uncached files use file_body" << std::endl;
+    #endif
+
+        // Few enough to stay clear of
+        // exhausting the ephemeral ports
+        std::size_t const requests = 10000;
+        for(std::size_t clients : { 1, 8 })
+        {
+            log << clients << " clients" << std::endl;
+            measure("cached",
+                16 * 1024 * 1024, clients, requests);
+            measure("uncached",
+                0, clients, requests);
+        }
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(lounge,bench,sendfile_bench);
@@ -0,0 +1,112 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+#include "sharded_set.hpp"
+
+#include <boost/beast/_experimental/unit_test/suite.hpp>
+#include <boost/container/flat_set.hpp>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Measures session registry churn under contention, comparing
+// one mutex around a flat_set with the sharded set.
+class sharded_set_bench_test : public beast::unit_test::suite
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    struct item
+    {
+        int n = 0;
+    };
+
+    class locked_set
+    {
+        std::mutex mutex_;
+        boost::container::flat_set<item*> set_;
+
+    public:
+        void
+        insert(item* p)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            set_.insert(p);
+        }
+
+        void
+        erase(item* p)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            set_.erase(p);
+        }
+    };
+
+    // Each thread keeps `live` sessions registered and
+    // replaces them one at a time, `churn` times.
+    template<class Set>
+    double
+    measure(
+        Set& s,
+        std::size_t threads,
+        std::size_t live,
+        std::size_t churn)
+    {
+        std::vector<item> v(threads * live);
+        for(auto& e : v)
+            s.insert(&e);
+        std::vector<item> fresh(threads);
+        auto const t0 = clock_type::now();
+        std::vector<std::thread> vt;
+        for(std::size_t t = 0; t < threads; ++t)
+            vt.emplace_back(
+                [&, t]
+                {
+                    auto const base = &v[t * live];
+                    for(std::size_t i = 0; i < churn; ++i)
+                    {
+                        auto const p = base + (i % live);
+                        s.erase(p);
+                        s.insert(&fresh[t]);
+                        s.erase(&fresh[t]);
+                        s.insert(p);
+                    }
+                });
+        for(auto& t : vt)
+            t.join();
+        auto const t1 = clock_type::now();
+        return std::chrono::duration<double, std::milli>(
+            t1 - t0).count();
+    }
+
+    void
+    run() override
+    {
+        std::size_t const live = 200000;
+        std::size_t const churn = 20000;
+        for(std::size_t threads : { 1, 2, 4, 8 })
+        {
+            locked_set s0;
+            sharded_set<item> s1;
+            auto const locked = measure(
+                s0, threads, live / threads, churn);
+            auto const sharded = measure(
+                s1, threads, live / threads, churn);
+            log <<
+                "threads=" << threads <<
+                "\tlocked=" << locked << "ms" <<
+                "\tsharded=" << sharded << "ms" <<
+                std::endl;
+        }
+        pass();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(lounge,bench,sharded_set_bench);
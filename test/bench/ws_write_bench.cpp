@@ -0,0 +1,249 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+#include "gated_stream.hpp"
+#include "ws_frame.hpp"
+
+#include <boost/beast/_experimental/unit_test/suite.hpp>
+#include <boost/beast/websocket/stream.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Measures delivering bursts of chat messages to 1000
+// WebSocket subscribers over loopback, comparing one
+// websocket write per message with a gathered write of
+// every queued frame, as done by the sessions.
+class ws_write_bench_test : public beast::unit_test::suite
+{
+    using clock_type = std::chrono::steady_clock;
+    using tcp = net::ip::tcp;
+
+    // Counts the writes which reach the socket
+    class counted_socket : public tcp::socket
+    {
+    public:
+        std::size_t* writes;
+
+        counted_socket(
+            net::io_context& ioc,
+            std::size_t* writes_)
+            : tcp::socket(ioc)
+            , writes(writes_)
+        {
+        }
+
+        template<class ConstBufferSequence, class WriteHandler>
+        BOOST_BEAST_ASYNC_RESULT2(WriteHandler)
+        async_write_some(
+            ConstBufferSequence const& buffers,
+            WriteHandler&& handler)
+        {
+            ++*writes;
+            return tcp::socket::async_write_some(buffers,
+                std::forward<WriteHandler>(handler));
+        }
+    };
+
+    using ws_type = websocket::stream<
+        gated_stream<counted_socket>>;
+
+    struct subscriber
+    {
+        ws_type ws;
+        std::deque<net::const_buffer> mq;
+        ws_frame_batch wb;
+        std::size_t wn = 0;
+
+        subscriber(
+            net::io_context& ioc,
+            std::size_t* writes)
+            : ws(ioc, writes)
+        {
+        }
+    };
+
+    net::io_context ioc_;
+    net::io_context cioc_;
+    std::size_t writes_ = 0;
+    std::size_t pending_ = 0;
+    std::vector<std::unique_ptr<subscriber>> subs_;
+    std::vector<std::unique_ptr<tcp::socket>> clients_;
+    std::vector<char> drain_;
+
+public:
+    ws_write_bench_test()
+        : drain_(65536)
+    {
+    }
+
+    void
+    connect(std::size_t n)
+    {
+        tcp::acceptor a(ioc_, tcp::endpoint(
+            net::ip::make_address("127.0.0.1"), 0));
+        std::thread t(
+            [&]
+            {
+                std::vector<std::unique_ptr<
+                    websocket::stream<tcp::socket>>> v;
+                for(std::size_t i = 0; i < n; ++i)
+                {
+                    v.emplace_back(new websocket::stream<
+                        tcp::socket>(cioc_));
+                    v.back()->next_layer().connect(
+                        a.local_endpoint());
+                }
+                for(auto& ws : v)
+                {
+                    ws->handshake("localhost", "/");
+                    clients_.emplace_back(new tcp::socket(
+                        std::move(ws->next_layer())));
+                }
+            });
+        for(std::size_t i = 0; i < n; ++i)
+        {
+            subs_.emplace_back(new subscriber(ioc_, &writes_));
+            auto& ws = subs_.back()->ws;
+            a.accept(ws.next_layer().next_layer());
+            ws.async_accept(
+                [this](beast::error_code ec)
+                {
+                    if(ec)
+                        fail(ec.message(), __FILE__, __LINE__);
+                });
+        }
+        ioc_.run();
+        ioc_.restart();
+        t.join();
+    }
+
+    void
+    do_drain(tcp::socket& s)
+    {
+        s.async_read_some(
+            net::buffer(drain_),
+            [this, &s](beast::error_code ec, std::size_t)
+            {
+                if(! ec)
+                    do_drain(s);
+            });
+    }
+
+    // One websocket write per message
+    void
+    write_each(subscriber& s)
+    {
+        s.ws.async_write(
+            s.mq.front(),
+            [this, &s](beast::error_code ec, std::size_t)
+            {
+                if(ec)
+                    return fail(ec.message(), __FILE__, __LINE__);
+                s.mq.pop_front();
+                if(! s.mq.empty())
+                    return write_each(s);
+                --pending_;
+            });
+    }
+
+    // One gathered write of every queued message
+    void
+    write_batch(subscriber& s)
+    {
+        s.wn = s.wb.assign(
+            s.mq.begin(), s.mq.end(), 64 * 1024);
+        s.ws.next_layer().async_write_some(
+            s.wb.buffers(),
+            [this, &s](beast::error_code ec, std::size_t)
+            {
+                if(ec)
+                    return fail(ec.message(), __FILE__, __LINE__);
+                for(; s.wn > 0; --s.wn)
+                    s.mq.pop_front();
+                if(! s.mq.empty())
+                    return write_batch(s);
+                --pending_;
+            });
+    }
+
+    template<class Write>
+    void
+    measure(
+        char const* name,
+        std::size_t rounds,
+        std::size_t burst,
+        Write const& write)
+    {
+        std::vector<std::string> chat;
+        for(std::size_t i = 0; i < burst; ++i)
+            chat.emplace_back(
+                "{\"jsonrpc\":\"2.0\",\"method\":\"say\",\"params\":"
+                "{\"channel\":1,\"user\":\"alice\",\"message\":"
+                "\"Hello, world! " + std::to_string(i) + "\"}}");
+
+        writes_ = 0;
+        auto const t0 = clock_type::now();
+        for(std::size_t r = 0; r < rounds; ++r)
+        {
+            // A burst arrives for everyone at once
+            pending_ = subs_.size();
+            for(auto& sp : subs_)
+            {
+                for(auto const& m : chat)
+                    sp->mq.push_back(net::buffer(m));
+                write(*sp);
+            }
+            ioc_.restart();
+            while(pending_ > 0)
+                ioc_.run_one();
+        }
+        auto const t1 = clock_type::now();
+
+        using ms = std::chrono::duration<double, std::milli>;
+        auto const elapsed = ms(t1 - t0).count();
+        auto const delivered = rounds * burst * subs_.size();
+        log <<
+            name << "\t" <<
+            elapsed << "ms, " <<
+            static_cast<double>(writes_) / delivered <<
+            " writes/message" << std::endl;
+    }
+
+    void
+    run() override
+    {
+        std::size_t const n = 1000;
+        connect(n);
+        for(auto& sp : clients_)
+            do_drain(*sp);
+        std::thread t(
+            [this]
+            {
+                auto work = net::make_work_guard(cioc_);
+                cioc_.run();
+            });
+
+        measure("async_write", 20, 16,
+            [this](subscriber& s){ write_each(s); });
+        measure("gathered", 20, 16,
+            [this](subscriber& s){ write_batch(s); });
+
+        cioc_.stop();
+        t.join();
+        pass();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(lounge,bench,ws_write_bench);
@@ -0,0 +1,149 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+// Test that header file is self-contained.
+#include "conditional.hpp"
+
+#include <boost/beast/_experimental/unit_test/suite.hpp>
+
+class conditional_test : public beast::unit_test::suite
+{
+public:
+    void
+    testDate()
+    {
+        BEAST_EXPECT(format_http_date(0) ==
+            "Thu, 01 Jan 1970 00:00:00 GMT");
+        BEAST_EXPECT(format_http_date(784111777) ==
+            "Sun, 06 Nov 1994 08:49:37 GMT");
+        BEAST_EXPECT(format_http_date(951782400) ==
+            "Tue, 29 Feb 2000 00:00:00 GMT");
+
+        std::time_t t = 0;
+        BEAST_EXPECT(parse_http_date(
+            "Sun, 06 Nov 1994 08:49:37 GMT", t));
+        BEAST_EXPECT(t == 784111777);
+
+        // round trip across several years
+        for(std::time_t i = 0; i < 2000000000; i += 86400 * 37 + 3671)
+        {
+            std::time_t u;
+            if(! BEAST_EXPECT(parse_http_date(format_http_date(i), u)))
+                break;
+            if(! BEAST_EXPECT(u == i))
+                break;
+        }
+
+        BEAST_EXPECT(! parse_http_date("", t));
+        BEAST_EXPECT(! parse_http_date(
+            "Sunday, 06-Nov-94 08:49:37 GMT", t));
+        BEAST_EXPECT(! parse_http_date(
+            "Sun Nov  6 08:49:37 1994", t));
+        BEAST_EXPECT(! parse_http_date(
+            "Sun, 06 Xyz 1994 08:49:37 GMT", t));
+        BEAST_EXPECT(! parse_http_date(
+            "Sun, 06 Nov 1994 25:49:37 GMT", t));
+    }
+
+    void
+    testEtag()
+    {
+        auto const e = make_etag(0x5f00, 1234);
+        BEAST_EXPECT(e == "\"5f00-4d2\"");
+        BEAST_EXPECT(make_etag(0x5f00, 1234, "gzip") ==
+            "\"5f00-4d2-gzip\"");
+
+        BEAST_EXPECT(etag_matches(e, e));
+        BEAST_EXPECT(etag_matches("*", e));
+        BEAST_EXPECT(etag_matches("W/" + e, e));
+        BEAST_EXPECT(etag_matches("\"x\", " + e, e));
+        BEAST_EXPECT(etag_matches("\"x\",W/" + e + ",\"y\"", e));
+        BEAST_EXPECT(! etag_matches("\"x\", \"y\"", e));
+        BEAST_EXPECT(! etag_matches("", e));
+        BEAST_EXPECT(! etag_matches("\"5f00", e));
+    }
+
+    void
+    testConditions()
+    {
+        std::string const e = "\"1-2\"";
+        auto const d = format_http_date(1000);
+        auto const earlier = format_http_date(999);
+
+        BEAST_EXPECT(! is_not_modified("", "", e, 1000));
+        BEAST_EXPECT(is_not_modified(e, "", e, 1000));
+        BEAST_EXPECT(is_not_modified("", d, e, 1000));
+        BEAST_EXPECT(! is_not_modified("", earlier, e, 1000));
+        BEAST_EXPECT(! is_not_modified("", "garbage", e, 1000));
+
+        // If-None-Match takes precedence
+        BEAST_EXPECT(! is_not_modified("\"x\"", d, e, 1000));
+
+        BEAST_EXPECT(is_range_current("", e, 1000));
+        BEAST_EXPECT(is_range_current(e, e, 1000));
+        BEAST_EXPECT(! is_range_current("W/" + e, e, 1000));
+        BEAST_EXPECT(! is_range_current("\"x\"", e, 1000));
+        BEAST_EXPECT(is_range_current(d, e, 1000));
+        BEAST_EXPECT(! is_range_current(earlier, e, 1000));
+    }
+
+    void
+    testRange()
+    {
+        std::vector<byte_range> v;
+        auto const check =
+            [&](beast::string_view s, std::uint64_t size,
+                range_status status,
+                std::vector<byte_range> const& expect)
+            {
+                auto const result = parse_range(s, size, v, 4);
+                if(! BEAST_EXPECTS(result == status, s))
+                    return;
+                if(! BEAST_EXPECTS(v.size() == expect.size(), s))
+                    return;
+                for(std::size_t i = 0; i < v.size(); ++i)
+                    BEAST_EXPECTS(
+                        v[i].first == expect[i].first &&
+                        v[i].last == expect[i].last, s);
+            };
+
+        using rs = range_status;
+        check("", 100, rs::ignore, {});
+        check("bytes=", 100, rs::ignore, {});
+        check("items=0-1", 100, rs::ignore, {});
+        check("bytes=0-99", 100, rs::partial, {{0, 99}});
+        check("bytes=0-0", 100, rs::partial, {{0, 0}});
+        check("bytes=10-", 100, rs::partial, {{10, 99}});
+        check("bytes=-10", 100, rs::partial, {{90, 99}});
+        check("bytes=-1000", 100, rs::partial, {{0, 99}});
+        check("bytes=50-1000", 100, rs::partial, {{50, 99}});
+        check("bytes=0-1, 5-9 ,-2", 100, rs::partial,
+            {{0, 1}, {5, 9}, {98, 99}});
+        check("bytes=100-", 100, rs::unsatisfiable, {});
+        check("bytes=-0", 100, rs::unsatisfiable, {});
+        check("bytes=200-300, 5-6", 100, rs::partial, {{5, 6}});
+        check("bytes=0-1", 0, rs::unsatisfiable, {});
+        check("bytes=5-1", 100, rs::ignore, {});
+        check("bytes=a-1", 100, rs::ignore, {});
+        check("bytes=1-2x", 100, rs::ignore, {});
+        check("bytes=0-0,1-1,2-2,3-3,4-4", 100, rs::ignore, {});
+        check("bytes=99999999999999999999-", 100, rs::ignore, {});
+    }
+
+    void
+    run() override
+    {
+        testDate();
+        testEtag();
+        testConditions();
+        testRange();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(lounge,server,conditional);
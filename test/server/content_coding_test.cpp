@@ -0,0 +1,107 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+// Test that header file is self-contained.
+#include "content_coding.hpp"
+
+#include <boost/beast/_experimental/unit_test/suite.hpp>
+#include <boost/beast/zlib/inflate_stream.hpp>
+
+class content_coding_test : public beast::unit_test::suite
+{
+public:
+    void
+    testAcceptEncoding()
+    {
+        auto const both = coding_gzip | coding_br;
+        BEAST_EXPECT(parse_accept_encoding("") == 0);
+        BEAST_EXPECT(parse_accept_encoding("identity") == 0);
+        BEAST_EXPECT(parse_accept_encoding("gzip") == coding_gzip);
+        BEAST_EXPECT(parse_accept_encoding("x-gzip") == coding_gzip);
+        BEAST_EXPECT(parse_accept_encoding("GZIP, deflate") == coding_gzip);
+        BEAST_EXPECT(parse_accept_encoding("gzip, deflate, br") == both);
+        BEAST_EXPECT(parse_accept_encoding("br;q=1.0, gzip;q=0.5") == both);
+        BEAST_EXPECT(parse_accept_encoding("br;q=0, gzip") == coding_gzip);
+        BEAST_EXPECT(parse_accept_encoding("gzip;q=0.000") == 0);
+        BEAST_EXPECT(parse_accept_encoding("*") == both);
+        BEAST_EXPECT(parse_accept_encoding("*;q=0") == 0);
+        BEAST_EXPECT(parse_accept_encoding("*, gzip;q=0") == coding_br);
+    }
+
+    void
+    testCompressible()
+    {
+        BEAST_EXPECT(is_compressible("text/html"));
+        BEAST_EXPECT(is_compressible("text/css"));
+        BEAST_EXPECT(is_compressible("application/javascript"));
+        BEAST_EXPECT(is_compressible("image/svg+xml"));
+        BEAST_EXPECT(! is_compressible("image/png"));
+        BEAST_EXPECT(! is_compressible("application/text"));
+    }
+
+    void
+    testGzip()
+    {
+        std::string in;
+        for(int i = 0; i < 1000; ++i)
+            in.append("<p>The quick brown fox</p>\n");
+        auto const out = gzip_compress(in);
+        BEAST_EXPECT(out.size() < in.size());
+        BEAST_EXPECT(out.size() > 18);
+        BEAST_EXPECT(
+            static_cast<unsigned char>(out[0]) == 0x1f &&
+            static_cast<unsigned char>(out[1]) == 0x8b &&
+            out[2] == 8);
+
+        // The trailer holds the CRC and the input size
+        auto const get32 =
+            [&out](std::size_t pos)
+            {
+                std::uint32_t v = 0;
+                for(int i = 3; i >= 0; --i)
+                    v = (v << 8) | static_cast<unsigned char>(
+                        out[pos + i]);
+                return v;
+            };
+        boost::crc_32_type crc;
+        crc.process_bytes(in.data(), in.size());
+        BEAST_EXPECT(get32(out.size() - 8) == crc.checksum());
+        BEAST_EXPECT(get32(out.size() - 4) == in.size());
+
+        // The body is a raw deflate stream
+        beast::zlib::inflate_stream is;
+        is.reset(15);
+        std::string result;
+        result.resize(in.size() + 1);
+        beast::zlib::z_params zs;
+        zs.next_in = out.data() + 10;
+        zs.avail_in = out.size() - 18;
+        zs.next_out = &result[0];
+        zs.avail_out = result.size();
+        beast::error_code ec;
+        is.write(zs, beast::zlib::Flush::finish, ec);
+        BEAST_EXPECTS(ec == beast::zlib::error::end_of_stream,
+            ec.message());
+        result.resize(zs.total_out);
+        BEAST_EXPECT(result == in);
+
+        // Empty input is still a valid stream
+        BEAST_EXPECT(gzip_compress("").size() > 18);
+    }
+
+    void
+    run() override
+    {
+        testAcceptEncoding();
+        testCompressible();
+        testGzip();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(lounge,server,content_coding);
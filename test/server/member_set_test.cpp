@@ -0,0 +1,159 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+// Test that header file is self-contained.
+#include "member_set.hpp"
+
+#include <boost/beast/_experimental/unit_test/suite.hpp>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <set>
+#include <vector>
+
+class member_set_test : public beast::unit_test::suite
+{
+public:
+    struct item
+    {
+        int n = 0;
+    };
+
+    void
+    testDenseSet()
+    {
+        std::vector<item> v(1000);
+        dense_set<item> s;
+        BEAST_EXPECT(s.empty());
+        BEAST_EXPECT(! s.contains(&v[0]));
+        BEAST_EXPECT(! s.erase(&v[0]));
+
+        BEAST_EXPECT(s.insert(&v[0]));
+        BEAST_EXPECT(! s.insert(&v[0]));
+        BEAST_EXPECT(s.contains(&v[0]));
+        BEAST_EXPECT(s.size() == 1);
+        BEAST_EXPECT(s.erase(&v[0]));
+        BEAST_EXPECT(s.empty());
+
+        for(auto& e : v)
+            BEAST_EXPECT(s.insert(&e));
+        BEAST_EXPECT(s.size() == v.size());
+        for(auto& e : v)
+            BEAST_EXPECT(s.contains(&e));
+
+        // iteration visits every element once
+        std::set<item*> seen(s.begin(), s.end());
+        BEAST_EXPECT(seen.size() == v.size());
+
+        s.clear();
+        BEAST_EXPECT(s.empty());
+        BEAST_EXPECT(! s.contains(&v[0]));
+    }
+
+    void
+    testRandom(membership kind)
+    {
+        std::mt19937 g(kind == membership::flat ? 1 : 2);
+        std::vector<item> v(500);
+        std::set<item*> ref;
+        member_set<item> s(kind);
+        BEAST_EXPECT(s.kind() == kind);
+        for(int i = 0; i < 20000; ++i)
+        {
+            auto const p = &v[g() % v.size()];
+            if(g() % 2)
+                BEAST_EXPECT(s.insert(p) ==
+                    ref.insert(p).second);
+            else
+                BEAST_EXPECT(s.erase(p) ==
+                    (ref.erase(p) != 0));
+        }
+        BEAST_EXPECT(s.size() == ref.size());
+        for(auto& e : v)
+            BEAST_EXPECT(s.contains(&e) ==
+                (ref.count(&e) != 0));
+        std::set<item*> seen;
+        s.for_each(
+            [&](item* p)
+            {
+                seen.insert(p);
+            });
+        BEAST_EXPECT(seen == ref);
+    }
+
+    void
+    run() override
+    {
+        testDenseSet();
+        testRandom(membership::flat);
+        testRandom(membership::dense);
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(lounge,server,member_set);
+
+//------------------------------------------------------------------------------
+
+// Measures join and leave throughput with 100k members,
+// as seen during login storms on a large channel.
+class member_set_stress_test : public beast::unit_test::suite
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    struct item
+    {
+        int n = 0;
+    };
+
+    void
+    stress(membership kind, char const* name)
+    {
+        std::size_t const n = 100000;
+        std::vector<item> v(n);
+        std::vector<item*> order;
+        order.reserve(n);
+        for(auto& e : v)
+            order.push_back(&e);
+        std::shuffle(order.begin(), order.end(),
+            std::mt19937(0));
+
+        member_set<item> s(kind);
+        auto const t0 = clock_type::now();
+        for(auto p : order)
+            s.insert(p);
+        auto const t1 = clock_type::now();
+        std::shuffle(order.begin(), order.end(),
+            std::mt19937(1));
+        for(auto p : order)
+            s.erase(p);
+        auto const t2 = clock_type::now();
+        BEAST_EXPECT(s.empty());
+
+        using ms = std::chrono::duration<double, std::milli>;
+        auto const join = ms(t1 - t0).count();
+        auto const leave = ms(t2 - t1).count();
+        log <<
+            name <<
+            "\tjoin=" << join << "ms (" <<
+                static_cast<std::size_t>(n / join * 1000) << "/s)" <<
+            "\tleave=" << leave << "ms (" <<
+                static_cast<std::size_t>(n / leave * 1000) << "/s)" <<
+            std::endl;
+    }
+
+    void
+    run() override
+    {
+        stress(membership::flat, "flat");
+        stress(membership::dense, "dense");
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(lounge,server,member_set_stress);
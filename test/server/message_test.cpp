@@ -12,6 +12,8 @@
 
 #include <boost/beast/_experimental/unit_test/suite.hpp>
 #include <boost/beast/core/buffers_to_string.hpp>
+#include <string>
+#include <vector>
 
 class message_test : public beast::unit_test::suite
 {
@@ -28,10 +30,50 @@ public:
                 "Hello, world!");
     }
 
+    void
+    testFramed()
+    {
+        net::const_buffer cb("Hello, world!", 13);
+        auto m = message::framed(cb, 7);
+        BEAST_EXPECT(m.key() == 7);
+        BEAST_EXPECT(
+            beast::buffers_to_string(m) ==
+                "Hello, world!");
+        BEAST_EXPECT(
+            beast::buffers_to_string(m.frame()) ==
+                "\x81\x0d" "Hello, world!");
+        BEAST_EXPECT(message(cb).frame().size() == 0);
+        BEAST_EXPECT(
+            beast::buffers_to_string(
+                message::framed(cb, 0, false).frame()) ==
+                "\x82\x0d" "Hello, world!");
+
+        std::string const big(300, '*');
+        auto m2 = message::framed(net::buffer(big));
+        BEAST_EXPECT(
+            beast::buffers_to_string(m2.frame()) ==
+                "\x81\x7e\x01\x2c" + big);
+
+        // Pre-built frames are written as is
+        std::vector<message> v;
+        v.push_back(m);
+        v.push_back(message(net::buffer("ab", 2)));
+        v.push_back(m);
+        ws_frame_batch b;
+        BEAST_EXPECT(b.assign(v.begin(), v.end(), 1024) == 3);
+        BEAST_EXPECT(b.buffers().size() == 4);
+        BEAST_EXPECT(beast::buffers_to_string(b.buffers()) ==
+            "\x81\x0d" "Hello, world!"
+            "\x81\x02" "ab"
+            "\x81\x0d" "Hello, world!");
+        BEAST_EXPECT(b.assign(v.begin(), v.end(), 32) == 2);
+    }
+
     void
     run() override
     {
         testMessage();
+        testFramed();
         pass();
     }
 };
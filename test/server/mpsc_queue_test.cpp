@@ -0,0 +1,105 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+// Test that header file is self-contained.
+#include "mpsc_queue.hpp"
+
+#include <boost/beast/_experimental/unit_test/suite.hpp>
+#include <memory>
+#include <thread>
+#include <vector>
+
+class mpsc_queue_test : public beast::unit_test::suite
+{
+public:
+    struct node : mpsc_node
+    {
+        int producer;
+        int seq;
+
+        node(int producer_, int seq_)
+            : producer(producer_)
+            , seq(seq_)
+        {
+        }
+    };
+
+    void
+    testFifo()
+    {
+        mpsc_queue<node> q;
+        BEAST_EXPECT(q.pop() == nullptr);
+
+        node a(0, 1);
+        node b(0, 2);
+        node c(0, 3);
+        q.push(&a);
+        BEAST_EXPECT(q.pop() == &a);
+        BEAST_EXPECT(q.pop() == nullptr);
+
+        // Reuse after draining to empty
+        q.push(&b);
+        q.push(&c);
+        BEAST_EXPECT(q.pop() == &b);
+        q.push(&a);
+        BEAST_EXPECT(q.pop() == &c);
+        BEAST_EXPECT(q.pop() == &a);
+        BEAST_EXPECT(q.pop() == nullptr);
+    }
+
+    void
+    testThreads()
+    {
+        // Each producer's elements arrive in order,
+        // and nothing is lost or duplicated.
+        int const producers = 4;
+        int const count = 100000;
+        mpsc_queue<node> q;
+        std::vector<std::thread> v;
+        for(int i = 0; i < producers; ++i)
+            v.emplace_back(
+                [&q, i]
+                {
+                    for(int j = 0; j < count; ++j)
+                        q.push(new node(i, j));
+                });
+
+        std::vector<int> next(producers, 0);
+        int total = 0;
+        bool ordered = true;
+        while(total < producers * count)
+        {
+            std::unique_ptr<node> p(q.pop());
+            if(! p)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            if(p->seq != next[p->producer])
+                ordered = false;
+            next[p->producer] = p->seq + 1;
+            ++total;
+        }
+        for(auto& t : v)
+            t.join();
+        BEAST_EXPECT(ordered);
+        BEAST_EXPECT(q.pop() == nullptr);
+        for(auto n : next)
+            BEAST_EXPECT(n == count);
+    }
+
+    void
+    run() override
+    {
+        testFifo();
+        testThreads();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(lounge,server,mpsc_queue);
@@ -0,0 +1,144 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+// Test that header file is self-contained.
+#include "msgpack.hpp"
+#include "wire_format.hpp"
+
+#include <boost/beast/_experimental/unit_test/suite.hpp>
+#include <boost/json.hpp>
+#include <string>
+
+class msgpack_test : public beast::unit_test::suite
+{
+public:
+    static
+    std::string
+    encode(beast::string_view s)
+    {
+        beast::error_code ec;
+        auto const jv = json::parse(s, ec);
+        std::string out;
+        msgpack_encode(jv, out);
+        return out;
+    }
+
+    // Decoding then encoding again gives the same bytes
+    void
+    check(beast::string_view json_text, std::string const& expect)
+    {
+        auto const s = encode(json_text);
+        BEAST_EXPECT(s == expect);
+        beast::error_code ec;
+        auto const jv = msgpack_decode(s, ec);
+        BEAST_EXPECTS(! ec, ec.message());
+        std::string s2;
+        msgpack_encode(jv, s2);
+        BEAST_EXPECT(s2 == s);
+    }
+
+    void
+    testScalars()
+    {
+        check("null", "\xc0");
+        check("true", "\xc3");
+        check("false", "\xc2");
+        check("0", std::string("\x00", 1));
+        check("127", "\x7f");
+        check("128", "\xcc\x80");
+        check("65535", "\xcd\xff\xff");
+        check("65536", std::string("\xce\x00\x01\x00\x00", 5));
+        check("-1", "\xff");
+        check("-32", "\xe0");
+        check("-33", "\xd0\xdf");
+        check("-129", "\xd1\xff\x7f");
+        check("18446744073709551615",
+            "\xcf\xff\xff\xff\xff\xff\xff\xff\xff");
+        check("1.5", std::string(
+            "\xcb\x3f\xf8\x00\x00\x00\x00\x00\x00", 9));
+        check("\"abc\"", "\xa3" "abc");
+        check("\"" + std::string(40, 'x') + "\"",
+            "\xd9\x28" + std::string(40, 'x'));
+    }
+
+    void
+    testStructured()
+    {
+        check("[]", "\x90");
+        check("[1,[2]]", "\x92\x01\x91\x02");
+        check("{}", "\x80");
+        check("{\"a\":1,\"b\":[true,null]}",
+            "\x82\xa1" "a" "\x01\xa1" "b" "\x92\xc3\xc0");
+
+        std::string big = "[";
+        for(int i = 0; i < 20; ++i)
+            big += i ? ",0" : "0";
+        big += "]";
+        check(big, std::string("\xdc\x00\x14", 3) +
+            std::string(20, '\0'));
+    }
+
+    void
+    testDecode()
+    {
+        beast::error_code ec;
+
+        // float32 and wide strings are accepted
+        auto jv = msgpack_decode(std::string(
+            "\xca\x3f\xc0\x00\x00", 5), ec);
+        BEAST_EXPECT(! ec && jv.is_double() &&
+            jv.get_double() == 1.5);
+        jv = msgpack_decode(std::string(
+            "\xda\x00\x02" "hi", 5), ec);
+        BEAST_EXPECT(! ec && jv.is_string());
+
+        auto const bad =
+            [&](std::string const& s)
+            {
+                msgpack_decode(s, ec);
+                BEAST_EXPECT(ec);
+            };
+        bad("");
+        bad("\xc1");                    // never used
+        bad("\xc4\x01\x00");            // bin
+        bad("\xa3" "ab");               // short string
+        bad("\x92\x01");                // short array
+        bad("\x81\x01\x01");            // key is not a string
+        bad("\xdd\xff\xff\xff\xff");    // huge array
+        bad("\x01\x02");                // trailing data
+        bad(std::string(100, '\x91'));  // too deep
+    }
+
+    void
+    testSubprotocol()
+    {
+        wire_format f;
+        BEAST_EXPECT(select_wire_format("", f).empty());
+        BEAST_EXPECT(f == wire_format::json);
+        BEAST_EXPECT(select_wire_format("chat", f).empty());
+        BEAST_EXPECT(select_wire_format(
+            "lounge.json", f) == "lounge.json");
+        BEAST_EXPECT(f == wire_format::json);
+        BEAST_EXPECT(select_wire_format(
+            "lounge.json, lounge.msgpack", f) ==
+                "lounge.msgpack");
+        BEAST_EXPECT(f == wire_format::msgpack);
+    }
+
+    void
+    run() override
+    {
+        testScalars();
+        testStructured();
+        testDecode();
+        testSubprotocol();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(lounge,server,msgpack);
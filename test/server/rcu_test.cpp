@@ -0,0 +1,153 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+// Test that header file is self-contained.
+#include "rcu.hpp"
+
+#include <boost/beast/_experimental/unit_test/suite.hpp>
+#include <boost/smart_ptr/enable_shared_from.hpp>
+#include <boost/smart_ptr/weak_ptr.hpp>
+#include <boost/thread/shared_lock_guard.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+class rcu_test : public beast::unit_test::suite
+{
+public:
+    void
+    testRcu()
+    {
+        rcu<std::vector<int>> r;
+        BEAST_EXPECT(r.load()->empty());
+
+        auto const s0 = r.load();
+        r.update(
+            [](std::vector<int>& v)
+            {
+                v.push_back(1);
+            });
+        auto const s1 = r.load();
+
+        // old snapshots are unchanged
+        BEAST_EXPECT(s0->empty());
+        BEAST_EXPECT(s1->size() == 1);
+
+        r.store({1, 2, 3});
+        BEAST_EXPECT(s1->size() == 1);
+        BEAST_EXPECT(r.load()->size() == 3);
+    }
+
+    void
+    run() override
+    {
+        testRcu();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(lounge,server,rcu);
+
+//------------------------------------------------------------------------------
+
+// Measures the cost of one channel broadcast against
+// the number of members, comparing a locked copy of
+// the membership with a shared snapshot.
+class rcu_bench_test : public beast::unit_test::suite
+{
+    struct member : boost::enable_shared_from
+    {
+        std::size_t n = 0;
+
+        void
+        send()
+        {
+            ++n;
+        }
+    };
+
+    using clock_type = std::chrono::steady_clock;
+
+    std::vector<boost::shared_ptr<member>> v_;
+    boost::shared_mutex mutex_;
+    rcu<std::vector<boost::weak_ptr<member>>> r_;
+
+public:
+    void
+    fill(std::size_t n)
+    {
+        v_.clear();
+        for(std::size_t i = 0; i < n; ++i)
+            v_.emplace_back(boost::make_shared<member>());
+        std::vector<boost::weak_ptr<member>> w;
+        for(auto const& sp : v_)
+            w.emplace_back(sp);
+        r_.store(std::move(w));
+    }
+
+    void
+    send_locked()
+    {
+        std::vector<boost::weak_ptr<member>> v;
+        {
+            boost::shared_lock_guard<
+                boost::shared_mutex> lock(mutex_);
+            v.reserve(v_.size());
+            for(auto const& sp : v_)
+                v.emplace_back(boost::weak_from(sp.get()));
+        }
+        for(auto const& wp : v)
+            if(auto sp = wp.lock())
+                sp->send();
+    }
+
+    void
+    send_snapshot()
+    {
+        auto const sp = r_.load();
+        for(auto const& wp : *sp)
+            if(auto p = wp.lock())
+                p->send();
+    }
+
+    template<class F>
+    double
+    measure(std::size_t iterations, F const& f)
+    {
+        auto const t0 = clock_type::now();
+        for(std::size_t i = 0; i < iterations; ++i)
+            f();
+        auto const t1 = clock_type::now();
+        return std::chrono::duration<double, std::micro>(
+            t1 - t0).count() / iterations;
+    }
+
+    void
+    run() override
+    {
+        for(std::size_t n : { 10, 100, 1000, 10000, 100000 })
+        {
+            fill(n);
+            auto const iterations =
+                (std::max<std::size_t>)(10, 1000000 / n);
+            auto const locked = measure(iterations,
+                [this]{ send_locked(); });
+            auto const snapshot = measure(iterations,
+                [this]{ send_snapshot(); });
+            log <<
+                "members=" << n <<
+                "\tlocked=" << locked << "us" <<
+                "\tsnapshot=" << snapshot << "us" <<
+                std::endl;
+        }
+        pass();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(lounge,server,rcu_bench);
@@ -0,0 +1,107 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+// Test that header file is self-contained.
+#include "rpc_methods.hpp"
+
+#include <boost/beast/_experimental/unit_test/suite.hpp>
+
+class rpc_methods_test : public beast::unit_test::suite
+{
+public:
+    using handler = int (rpc_methods_test::*)();
+
+    int one() { return 1; }
+    int two() { return 2; }
+    int three() { return 3; }
+
+    static
+    rpc_method_table<handler>&
+    methods()
+    {
+        static constexpr rpc_method<handler> list[] = {
+            { "one",   &rpc_methods_test::one },
+            { "two",   &rpc_methods_test::two, false },
+            { "three", &rpc_methods_test::three, true, true },
+        };
+        static_assert(rpc_methods_unique(list), "");
+        static_assert(list[1].size == 3, "");
+        static_assert(! list[1].needs_params, "");
+        static_assert(! list[1].async, "");
+        static_assert(list[2].async, "");
+        static_assert(! rpc_methods_sync(list), "");
+        static rpc_method_table<handler> tab(list);
+        return tab;
+    }
+
+    void
+    testHash()
+    {
+        // The same at compile time and at run time
+        static_assert(detail::rpc_method_hash("", 0) ==
+            2166136261u, "");
+        BEAST_EXPECT(detail::rpc_method_hash("join", 4) ==
+            detail::rpc_method_hash(beast::string_view("join")));
+        BEAST_EXPECT(detail::rpc_method_hash("a", 1) ==
+            0xe40c292c);
+
+        static constexpr rpc_method<handler> dup[] = {
+            { "one", &rpc_methods_test::one },
+            { "two", &rpc_methods_test::two },
+            { "one", &rpc_methods_test::three },
+        };
+        static_assert(! rpc_methods_unique(dup), "");
+        static_assert(rpc_methods_sync(dup), "");
+    }
+
+    void
+    testFind()
+    {
+        auto& tab = methods();
+        BEAST_EXPECT(tab.size() == 3);
+        BEAST_EXPECT(tab.end() - tab.begin() == 3);
+        for(auto const& m : tab)
+            BEAST_EXPECT(tab.find(beast::string_view(
+                m.name, m.size)) == &m);
+        auto const m = tab.find("two");
+        if(BEAST_EXPECT(m))
+        {
+            BEAST_EXPECT((this->*m->handler)() == 2);
+            BEAST_EXPECT(! m->needs_params);
+        }
+        BEAST_EXPECT(! tab.find(""));
+        BEAST_EXPECT(! tab.find("tw"));
+        BEAST_EXPECT(! tab.find("twoo"));
+        BEAST_EXPECT(! tab.find("Two"));
+    }
+
+    void
+    testCalls()
+    {
+        auto& tab = methods();
+        BEAST_EXPECT(! tab.call("four"));
+        BEAST_EXPECT(tab.call("three"));
+        BEAST_EXPECT(tab.call("three"));
+        BEAST_EXPECT(tab.call("one"));
+        BEAST_EXPECT(tab.find("one"));
+        BEAST_EXPECT(tab.calls(*tab.find("one")) == 1);
+        BEAST_EXPECT(tab.calls(*tab.find("two")) == 0);
+        BEAST_EXPECT(tab.calls(*tab.find("three")) == 2);
+    }
+
+    void
+    run() override
+    {
+        testHash();
+        testFind();
+        testCalls();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(lounge,server,rpc_methods);
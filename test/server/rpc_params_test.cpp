@@ -0,0 +1,106 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+// Test that header file is self-contained.
+#include "rpc_params.hpp"
+
+#include <boost/beast/_experimental/unit_test/suite.hpp>
+#include <boost/json.hpp>
+
+namespace {
+
+struct test_params
+{
+    beast::string_view name;
+    std::uint64_t count = 0;
+    bool flag = true;
+    json::value* extra = nullptr;
+};
+
+using param = rpc_param<test_params>;
+
+constexpr param test_schema[] = {
+    { "name",  &param::member<beast::string_view, &test_params::name> },
+    { "count", &param::member<std::uint64_t, &test_params::count> },
+    { "flag",  &param::member<bool, &test_params::flag>, false },
+    { "extra", &param::member<json::value*, &test_params::extra>, false },
+};
+
+static_assert(rpc_params_unique(test_schema), "");
+static_assert(test_schema[1].size == 5, "");
+static_assert(! test_schema[2].required, "");
+
+} // (anon)
+
+class rpc_params_test : public beast::unit_test::suite
+{
+public:
+    beast::error_code
+    bind(beast::string_view s, test_params& p)
+    {
+        p = {};
+        auto jv = json::parse(s);
+        return rpc_bind(test_schema, jv, p);
+    }
+
+    void
+    testBind()
+    {
+        test_params p;
+
+        {
+            auto jv = json::parse(
+                R"({"cid":1,"count":3,"name":"alice","extra":[1]})");
+            BEAST_EXPECT(! rpc_bind(test_schema, jv, p));
+            BEAST_EXPECT(p.name == "alice");
+            BEAST_EXPECT(p.count == 3);
+            BEAST_EXPECT(p.flag);
+            if(BEAST_EXPECT(p.extra))
+                BEAST_EXPECT(p.extra->is_array());
+        }
+
+        BEAST_EXPECT(! bind(
+            R"({"name":"","count":0,"flag":false})", p));
+        BEAST_EXPECT(p.name.empty());
+        BEAST_EXPECT(! p.flag);
+        BEAST_EXPECT(! p.extra);
+    }
+
+    void
+    testErrors()
+    {
+        test_params p;
+        auto const fail =
+            [&](beast::string_view s, rpc_code code)
+            {
+                BEAST_EXPECTS(bind(s, p) == code, s);
+            };
+
+        fail(R"([1,2])", rpc_code::expected_object_param);
+        fail(R"(null)", rpc_code::expected_object_param);
+        fail(R"({})", rpc_code::missing_param);
+        fail(R"({"name":"a"})", rpc_code::missing_param);
+        fail(R"({"count":1})", rpc_code::missing_param);
+        fail(R"({"Name":"a","count":1})", rpc_code::missing_param);
+        fail(R"({"name":1,"count":1})", rpc_code::expected_string_param);
+        fail(R"({"name":"a","count":-1})", rpc_code::expected_uint64_param);
+        fail(R"({"name":"a","count":1.5})", rpc_code::expected_uint64_param);
+        fail(R"({"name":"a","count":"1"})", rpc_code::expected_uint64_param);
+        fail(R"({"name":"a","count":1,"flag":0})", rpc_code::expected_bool_param);
+    }
+
+    void
+    run() override
+    {
+        testBind();
+        testErrors();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(lounge,server,rpc_params);
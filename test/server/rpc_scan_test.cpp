@@ -0,0 +1,152 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+// Test that header file is self-contained.
+#include "rpc_scan.hpp"
+
+#include <boost/beast/_experimental/unit_test/suite.hpp>
+#include <string>
+
+class rpc_scan_test : public beast::unit_test::suite
+{
+public:
+    void
+    testRoute()
+    {
+        rpc_route r;
+        BEAST_EXPECT(rpc_prescan(
+            R"({"jsonrpc":"2.0","method":"join","id":7,"params":{"cid":1001}})",
+            r));
+        BEAST_EXPECT(r.v2);
+        BEAST_EXPECT(r.has_method);
+        BEAST_EXPECT(r.method == "join");
+        BEAST_EXPECT(r.id == "7");
+        BEAST_EXPECT(r.has_cid);
+        BEAST_EXPECT(r.cid == 1001);
+
+        // Order and whitespace do not matter
+        BEAST_EXPECT(rpc_prescan(
+            " { \"params\" : { \"x\" : [1, {\"cid\":5}], \"cid\" : 3 } ,\n"
+            "   \"id\" : \"a\\\"b\" , \"method\" : \"say\" } ",
+            r));
+        BEAST_EXPECT(! r.v2);
+        BEAST_EXPECT(r.method == "say");
+        BEAST_EXPECT(r.id == "\"a\\\"b\"");
+        BEAST_EXPECT(r.has_cid);
+        BEAST_EXPECT(r.cid == 3);
+
+        // Other members are skipped
+        BEAST_EXPECT(rpc_prescan(
+            R"({"x":{"cid":1,"y":[true,false,null,-1.5e+3]},"method":"m"})",
+            r));
+        BEAST_EXPECT(r.has_method);
+        BEAST_EXPECT(! r.has_cid);
+        BEAST_EXPECT(r.id.empty());
+    }
+
+    void
+    testPartial()
+    {
+        rpc_route r;
+
+        // A method with escapes must be decoded
+        BEAST_EXPECT(rpc_prescan(
+            R"({"method":"jo\u0069n","params":{"cid":1}})", r));
+        BEAST_EXPECT(! r.has_method);
+        BEAST_EXPECT(r.has_cid);
+
+        // A method which is not a string
+        BEAST_EXPECT(rpc_prescan(
+            R"({"method":1,"params":{"cid":1}})", r));
+        BEAST_EXPECT(! r.has_method);
+
+        // A cid which is not an unsigned integer
+        BEAST_EXPECT(rpc_prescan(R"({"params":{"cid":-1}})", r));
+        BEAST_EXPECT(! r.has_cid);
+        BEAST_EXPECT(rpc_prescan(R"({"params":{"cid":1.0}})", r));
+        BEAST_EXPECT(! r.has_cid);
+        BEAST_EXPECT(rpc_prescan(R"({"params":{"cid":1e3}})", r));
+        BEAST_EXPECT(! r.has_cid);
+        BEAST_EXPECT(rpc_prescan(R"({"params":{"cid":"1"}})", r));
+        BEAST_EXPECT(! r.has_cid);
+        BEAST_EXPECT(rpc_prescan(
+            R"({"params":{"cid":99999999999999999999999}})", r));
+        BEAST_EXPECT(! r.has_cid);
+
+        // Params which are not an object
+        BEAST_EXPECT(rpc_prescan(R"({"params":[1001]})", r));
+        BEAST_EXPECT(! r.has_cid);
+
+        // Other versions
+        BEAST_EXPECT(rpc_prescan(R"({"jsonrpc":"1.0"})", r));
+        BEAST_EXPECT(! r.v2);
+        BEAST_EXPECT(rpc_prescan(R"({"jsonrpc":"2.\u0030"})", r));
+        BEAST_EXPECT(! r.v2);
+    }
+
+    void
+    testInvalid()
+    {
+        rpc_route r;
+        auto const bad =
+            [&](beast::string_view s)
+            {
+                BEAST_EXPECTS(! rpc_prescan(s, r), s);
+            };
+        bad("");
+        bad("[]");
+        bad("\"method\"");
+        bad("{");
+        bad("{}x");
+        bad("{\"method\":\"a\",}");
+        bad("{\"method\" \"a\"}");
+        bad("{\"method\":\"a\"");
+        bad("{\"x\":[1,]}");
+        bad("{\"x\":[1 2]}");
+        bad("{\"x\":01}");
+        bad("{\"x\":1.}");
+        bad("{\"x\":-}");
+        bad("{\"x\":1e}");
+        bad("{\"x\":tru}");
+        bad("{\"x\":nul}");
+        bad("{\"x\":\"\\q\"}");
+        bad("{\"x\":\"\\u12g4\"}");
+        bad(beast::string_view("{\"x\":\"\x01\"}", 8));
+        bad("{\"x\":{\"y\":1}");
+
+        // Repeated routing keys
+        bad(R"({"method":"a","method":"b"})");
+        bad(R"({"id":1,"id":2})");
+        bad(R"({"params":{},"params":{}})");
+        bad(R"({"params":{"cid":1,"cid":2}})");
+        bad(R"({"jsonrpc":"2.0","jsonrpc":"2.0"})");
+
+        // Too deep
+        std::string s = "{\"x\":";
+        s.append(100, '[');
+        s.append(100, ']');
+        s.push_back('}');
+        bad(s);
+        s = "{\"x\":";
+        s.append(30, '[');
+        s.append(30, ']');
+        s.push_back('}');
+        BEAST_EXPECT(rpc_prescan(s, r));
+    }
+
+    void
+    run() override
+    {
+        testRoute();
+        testPartial();
+        testInvalid();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(lounge,server,rpc_scan);
@@ -0,0 +1,186 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+// Test that header file is self-contained.
+#include "send_queue.hpp"
+
+#include <boost/beast/_experimental/unit_test/suite.hpp>
+#include <boost/beast/core/buffers_to_string.hpp>
+#include <string>
+
+class send_queue_test : public beast::unit_test::suite
+{
+public:
+    static
+    message
+    make(std::string const& s, std::uint64_t key = 0)
+    {
+        return message(net::buffer(s), key);
+    }
+
+    static
+    std::string
+    contents(send_queue& q)
+    {
+        std::string s;
+        for(auto const& m : q)
+            s += beast::buffers_to_string(m);
+        return s;
+    }
+
+    static
+    send_limits
+    limits(
+        std::size_t messages,
+        std::size_t bytes,
+        overflow_policy policy)
+    {
+        send_limits lim;
+        lim.max_messages = messages;
+        lim.max_bytes = bytes;
+        lim.policy = policy;
+        return lim;
+    }
+
+    void
+    testFifo()
+    {
+        // Order is kept across growth and wraparound
+        send_queue q(limits(1000, 100000,
+            overflow_policy::disconnect));
+        std::string expect;
+        for(int i = 0; i < 100; ++i)
+        {
+            auto const s = std::to_string(i % 10);
+            BEAST_EXPECT(q.push(make(s)));
+            expect += s;
+            if(i % 3 == 0)
+            {
+                q.begin_write(1);
+                q.end_write();
+                expect.erase(0, 1);
+            }
+        }
+        BEAST_EXPECT(contents(q) == expect);
+        BEAST_EXPECT(q.stats().messages == q.size());
+        BEAST_EXPECT(q.stats().bytes == expect.size());
+    }
+
+    void
+    testDisconnect()
+    {
+        send_queue q(limits(3, 100,
+            overflow_policy::disconnect));
+        BEAST_EXPECT(q.push(make("a")));
+        BEAST_EXPECT(q.push(make("b")));
+        BEAST_EXPECT(q.push(make("c")));
+        BEAST_EXPECT(! q.push(make("d")));
+        BEAST_EXPECT(contents(q) == "abc");
+
+        send_queue q2(limits(100, 4,
+            overflow_policy::disconnect));
+        BEAST_EXPECT(q2.push(make("ab")));
+        BEAST_EXPECT(! q2.push(make("cde")));
+    }
+
+    void
+    testDropOldest()
+    {
+        send_queue q(limits(3, 100,
+            overflow_policy::drop_oldest));
+        BEAST_EXPECT(q.push(make("a")));
+        BEAST_EXPECT(q.push(make("b")));
+        BEAST_EXPECT(q.push(make("c")));
+        BEAST_EXPECT(q.push(make("d")));
+        BEAST_EXPECT(contents(q) == "bcd");
+        BEAST_EXPECT(q.stats().dropped == 1);
+
+        // Messages being written are kept
+        q.begin_write(2);
+        BEAST_EXPECT(q.push(make("e")));
+        BEAST_EXPECT(contents(q) == "bce");
+        BEAST_EXPECT(q.push(make("f")));
+        BEAST_EXPECT(contents(q) == "bcf");
+        q.end_write();
+        BEAST_EXPECT(contents(q) == "f");
+        BEAST_EXPECT(q.stats().dropped == 3);
+
+        // Byte limit
+        send_queue q2(limits(100, 5,
+            overflow_policy::drop_oldest));
+        BEAST_EXPECT(q2.push(make("ab")));
+        BEAST_EXPECT(q2.push(make("cd")));
+        BEAST_EXPECT(q2.push(make("efg")));
+        BEAST_EXPECT(contents(q2) == "cdefg");
+        BEAST_EXPECT(q2.stats().peak_bytes == 5);
+
+        // The newest message is always kept
+        BEAST_EXPECT(q2.push(make("0123456789")));
+        BEAST_EXPECT(contents(q2) == "0123456789");
+    }
+
+    void
+    testCoalesce()
+    {
+        send_queue q(limits(3, 100,
+            overflow_policy::coalesce));
+        BEAST_EXPECT(q.push(make("a", 1)));
+        BEAST_EXPECT(q.push(make("b")));
+        BEAST_EXPECT(q.push(make("c", 2)));
+
+        // Replaces the message with the same key in place
+        BEAST_EXPECT(q.push(make("C", 2)));
+        BEAST_EXPECT(contents(q) == "abC");
+        BEAST_EXPECT(q.push(make("A", 1)));
+        BEAST_EXPECT(contents(q) == "AbC");
+
+        // No match, so the oldest is dropped
+        BEAST_EXPECT(q.push(make("d", 3)));
+        BEAST_EXPECT(contents(q) == "bCd");
+
+        // A message being written is never replaced
+        q.begin_write(1);
+        BEAST_EXPECT(q.push(make("x")));
+        BEAST_EXPECT(contents(q) == "bdx");
+        BEAST_EXPECT(q.stats().dropped == 4);
+
+        // Below the limit nothing is coalesced
+        q.end_write();
+        BEAST_EXPECT(q.push(make("D", 3)));
+        BEAST_EXPECT(contents(q) == "dxD");
+    }
+
+    void
+    testClear()
+    {
+        send_queue q(limits(10, 100,
+            overflow_policy::disconnect));
+        BEAST_EXPECT(q.push(make("a")));
+        BEAST_EXPECT(q.push(make("b")));
+        BEAST_EXPECT(q.push(make("c")));
+        q.begin_write(1);
+        q.clear();
+        BEAST_EXPECT(contents(q) == "a");
+        q.end_write();
+        BEAST_EXPECT(q.empty());
+        BEAST_EXPECT(q.stats().bytes == 0);
+    }
+
+    void
+    run() override
+    {
+        testFifo();
+        testDisconnect();
+        testDropOldest();
+        testCoalesce();
+        testClear();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(lounge,server,send_queue);
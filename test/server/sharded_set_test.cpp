@@ -0,0 +1,84 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+// Test that header file is self-contained.
+#include "sharded_set.hpp"
+
+#include <boost/beast/_experimental/unit_test/suite.hpp>
+#include <set>
+#include <thread>
+#include <vector>
+
+class sharded_set_test : public beast::unit_test::suite
+{
+public:
+    struct item
+    {
+        int n = 0;
+    };
+
+    void
+    testShardedSet()
+    {
+        std::vector<item> v(1000);
+        sharded_set<item> s(8);
+        BEAST_EXPECT(s.size() == 0);
+        for(auto& e : v)
+            BEAST_EXPECT(s.insert(&e));
+        BEAST_EXPECT(! s.insert(&v[0]));
+        BEAST_EXPECT(s.size() == v.size());
+        BEAST_EXPECT(s.erase(&v[0]));
+        BEAST_EXPECT(! s.erase(&v[0]));
+        BEAST_EXPECT(s.size() == v.size() - 1);
+
+        std::set<item*> seen;
+        s.extract(
+            [&](item* p)
+            {
+                seen.insert(p);
+            });
+        BEAST_EXPECT(seen.size() == v.size() - 1);
+        BEAST_EXPECT(seen.count(&v[0]) == 0);
+        BEAST_EXPECT(s.size() == 0);
+    }
+
+    void
+    testConcurrent()
+    {
+        std::size_t const threads = 4;
+        std::size_t const n = 1000;
+        std::vector<item> v(threads * n);
+        sharded_set<item> s;
+        std::vector<std::thread> vt;
+        for(std::size_t t = 0; t < threads; ++t)
+            vt.emplace_back(
+                [&, t]
+                {
+                    for(int k = 0; k < 10; ++k)
+                    {
+                        for(std::size_t i = 0; i < n; ++i)
+                            s.insert(&v[t * n + i]);
+                        for(std::size_t i = 0; i < n; i += 2)
+                            s.erase(&v[t * n + i]);
+                    }
+                });
+        for(auto& t : vt)
+            t.join();
+        BEAST_EXPECT(s.size() == threads * n / 2);
+    }
+
+    void
+    run() override
+    {
+        testShardedSet();
+        testConcurrent();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(lounge,server,sharded_set);
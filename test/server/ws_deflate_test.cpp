@@ -0,0 +1,117 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+// Test that header file is self-contained.
+#include "ws_deflate.hpp"
+
+#include "ws_frame.hpp"
+#include <boost/beast/_experimental/unit_test/suite.hpp>
+#include <boost/beast/core/buffers_to_string.hpp>
+#include <boost/beast/zlib/inflate_stream.hpp>
+#include <string>
+
+class ws_deflate_test : public beast::unit_test::suite
+{
+public:
+    // Inflate the payload of a compressed frame the
+    // way a permessage-deflate receiver does.
+    static
+    std::string
+    inflate(std::string in)
+    {
+        namespace zlib = beast::zlib;
+        in.append("\x00\x00\xff\xff", 4);
+        zlib::inflate_stream is;
+        is.reset(15);
+        std::string out(64 * 1024, '\0');
+        zlib::z_params zs;
+        zs.next_in = in.data();
+        zs.avail_in = in.size();
+        zs.next_out = &out[0];
+        zs.avail_out = out.size();
+        beast::error_code ec;
+        is.write(zs, zlib::Flush::sync, ec);
+        out.resize(zs.total_out);
+        return out;
+    }
+
+    static
+    std::string
+    chat(int n)
+    {
+        std::string s;
+        for(int i = 0; i < n; ++i)
+            s += "{\"method\":\"say\",\"params\":"
+                "{\"channel\":1,\"message\":\"Hello\"}}";
+        return s;
+    }
+
+    void
+    testDeflate()
+    {
+        deflate_pool pool{deflate_options{}};
+        auto const s = chat(20);
+        std::string out = "prefix";
+        BEAST_EXPECT(pool.deflate(net::buffer(s), out));
+        BEAST_EXPECT(out.size() < s.size() / 4);
+        BEAST_EXPECT(out.substr(0, 6) == "prefix");
+        BEAST_EXPECT(inflate(out.substr(6)) == s);
+
+        // Streams are reused without history
+        std::string out2;
+        BEAST_EXPECT(pool.deflate(net::buffer(s), out2));
+        BEAST_EXPECT(out2 == out.substr(6));
+    }
+
+    void
+    testSkip()
+    {
+        deflate_options opt;
+        opt.min_size = 64;
+        deflate_pool pool(opt);
+
+        // Too small
+        std::string out;
+        BEAST_EXPECT(! pool.deflate(
+            net::buffer(chat(1).substr(0, 63)), out));
+        BEAST_EXPECT(out.empty());
+
+        // Does not shrink
+        std::string noise;
+        unsigned x = 12345;
+        for(int i = 0; i < 200; ++i)
+        {
+            x = x * 1103515245 + 12345;
+            noise.push_back(static_cast<char>(x >> 16));
+        }
+        BEAST_EXPECT(! pool.deflate(net::buffer(noise), out));
+        BEAST_EXPECT(out.empty());
+    }
+
+    void
+    testHeader()
+    {
+        BEAST_EXPECT(beast::buffers_to_string(
+            ws_frame_header(5, true, true).buffer()) ==
+                "\xc1\x05");
+        BEAST_EXPECT(beast::buffers_to_string(
+            ws_frame_header(5, false, true).buffer()) ==
+                "\xc2\x05");
+    }
+
+    void
+    run() override
+    {
+        testDeflate();
+        testSkip();
+        testHeader();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(lounge,server,ws_deflate);
@@ -0,0 +1,150 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/boostorg/beast
+//
+
+// Test that header file is self-contained.
+#include "ws_frame.hpp"
+#include "gated_stream.hpp"
+
+#include <boost/beast/_experimental/unit_test/suite.hpp>
+#include <boost/beast/_experimental/test/stream.hpp>
+#include <boost/beast/core/buffers_to_string.hpp>
+#include <boost/asio/io_context.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+
+class ws_frame_test : public beast::unit_test::suite
+{
+public:
+    static
+    std::string
+    header(std::uint64_t n)
+    {
+        return beast::buffers_to_string(
+            ws_frame_header(n).buffer());
+    }
+
+    void
+    testHeader()
+    {
+        BEAST_EXPECT(header(0) == std::string("\x81\x00", 2));
+        BEAST_EXPECT(header(125) == "\x81\x7d");
+        BEAST_EXPECT(header(126) == std::string("\x81\x7e\x00\x7e", 4));
+        BEAST_EXPECT(header(65535) == "\x81\x7e\xff\xff");
+        BEAST_EXPECT(header(65536) == std::string(
+            "\x81\x7f\x00\x00\x00\x00\x00\x01\x00\x00", 10));
+        BEAST_EXPECT(beast::buffers_to_string(
+            ws_frame_header(1, false).buffer()) == "\x82\x01");
+    }
+
+    void
+    testBatch()
+    {
+        std::vector<net::const_buffer> v;
+        v.emplace_back("abc", 3);
+        v.emplace_back("de", 2);
+        v.emplace_back("f", 1);
+
+        ws_frame_batch b;
+        BEAST_EXPECT(b.assign(v.begin(), v.end(), 1024) == 3);
+        BEAST_EXPECT(b.size() == 12);
+        BEAST_EXPECT(beast::buffers_to_string(b.buffers()) ==
+            "\x81\x03" "abc" "\x81\x02" "de" "\x81\x01" "f");
+
+        // The first message is always taken
+        BEAST_EXPECT(b.assign(v.begin(), v.end(), 1) == 1);
+        BEAST_EXPECT(beast::buffers_to_string(b.buffers()) ==
+            "\x81\x03" "abc");
+
+        BEAST_EXPECT(b.assign(v.begin(), v.end(), 18) == 2);
+        BEAST_EXPECT(b.assign(v.begin(), v.begin(), 1024) == 0);
+        BEAST_EXPECT(b.buffers().empty());
+    }
+
+    void
+    testGatedStream()
+    {
+        // Writes never interleave, even when the
+        // next layer only accepts a few bytes at once.
+        net::io_context ioc;
+        gated_stream<beast::test::stream> s(ioc);
+        beast::test::stream peer(ioc);
+        s.next_layer().connect(peer);
+        s.next_layer().write_size(3);
+
+        std::string const a(100, 'a');
+        std::string const b(100, 'b');
+        std::size_t n = 0;
+        s.async_write_some(net::buffer(a),
+            [&](beast::error_code ec, std::size_t bytes)
+            {
+                BEAST_EXPECTS(! ec, ec.message());
+                BEAST_EXPECT(bytes == a.size());
+                BEAST_EXPECT(n++ == 0);
+            });
+        s.async_write_some(net::buffer(b),
+            [&](beast::error_code ec, std::size_t bytes)
+            {
+                BEAST_EXPECTS(! ec, ec.message());
+                BEAST_EXPECT(bytes == b.size());
+                BEAST_EXPECT(n++ == 1);
+            });
+        ioc.run();
+        BEAST_EXPECT(n == 2);
+        BEAST_EXPECT(peer.str() == a + b);
+    }
+
+    void
+    testGatedFairness()
+    {
+        // A waiting write goes next, even when the
+        // writer before it starts again at once.
+        net::io_context ioc;
+        gated_stream<beast::test::stream> s(ioc);
+        beast::test::stream peer(ioc);
+        s.next_layer().connect(peer);
+        s.next_layer().write_size(3);
+
+        std::string out;
+        std::function<void(int)> write_a =
+            [&](int i)
+            {
+                s.async_write_some(net::buffer("aaaa", 4),
+                    [&, i](beast::error_code ec, std::size_t)
+                    {
+                        BEAST_EXPECTS(! ec, ec.message());
+                        out.push_back('a');
+                        if(i < 3)
+                            write_a(i + 1);
+                    });
+            };
+        write_a(0);
+        s.async_write_some(net::buffer("bbbb", 4),
+            [&](beast::error_code ec, std::size_t)
+            {
+                BEAST_EXPECTS(! ec, ec.message());
+                out.push_back('b');
+            });
+        ioc.run();
+        BEAST_EXPECT(out == "abaaa");
+        BEAST_EXPECT(peer.str() ==
+            "aaaabbbbaaaaaaaaaaaa");
+    }
+
+    void
+    run() override
+    {
+        testHeader();
+        testBatch();
+        testGatedStream();
+        testGatedFairness();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(lounge,server,ws_frame);